@@ -82,4 +82,25 @@ extern void set_smart_strategy(sv_integer);
 
 extern sv_integer get_smart_strategy();
 
+extern void set_smart_parallel(sv_integer);
+
+extern sv_integer get_smart_parallel();
+
+// Cost-model division: weight each child's contents by its surface
+// area, or just add the contents up
+
+enum cost_meas
+{
+	SV_COST_AREA,
+	SV_COST_CONTENTS
+};
+
+extern void cost_decision(const sv_model&, sv_integer, void*,
+    mod_kind*, sv_real*, sv_model*, sv_model*);
+
+extern void set_cost_cuts(sv_integer);
+extern sv_integer get_cost_cuts();
+extern void set_cost_measure(sv_integer);
+extern sv_integer get_cost_measure();
+
 #endif
@@ -343,6 +343,10 @@ enum mod_kind
 
 #define DEF_SWELL_FAC 0.03
 
+// Default depth below which parallel division runs serially
+
+#define DEF_SERIAL_LEVEL 10
+
 /********************************************************************/
 
 // The svLis editor
@@ -409,6 +413,17 @@ enum sv_ed_op
 #define SV_SMALL_BOX 0.0001
 #define SV_LOW_CONTENTS 3
 
+// Default number of primitives above which smart_decision works out 
+// its trial divisions in parallel
+
+#define SV_SMART_PARALLEL 16
+
+// Sets' bounding boxes (see sv_set::bound()) are worked out inside a
+// cube this far from the origin each way; a set that is unbounded in a
+// direction has a box that reaches the edge of the cube there.
+
+#define SV_BOUND_BIG 1.0e6
+
 // Default colour attribute - grey
 
 #define DEF_COL sv_point (0.5, 0.5, 0.5)
@@ -0,0 +1,217 @@
+/* 
+ *  The SvLis Geometric Modelling Kernel
+ *  ------------------------------------
+ *
+ *  Copyright (C) 1993, 1997, 1998, 2000 
+ *  University of Bath & Information Geometers Ltd
+ *
+ *  http://www.bath.ac.uk/
+ *  http://www.inge.com/
+ *
+ *  Principal author:
+ *
+ *     Adrian Bowyer
+ *     Department of Mechanical Engineering
+ *     Faculty of Engineering and Design
+ *     University of Bath
+ *     Bath BA2 7AY
+ *     U.K.
+ *
+ *     e-mail: A.Bowyer@bath.ac.uk
+ *        web: http://www.bath.ac.uk/~ensab/
+ *
+ *   SvLis is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   Licence as published by the Free Software Foundation; either
+ *   version 2 of the Licence, or (at your option) any later version.
+ *
+ *   SvLis is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public Licence for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   Licence along with svLis; if not, write to the Free
+ *   Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA,
+ *   or see
+ *
+ *      http://www.gnu.org/
+ * 
+ * =====================================================================
+ *
+ * SvLis - flattened, read-only divided models
+ *
+ * See the svLis web site for the manual and other details:
+ *
+ *    http://www.bath.ac.uk/~ensab/G_mod/Svlis/
+ *
+ * or see the file
+ *
+ *    docs/svlis.html
+ *
+ * First version: 18 October 2026
+ * This version: 18 October 2026
+ *
+ */
+
+
+#ifndef SVLIS_FLATMOD
+#define SVLIS_FLATMOD
+
+// A divided sv_model is a tree of reference-counted nodes, each of which
+// holds handles to its parent, its children, and its set list.  An
+// sv_flat_model is the same division packed into one array of small 
+// nodes with no pointers in it, which is quicker to walk and much 
+// smaller.  It can't be changed, but it can be made from any model and 
+// used for point location, membership, ray-tracing and statistics.
+
+// The children of a divided node are adjacent in the array, so a node 
+// only needs the index of its first child.  Leaves hold an index into a
+// table of set lists instead; leaves with the same list share one entry.
+// The faces of the children along the division direction are kept, 
+// as box swell makes them overlap; the rest of each child's box is its 
+// parent's.
+
+struct sv_flat_node
+{
+	sv_real coord;		// The division coordinate
+	sv_real hi_1;		// Upper face of child 1 along the division
+	sv_real lo_2;		// Lower face of child 2 along the division
+	sv_integer link;	// 4*(first child or set list) + mod_kind
+};
+
+class sv_flat_model
+{
+private:
+
+   struct flat_model_data : public sv_refct 
+   {
+        friend class sv_smart_ptr<flat_model_data>;
+
+	sv_box b;		// Box round the whole model
+	sv_set_list sl;		// The root's set list
+	sv_integer nodes;	// How many nodes there are
+	sv_flat_node* node;	// The nodes; node[0] is the root
+	sv_integer lists;	// How many distinct leaf set lists
+	sv_set_list* list;	// The leaf set lists
+
+        ~flat_model_data() { delete [] node; delete [] list; }
+
+	flat_model_data(const sv_model&);
+
+   }; // flat_model_data
+
+// This is the pointer that gets ref counted
+
+   sv_smart_ptr<flat_model_data> flat_info;
+
+// Ray-trace into the subtree at node n
+
+   sv_set ray_test(sv_integer n, const sv_line&, const sv_real&, 
+	const sv_interval&, sv_real*) const;
+
+public:
+
+// Null flat model
+
+	sv_flat_model() { }
+
+// Flatten a (divided) model
+
+	sv_flat_model(const sv_model& m) { flat_info = new flat_model_data(m); }
+
+// Initialization
+
+	sv_flat_model(const sv_flat_model& m) { *this = m; }
+
+// Has it been defined?
+
+	int exists() const { return(flat_info.exists()); }
+
+// Unique value (effectively the pointer to this model)
+
+        long unique() const { return(flat_info.unique()); }
+
+// The whole box and the root's set list
+
+	sv_box box() const { return(flat_info->b); }
+	sv_set_list set_list() const { return(flat_info->sl); }
+
+// The sizes of the node and set-list tables
+
+	sv_integer node_count() const { return(flat_info->nodes); }
+	sv_integer list_count() const { return(flat_info->lists); }
+
+// Node n; 0 is the root.  The children of a leaf are -1, and the set 
+// list of a divided node is the null list.
+
+	mod_kind kind(sv_integer n) const { return((mod_kind)(flat_info->node[n].link & 3)); }
+	sv_real coord(sv_integer n) const { return(flat_info->node[n].coord); }
+	sv_integer child_1(sv_integer n) const;
+	sv_integer child_2(sv_integer n) const;
+	sv_set_list set_list(sv_integer n) const;
+
+// The boxes of the children of node n, given its box b
+
+	sv_box box_1(sv_integer n, const sv_box& b) const;
+	sv_box box_2(sv_integer n, const sv_box& b) const;
+
+// The leaf that contains a point (-1 if it's outside the model); if
+// lb is not 0 the leaf's box is returned in it
+
+	sv_integer leaf(const sv_point&, sv_box* lb) const;
+	sv_integer leaf(const sv_point& p) const { return(leaf(p, 0)); }
+
+// Membership test
+
+	mem_test member(const sv_point&, sv_primitive*) const;
+
+	mem_test member(const sv_point& p) const
+	{
+		sv_primitive x;
+		return(member(p, &x));
+	}
+
+// Ray-trace into the model returning the hit set and ray parameter 
+// (these are in raytrace.cxx)
+
+	sv_set fire_ray(const sv_line&, const sv_interval&, sv_real*) const;
+	sv_set fire_ray(const sv_line&, sv_real*) const;
+
+// report model statistics to a stream
+
+	void div_stat_report(ostream&) const;
+};
+
+// Flat model inlines
+
+inline sv_integer sv_flat_model::child_1(sv_integer n) const
+{
+	sv_integer l = flat_info->node[n].link;
+	if(!(l & 3)) return(-1);
+	return(l >> 2);
+}
+
+inline sv_integer sv_flat_model::child_2(sv_integer n) const
+{
+	sv_integer l = flat_info->node[n].link;
+	if(!(l & 3)) return(-1);
+	return((l >> 2) + 1);
+}
+
+inline sv_set_list sv_flat_model::set_list(sv_integer n) const
+{
+	sv_integer l = flat_info->node[n].link;
+	if(l & 3) return(sv_set_list());
+	return(flat_info->list[l >> 2]);
+}
+
+inline sv_set sv_flat_model::fire_ray(const sv_line& l, sv_real* r) const
+{
+    sv_interval i = line_box(l, box());
+    sv_set result;
+    if(!i.empty())result = fire_ray(l, i, r);
+    return(result);
+}
+
+#endif
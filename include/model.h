@@ -67,6 +67,10 @@ typedef void (*sv_decision) (const sv_model&, sv_integer, void*,  mod_kind*,
 		    
 class sv_div_data;
 
+// The limits on progressive division (see below)
+
+struct sv_div_budget;
+
 // As usual models are handles pointing to a hidden class, with reference
 // counting storage de-allocation
 
@@ -83,6 +87,21 @@ class sv_model
 {
 private:
 
+// What a lazy model needs to divide itself: the decision procedure, its
+// pointer, and the root for root_model() (in model.cxx)
+
+   struct lazy_data : public sv_refct
+   {
+        friend class sv_smart_ptr<lazy_data>;
+
+	sv_decision d;
+	void* vp;
+	sv_model* root;
+
+	lazy_data(const sv_model&, void*, sv_decision);
+	~lazy_data();
+   };
+
    struct model_data : public sv_refct 
    {
         friend class sv_smart_ptr<model_data>;
@@ -97,6 +116,10 @@ private:
 
 	mod_kind kind;		// Leaf, or divided in X, Y, or Z
 	sv_real coord;		// The division coordinate
+
+	sv_smart_ptr<lazy_data> lazy;	// How to divide a lazy leaf
+	sv_integer lazy_level;	// Its level, or -1 if it's not waiting to be divided
+				// (-2 while its division is being filled in)
 	
         ~model_data() { delete child_1; delete child_2; delete p; }
 
@@ -108,6 +131,7 @@ private:
 		sl = sls;
 		kind = LEAF_M;
 		coord = 0;
+		lazy_level = -1;
 	        child_1 = new sv_model();
 	        child_2 = new sv_model();
 	        p = new sv_model(pt);
@@ -121,6 +145,7 @@ private:
 	        b = bx;
 		sl = sls;
 		kind = k;
+		lazy_level = -1;
 		coord = c;
 	        child_1 = new sv_model(c1);
 	        child_2 = new sv_model(c2);
@@ -135,6 +160,7 @@ private:
 	        b = pt.box();
 		sl = pt.set_list();
 		kind = k;
+		lazy_level = -1;
 		coord = c;
 	        child_1 = new sv_model(c1);
 	        child_2 = new sv_model(c2);
@@ -152,6 +178,11 @@ private:
         void set_flags_priv(sv_integer a) { model_info->set_flags(a); }
 	void reset_flags_priv(sv_integer a) { model_info->reset_flags(a); }
 
+// Divide a lazy leaf if it hasn't been yet
+
+	void wake() const { if(sv_atomic_get(&(model_info->lazy_level)) != -1) expand(); }
+	void expand() const;
+
 public:
 
 // Constructor for null model
@@ -195,8 +226,8 @@ public:
 
 	sv_box box() const { return(model_info->b); }
 	sv_set_list set_list() const { return(model_info->sl); }
-	mod_kind kind() const { return(model_info->kind); }
-	sv_real coord() const { return(model_info->coord); }
+	mod_kind kind() const { wake(); return(model_info->kind); }
+	sv_real coord() const { wake(); return(model_info->coord); }
 
 // Return the leaf that contains a point
 
@@ -205,14 +236,19 @@ public:
 // Note that the children may be null if the model is a leaf - check with
 // m_kind first.
 
-	sv_model child_1() const { return(*(model_info->child_1)); }
-	sv_model child_2() const { return(*(model_info->child_2)); }
+	sv_model child_1() const { wake(); return(*(model_info->child_1)); }
+	sv_model child_2() const { wake(); return(*(model_info->child_2)); }
 	sv_model parent() const { return(*(model_info->p)); }
 
 // Make a deep copy
 
 	sv_model deep() const;
 
+// A shallow copy of this model as it is now, but with a new set list;
+// a lazy leaf that hasn't divided yet is copied as an ordinary leaf
+
+	sv_model snapshot(const sv_set_list&) const;
+
 // Return the flags
 	
 	sv_integer flags() const { return(model_info->flags()); }
@@ -244,11 +280,59 @@ public:
 // The redivider
 
 	sv_model redivide(const sv_set_list&, void*, sv_decision) const;
+
+// Redivide after a change to the set list that is confined to the box
+// dirty (for example the union of the old and new boxes round a set 
+// that has moved).  Sub-models whose boxes don't touch it are kept as
+// they are without being pruned again.
+
+	sv_model redivide(const sv_set_list&, const sv_box& dirty, void*, sv_decision) const;
 			
 // The model divider.
 
 	sv_model divide(void* vp, sv_decision) const;
 
+// Breadth-first versions of those, which finish each level of the tree 
+// before starting the next.  Nodes at level stop aren't divided; a 
+// negative stop means no limit.
+
+	sv_model redivide_bf(const sv_set_list&, void*, sv_decision, sv_integer stop) const;
+	sv_model divide_bf(void* vp, sv_decision d, sv_integer stop) const
+	{
+		return(redivide_bf(set_list(), vp, d, stop));
+	}
+	sv_model divide_bf(void* vp, sv_decision d) const
+	{
+		return(redivide_bf(set_list(), vp, d, -1));
+	}
+
+// Lazy division: this returns a leaf that divides itself with the 
+// decision procedure the first time anything looks at its kind, its
+// children or its cut (so member(), leaf(), fire_ray() and so on only 
+// divide the parts of the model they go into).  The children it makes
+// are lazy in turn.  Anything that walks the whole tree divides it all.
+
+	sv_model divide_lazy(void* vp, sv_decision) const;
+
+// Is this a lazy leaf that hasn't divided yet?
+
+	int lazy() const { return(sv_atomic_get(&(model_info->lazy_level)) >= 0); }
+
+// Progressive division, which refines the leaf with the most contents
+// times volume first, and stops when it runs out of budget.  Leaves 
+// already there are refined further, so this can be called again on
+// the model it returns.
+
+	sv_model divide_progressive(void* vp, sv_decision, const sv_div_budget&) const;
+
+// Compaction after division: leaves with the same sets are made to share
+// one set list, and sibling leaves that then share a list are merged 
+// into one leaf (repeatedly, up the tree).  Leaves with polygons and lazy
+// leaves that haven't divided yet are left alone.  div_stat_report() 
+// shows how much there is to be saved.
+
+	sv_model compact() const;
+
 
 // The procedures that (re)facet a model
 
@@ -270,6 +354,13 @@ public:
 		return(member(p, &x));
 	}
 
+// Membership test n points (x[i], y[i], z[i]) at once, putting the
+// answers in r[i].  The answers are the same as member(point) gives; the
+// points are sorted in space and each leaf tests all the points in it in
+// one go, and under SV_PARALLEL big batches use the thread pool.
+
+	void member(const sv_real*, const sv_real*, const sv_real*, mem_test*, sv_integer) const;
+
 // Ray-trace into a model
 
 	sv_set fire_ray(const sv_line&, const sv_interval&, sv_real*) const;
@@ -336,6 +427,7 @@ private:
     sv_set_list new_sl;
     void* user_pointer;
     sv_decision d;
+    const sv_box* dirt;
     
 public:
 
@@ -347,6 +439,18 @@ public:
 	new_sl = sl;
 	user_pointer = up;
 	d = svd;
+	dirt = 0;
+    }
+
+    sv_div_data(const sv_model& m, const sv_set_list& sl, sv_integer i,
+	        void* up, sv_decision svd, const sv_box* db)
+    {
+	md = m;
+	l = i;
+	new_sl = sl;
+	user_pointer = up;
+	d = svd;
+	dirt = db;
     }
     
     sv_model model() const { return(md); }
@@ -356,6 +460,40 @@ public:
     sv_set_list set_list() const { return(new_sl); }
     void* pointer() const { return(user_pointer); }
     sv_decision decision() const { return(d); }
+    const sv_box* dirty() const { return(dirt); }
+};
+
+// *********************************************************************************
+
+// Progress reports from progressive division.  The function is called 
+// with the number of nodes in the tree so far, the number of leaves
+// still waiting to be looked at, the time taken, and the progress_data 
+// pointer.  Returning non-zero stops the division.
+
+typedef int (*sv_div_progress)(sv_integer, sv_integer, sv_real, void*);
+
+// The budget for progressive division; zero for any limit means there 
+// isn't one.  The memory is a rough estimate of that needed by the 
+// model nodes and their leaves' set lists.
+
+struct sv_div_budget
+{
+	sv_real seconds;		// Wall-clock time allowed
+	sv_integer nodes;		// Most nodes in the model
+	sv_integer bytes;		// Most memory for them
+	sv_div_progress progress;	// Called every every divisions (if not 0)
+	sv_integer every;
+	void* progress_data;
+
+	sv_div_budget()
+	{
+		seconds = 0;
+		nodes = 0;
+		bytes = 0;
+		progress = 0;
+		every = 1000;
+		progress_data = 0;
+	}
 };
 
 // *********************************************************************************
@@ -369,10 +507,30 @@ extern sv_model root_model();
 extern void set_swell_fac(sv_real);
 extern sv_real get_swell_fac();
 
+// Depth below which parallel division runs serially
+
+extern void set_serial_level(sv_integer);
+extern sv_integer get_serial_level();
+
 // Two models the same?
 
 extern prim_op same(const sv_model&, const sv_model&);
 
+// Merge two divided models into a divided model of both their set lists,
+// using the cuts of the first and, inside its leaves, those of the 
+// second.  The second is clipped to the box of the first.  It needn't
+// cover the first: if it doesn't, its cuts are ignored, and its set list
+// (which must then hold over all the first's box) is pruned to each of
+// the first's boxes instead.  If a decision procedure is given, leaves
+// that get sets from both models are offered to it for further division.
+
+extern sv_model merge(const sv_model&, const sv_model&);
+extern sv_model merge(const sv_model&, const sv_model&, void*, sv_decision);
+
+// Rough memory cost of a model in bytes
+
+extern sv_integer model_bytes(const sv_model&);
+
 // Normal user i/o functions
 
 extern ostream& operator<<(ostream&, sv_model&);
@@ -442,6 +600,10 @@ inline sv_integer sv_model::polygon_count() const
 // model
 // **************************************************************************
 
+// Flattened models (see flatmod.h) can have their statistics gathered too
+
+class sv_flat_model;
+
 // Structure to accumulate model statistics in
 
 struct m_stats
@@ -478,17 +640,40 @@ struct m_stats
 	
 	sv_box littlest;
 
+	sv_integer leaf_lists;		// Distinct leaf set lists (see compact())
+	sv_integer different_lists;	// How many of those have different sets
+	sv_integer twin_leaves;		// Sibling leaves with the same sets
+
 // Accumulate the statistics
 
 	void model_stats(const sv_model&, m_stats*);
+	void flat_stats(const sv_flat_model&, sv_integer, const sv_box&);
+	void leaf_stats(const sv_set_list&, const sv_box&);
+	void pgl_stats(sv_integer, const sv_box&);
+	void list_stats(const sv_model&);
 	void model_stats_av(m_stats*);
 
+// Print them
+
+	void report(ostream&, const sv_box&, sv_integer) const;
 
 // Zero all the data, then call model_stats
 
 	m_stats(const sv_model& m)
 	{
 		root_m = m;
+		zero(m.box());
+		model_stats(m, this);
+		list_stats(m);
+		model_stats_av(this);
+	}
+
+// The same for a flat model (in flatmod.cxx)
+
+	m_stats(const sv_flat_model&);
+
+	void zero(const sv_box& b)
+	{
 		total_boxes = 0;
 
 		a_volume = 0.0;
@@ -518,10 +703,11 @@ struct m_stats
 		pg_count = 0.0;
 		max_pg_count = 0;
 		
-		littlest = m.box();
+		littlest = b;
 
-		model_stats(m, this);
-		model_stats_av(this);
+		leaf_lists = 0;
+		different_lists = 0;
+		twin_leaves = 0;
 	}
 };
 
@@ -74,6 +74,56 @@ extern istream& operator>>(istream&, prim_op&);
 extern void read(istream&, prim_op&);
 extern void read1(istream&, prim_op&);
 
+// Compiled primitives (see tape.h)
+
+class sv_prim_tape;
+extern void sv_tape_delete(sv_prim_tape*);
+
+// The grad primitives, made when they're first wanted
+
+struct sv_prim_grads;
+extern void sv_grads_delete(sv_prim_grads*);
+
+// Primitive nodes come from a pool rather than one at a time from the
+// heap (see prim.cxx)
+
+extern void* sv_prim_alloc(size_t);
+extern void sv_prim_free(void*);
+
+// Structural hashing; two primitives (or sets) that are built the
+// same way get the same hash, so if the hashes differ they can't be
+// identical
+
+inline unsigned long sv_hash(unsigned long h, unsigned long v)
+{
+	return(h ^ (v + 0x9e3779b9UL + (h << 6) + (h >> 2)));
+}
+
+extern unsigned long sv_hash_real(unsigned long, sv_real);
+extern unsigned long sv_hash_plane(unsigned long, const sv_plane&);
+
+// How the range of a primitive over a box is found.  Plain interval
+// arithmetic is always used; the other methods can be or-ed in, and
+// the tightest answer is taken.  Affine arithmetic keeps the 
+// correlations between the planes in a primitive; the centred form
+// uses the range of the grad and works best on small boxes; the 
+// Bernstein form is for polynomials, and is the tightest of all.
+
+#define SV_RANGE_INTERVAL 0
+#define SV_RANGE_AFFINE 1
+#define SV_RANGE_CENTRED 2
+#define SV_RANGE_BERNSTEIN 4
+
+extern void set_range_mode(sv_integer);
+extern sv_integer get_range_mode();
+
+// Hash-consing: when this is on, identical primitives and sets
+// are shared (see sv_primitive::intern())
+
+extern void hash_consing(sv_integer);
+extern sv_integer hash_consing();
+extern void clean_hash_cons();
+
 
 class sv_primitive
 {
@@ -91,13 +141,24 @@ private:
 	sv_real r;
 	prim_op op;		// If compound, this says +, -, *, /, ^, or one of the monadics
 	sv_integer degree;	// Highest power (trancendentals add one)
-	sv_primitive *child_1;	// Children if compound
-	sv_primitive *child_2;
-	sv_primitive *grad_x;	// The grad vector of the primitive
-	sv_primitive *grad_y;
-	sv_primitive *grad_z;
+	sv_smart_ptr<prim_data> child_1;  // Children if compound
+	sv_smart_ptr<prim_data> child_2;
+	sv_prim_grads* grads;	// The grad vector of the primitive, made when first wanted
+	sv_prim_tape* tape;	// Compiled form, made on first evaluation
+	unsigned long hash;	// Structural hash of all the above
+	sv_integer interned;	// Non-zero if this is in the hash-consing table
+
+// Work out the hash from the node and its children
+
+	void rehash();
+
+        ~prim_data() { sv_grads_delete(grads); sv_tape_delete(tape); }
+
+// Nodes are small and there are lots of them, so they have their own
+// allocator
 
-        ~prim_data() { delete child_1; delete child_2; delete grad_x; delete grad_y; delete grad_z; }
+	static void* operator new(size_t s) { return(sv_prim_alloc(s)); }
+	static void operator delete(void* p) { sv_prim_free(p); }
 
 // Make a single-plane primitive
 
@@ -107,11 +168,10 @@ private:
 		flat = a;
 		degree = 1;
 		op = SV_ZERO;
-		child_1 = new sv_primitive();
-		child_2 = new sv_primitive();
-		grad_x = new sv_primitive();
-		grad_y = new sv_primitive();
-		grad_z = new sv_primitive();
+		grads = 0;
+		tape = 0;
+		interned = 0;
+		rehash();
 	}
 
 // Make a single-real primitive
@@ -122,11 +182,10 @@ private:
 		r = a;
 		degree = 0;
 		op = SV_ZERO;
-		child_1 = new sv_primitive();
-		child_2 = new sv_primitive();
-		grad_x = new sv_primitive();
-		grad_y = new sv_primitive();
-		grad_z = new sv_primitive();
+		grads = 0;
+		tape = 0;
+		interned = 0;
+		rehash();
 	}
 
 // Build a compound primitive from two others and a diadic operator
@@ -158,11 +217,12 @@ private:
 			svlis_error("hidden_prim constructor", 
 			    "dud operator",SV_CORRUPT);
 		}
-		child_1 = new sv_primitive(a);
-		child_2 = new sv_primitive(b);
-		grad_x = new sv_primitive();
-		grad_y = new sv_primitive();
-		grad_z = new sv_primitive();
+		child_1 = a.prim_info;
+		child_2 = b.prim_info;
+		grads = 0;
+		tape = 0;
+		interned = 0;
+		rehash();
 	}
 
 
@@ -173,11 +233,11 @@ private:
 		kind = SV_GENERAL;
 		op = optr;
 		degree = a.degree() + 1; // Sort of convention . . .
-		child_1 = new sv_primitive(a);
-		child_2 = new sv_primitive();
-		grad_x = new sv_primitive();
-		grad_y = new sv_primitive();
-		grad_z = new sv_primitive();
+		child_1 = a.prim_info;
+		grads = 0;
+		tape = 0;
+		interned = 0;
+		rehash();
 	}
 
 // Make a user-primitive
@@ -190,11 +250,10 @@ private:
 		else
 			degree = degree_user(up);
 		op = SV_ZERO;
-		child_1 = new sv_primitive();
-		child_2 = new sv_primitive();
-		grad_x = new sv_primitive();
-		grad_y = new sv_primitive();
-		grad_z = new sv_primitive();
+		grads = 0;
+		tape = 0;
+		interned = 0;
+		rehash();
 	}
    }; // prim_data
 
@@ -202,6 +261,10 @@ private:
 
    sv_smart_ptr<prim_data> prim_info;
 
+// Wrap a node we already have (a child, say)
+
+	sv_primitive(const sv_smart_ptr<prim_data>& p) : prim_info(p) { }
+
 // Build a compound primitive from two others and a diadic operator
 
         sv_primitive(const sv_primitive& a, const sv_primitive& b, prim_op optr)
@@ -223,10 +286,34 @@ private:
 
 // Set the special shapes
 
-    void set_kind(sv_integer k) { prim_info->kind = k; }
+    void set_kind(sv_integer k) { prim_info->kind = k; prim_info->rehash(); }
 
     friend void lazy_grad(const sv_primitive&, sv_primitive&, sv_primitive&, sv_primitive&);
 
+// Fill in the grad slots the first time they're wanted (locked, as
+// primitives may be shared between threads)
+
+    void make_grads() const;
+
+// The grads if they've been made, or 0
+
+    sv_prim_grads* grads() const 
+    { 
+	return((sv_prim_grads*)sv_atomic_get_ptr((void**)&(prim_info->grads))); 
+    }
+
+// The compiled form of the primitive, or 0 if it can't be compiled
+
+    const sv_prim_tape* tape() const;
+
+// The tape, if the grads can be found from it
+
+    const sv_prim_tape* grad_tape() const;
+
+// Exact structural comparison of two nodes (see identical())
+
+    static int identical_r(const prim_data*, const prim_data*);
+
 public:
 
 // Null primitive
@@ -259,8 +346,8 @@ public:
 		sv_point*, sv_line*) const;
 	prim_op op() const { return(prim_info->op); }
 	sv_integer degree() const  { return(prim_info->degree); }
-	sv_primitive child_1() const { return(*(prim_info->child_1)); }
-	sv_primitive child_2() const { return(*(prim_info->child_2)); }
+	sv_primitive child_1() const { return(sv_primitive(prim_info->child_1)); }
+	sv_primitive child_2() const { return(sv_primitive(prim_info->child_2)); }
 	sv_primitive grad_x() const;
 	sv_primitive grad_y() const;
 	sv_primitive grad_z() const;
@@ -269,6 +356,12 @@ public:
 
 	sv_primitive deep() const;
 
+// A new top node for the primitive that shares the rest of it (and its
+// grads, if it has them yet); it's compiled afresh when it's first used.
+// Primitives in the hash-consing table aren't copied.
+
+	sv_primitive copy_top() const;
+
 // The simplifier for the same test
 
 	sv_primitive dump_scales() const;
@@ -303,14 +396,39 @@ public:
 
 	friend int operator==(const sv_primitive& a, const sv_primitive& b) { return(a.unique() == b.unique()); }
 	friend int operator!=(const sv_primitive& a, const sv_primitive& b) { return(!(a == b)); } 
+
+// Structural hash
+
+	unsigned long hash() const { return(prim_info->hash); }
+
+// Primitives are identical if they are built in exactly the same way
+// (this is a quick, exact version of same() that only ever says yes
+// or no)
+
+	friend int identical(const sv_primitive&, const sv_primitive&);
+
+// The shared copy of this from the hash-consing table; the table keeps
+// a reference to every primitive in it until clean_hash_cons() is called
+
+	sv_primitive intern() const;
 	
 // Value of a primitive for a point
 
 	sv_real value(const sv_point&) const;
 
-// Value of a box in a primitive
+// Values of a batch of n points held as x, y and z arrays
+
+	void value(const sv_real*, const sv_real*, const sv_real*, sv_real*, sv_integer) const;
+
+// Value of a box in a primitive, by the methods set by set_range_mode()
+// or by the ones given
+
+	sv_interval range(const sv_box& b) const { return(range(b, get_range_mode())); }
+	sv_interval range(const sv_box&, sv_integer) const;
+
+// Ranges of a batch of n boxes
 
-	sv_interval range(const sv_box&) const;
+	void range(const sv_box*, sv_interval*, sv_integer) const;
 
 // Make special shapes
 
@@ -356,6 +474,10 @@ public:
 
 	sv_point grad(const sv_point& p) const;
 
+// The grad and the value at a point together (value is a side-effect)
+
+	sv_point grad(const sv_point& p, sv_real& v) const;
+
 // Special grad at a point for graphics - grad defined at 0s of
 // primitives that are abs()
 
@@ -367,6 +489,10 @@ public:
 
 	sv_box grad(const sv_box& b) const;
 
+// The ranges of grads and of the value in a box together
+
+	sv_box grad(const sv_box& b, sv_interval& r) const;
+
 // Set flag bit(s)
 
 	void set_flags(sv_integer);
@@ -482,48 +608,45 @@ extern istream& operator>>(istream&, sv_primitive&);
 
 // *************** Inlines
 
-inline sv_primitive sv_primitive::grad_x() const 
+// The grads, all three of which are made together
+
+struct sv_prim_grads
 {
-        sv_primitive x, y, z;
-	if (!prim_info->grad_x->exists()) 
+	sv_primitive x, y, z;
+
+	sv_prim_grads(const sv_primitive& a, const sv_primitive& b, const sv_primitive& c) 
 	{
-	  lazy_grad(*this, x, y, z);
-	  *(prim_info->grad_x) = x;
-	  *(prim_info->grad_y) = y;
-	  *(prim_info->grad_z) = z;
+		x = a;
+		y = b;
+		z = c;
 	}
-	return(*(prim_info->grad_x));
+};
+
+inline sv_primitive sv_primitive::grad_x() const 
+{
+	if (!grads()) make_grads();
+	return(grads()->x);
 }
 
 inline sv_primitive sv_primitive::grad_y() const 
 {
-        sv_primitive x, y, z;
-	if (!prim_info->grad_y->exists()) 
-	{
-	  lazy_grad(*this, x, y, z);
-	  *(prim_info->grad_x) = x;
-	  *(prim_info->grad_y) = y;
-	  *(prim_info->grad_z) = z;
-	}
-	return(*(prim_info->grad_y));
+	if (!grads()) make_grads();
+	return(grads()->y);
 }
 
 inline sv_primitive sv_primitive::grad_z() const 
 {
-        sv_primitive x, y, z;
-	if (!prim_info->grad_z->exists()) 
-	{
-	  lazy_grad(*this, x, y, z);
-	  *(prim_info->grad_x) = x;
-	  *(prim_info->grad_y) = y;
-	  *(prim_info->grad_z) = z;
-	}
-	return(*(prim_info->grad_z));
+	if (!grads()) make_grads();
+	return(grads()->z);
 }
 
 
 extern look_up<sv_primitive> p_write_list; 
 
+// The hash-consing table (see sv_primitive::intern())
+
+extern sv_intern_table<sv_primitive> p_intern_table;
+
 // Monadic functions
 
 inline sv_primitive operator-(const sv_primitive& a)
@@ -535,6 +658,7 @@ inline sv_primitive operator-(const sv_primitive& a)
 	b.prim_info->kind = a.kind();	// Shape's the same
 	if(a.kind() == SV_REAL) b.prim_info->r = -a.real();
 	if(a.kind() == SV_PLANE) b.prim_info->flat = -a.plane();
+	b.prim_info->rehash();
 	return(b);
 }
 
@@ -660,6 +784,49 @@ inline int p_thin(const sv_primitive& q)
 	return(result);
 }
 
+// A memo of the ranges of primitives in one box.  The same primitive
+// often turns up many times in a set (in a set and its complement, in
+// blends, and in several sets of a list); pruning with one of these
+// works out the range of each distinct primitive just once.  A
+// complement's range is the negation of its child's, so they share
+// an entry.
+
+#define SV_RANGE_MEMO 16	// Entries kept on the stack
+
+class sv_range_memo
+{
+private:
+
+	sv_box b;		// The box
+	sv_integer mode;	// The range mode when the memo was made
+	sv_integer size;	// Length of the table (a power of 2)
+	sv_integer used;	// Entries in it
+	long* key;		// Primitives' unique()s, or 0
+	sv_interval* val;	// Their ranges
+	long key_s[SV_RANGE_MEMO];
+	sv_interval val_s[SV_RANGE_MEMO];
+
+	void grow();
+
+// No copying
+
+	sv_range_memo(const sv_range_memo&);
+	sv_range_memo& operator=(const sv_range_memo&);
+
+public:
+
+	explicit sv_range_memo(const sv_box&);
+	~sv_range_memo() { if(key != key_s) { delete [] key; delete [] val; } }
+
+// The box
+
+	const sv_box& box() const { return(b); }
+
+// The range of a primitive in the box
+
+	sv_interval range(const sv_primitive&);
+};
+
 // sv_primitive
 // **************************************************************************
 
@@ -141,6 +141,11 @@ extern void set_seed(sv_integer);
 extern sv_integer ran_int();
 extern sv_real ran_real();
 
+// Elapsed wall-clock time in seconds from some arbitrary origin; this is
+// double as seconds since 1970 need more than a float's precision
+
+extern double sv_wall_time();
+
 // Are two reals pretty close?
 
 extern sv_real sv_same_tol;
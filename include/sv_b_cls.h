@@ -76,8 +76,7 @@ public:
 #include <pthread.h>
 #endif
 
-// This allows reference counts (and other things)
-// to be locked
+// This allows shared data to be locked
 
 // Unix lock definition
 
@@ -178,17 +177,86 @@ class sv_smart_ptr
 
 
 
+// Atomic operations on reference counts, flag words and states.  GNU-compatible
+// compilers have these built in (they are what the C++11 std::atomic
+// is made from); elsewhere they fall back to one lock shared by all.
+// Decrements release what the thread did to the object and acquire
+// what everyone else did, so whoever deletes it sees it complete.
+
+#ifdef __GNUC__
+
+inline sv_integer sv_atomic_inc(sv_integer* a) { return(__atomic_add_fetch(a, 1, __ATOMIC_RELAXED)); }
+inline sv_integer sv_atomic_dec(sv_integer* a) { return(__atomic_sub_fetch(a, 1, __ATOMIC_ACQ_REL)); }
+inline sv_integer sv_atomic_get(const sv_integer* a) { return(__atomic_load_n(a, __ATOMIC_ACQUIRE)); }
+inline void sv_atomic_set(sv_integer* a, sv_integer b) { __atomic_store_n(a, b, __ATOMIC_RELEASE); }
+inline void sv_atomic_or(sv_integer* a, sv_integer b) { __atomic_or_fetch(a, b, __ATOMIC_ACQ_REL); }
+inline void sv_atomic_and(sv_integer* a, sv_integer b) { __atomic_and_fetch(a, b, __ATOMIC_ACQ_REL); }
+inline int sv_atomic_cas(sv_integer* a, sv_integer old, sv_integer nw)
+{
+	return(__atomic_compare_exchange_n(a, &old, nw, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+}
+
+// Pointers that are filled in lazily: get one, or set it if it's still old
+
+inline void* sv_atomic_get_ptr(void** a) { return(__atomic_load_n(a, __ATOMIC_ACQUIRE)); }
+inline int sv_atomic_set_ptr(void** a, void* old, void* nw)
+{
+	return(__atomic_compare_exchange_n(a, &old, nw, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+}
+
+#else
+
+extern sv_lock sv_atomic_lock;
+
+inline sv_integer sv_atomic_inc(sv_integer* a)
+{
+	sv_atomic_lock.shut(); sv_integer r = ++(*a); sv_atomic_lock.open(); return(r);
+}
+inline sv_integer sv_atomic_dec(sv_integer* a)
+{
+	sv_atomic_lock.shut(); sv_integer r = --(*a); sv_atomic_lock.open(); return(r);
+}
+inline sv_integer sv_atomic_get(const sv_integer* a)
+{
+	sv_atomic_lock.shut(); sv_integer r = *a; sv_atomic_lock.open(); return(r);
+}
+inline void sv_atomic_set(sv_integer* a, sv_integer b)
+{
+	sv_atomic_lock.shut(); *a = b; sv_atomic_lock.open();
+}
+inline void sv_atomic_or(sv_integer* a, sv_integer b)
+{
+	sv_atomic_lock.shut(); *a = *a | b; sv_atomic_lock.open();
+}
+inline void sv_atomic_and(sv_integer* a, sv_integer b)
+{
+	sv_atomic_lock.shut(); *a = *a & b; sv_atomic_lock.open();
+}
+inline int sv_atomic_cas(sv_integer* a, sv_integer old, sv_integer nw)
+{
+	sv_atomic_lock.shut(); int r = (*a == old); if(r) *a = nw; sv_atomic_lock.open(); return(r);
+}
+inline void* sv_atomic_get_ptr(void** a)
+{
+	sv_atomic_lock.shut(); void* r = *a; sv_atomic_lock.open(); return(r);
+}
+inline int sv_atomic_set_ptr(void** a, void* old, void* nw)
+{
+	sv_atomic_lock.shut(); int r = (*a == old); if(r) *a = nw; sv_atomic_lock.open(); return(r);
+}
+
+#endif
+
 // Base class for reference-counted objects
 // This also includes the flag word, which is common
-// to all such objects, and record locking for
-// running on parallel machines.
+// to all such objects.  Both are changed atomically, so
+// objects can be shared between threads without locks.
 
 class sv_refct
 {
  protected:
 
    sv_integer ref_count;  // The reference count
-   sv_lock lock;          // Record locking
    sv_integer f;          // Flag bits
 
    sv_refct()
@@ -209,39 +277,18 @@ class sv_refct
 
   public:
 
-   void add_reference() 
-   {
-     lock.shut(); 
-     ++ref_count;
-     lock.open();
-   }
+   void add_reference() { sv_atomic_inc(&ref_count); }
 
    virtual void remove_reference() 
    {
-     lock.shut();
-     if (--ref_count <= 0) 
-     {
-         lock.open();
-         delete this;
-     } else
-         lock.open();
+     if (sv_atomic_dec(&ref_count) <= 0) delete this;
    }
 
-   sv_integer flags() { return(f); }
+   sv_integer flags() { return(sv_atomic_get(&f)); }
 
-   void set_flags(sv_integer a) 
-   {
-     lock.shut(); 
-     f = f | a; 
-     lock.open();
-   }
+   void set_flags(sv_integer a) { sv_atomic_or(&f, a); }
 
-   void reset_flags(sv_integer a)
-   {
-     lock.shut(); 
-     f = f & (~a); 
-     lock.open();
-   }
+   void reset_flags(sv_integer a) { sv_atomic_and(&f, ~a); }
 };
 
 
@@ -401,5 +448,104 @@ a:             id[inow] = tc;
 };
 
 
+// Hash-consing table template class.  T must have hash() and exists(),
+// and there must be an intern_match(const T&, const T&) that says
+// whether two items may be shared.  The table is open-addressed and
+// keeps a reference to everything in it until it is cleaned.
+
+#define SV_INTERN_LEN 1024
+
+template<class T>
+class sv_intern_table
+{
+	T* entry;                 // The shared items
+	sv_integer length;        // Table length (always a power of 2)
+	sv_integer used;          // Number of entries in use
+	sv_lock lock;             // The table is shared between threads
+
+// Put p in the first free slot for its hash
+
+	void place(const T& p)
+	{
+	     sv_integer i = (sv_integer)(p.hash() & (unsigned long)(length - 1));
+	     while(entry[i].exists()) i = (i + 1) & (length - 1);
+	     entry[i] = p;
+	}
+
+// Double the table length (or start it off)
+
+	void grow()
+	{
+	     T* old = entry;
+	     sv_integer old_len = length;
+
+	     if(length)
+	       length = 2*length;
+	     else
+	       length = SV_INTERN_LEN;
+	     entry = new T[length];
+	     for(sv_integer i = 0; i < old_len; i++)
+	       if(old[i].exists()) place(old[i]);
+	     delete [] old;
+	}
+
+public:
+
+    sv_intern_table()
+    {
+      entry = 0;
+      length = 0;
+      used = 0;
+    }
+
+// Return the shared item matching p; if there isn't one, p
+// becomes it.
+
+    T find_or_add(const T& p)
+    {
+        T result = p;
+	sv_integer i;
+
+	lock.shut();
+	if(2*(used + 1) > length) grow();
+	i = (sv_integer)(p.hash() & (unsigned long)(length - 1));
+	while(entry[i].exists())
+	{
+	     if((entry[i].hash() == p.hash()) && intern_match(entry[i], p))
+	     {
+	          result = entry[i];
+		  lock.open();
+		  return(result);
+	     }
+	     i = (i + 1) & (length - 1);
+	}
+	entry[i] = p;
+	used++;
+	lock.open();
+	return(result);
+    }
+
+// How many things are shared
+
+    sv_integer count() const { return(used); }
+
+// Set the table empty, releasing the references
+
+    void clean()
+    {
+      T* old;
+
+      lock.shut();
+      old = entry;
+      entry = 0;
+      length = 0;
+      used = 0;
+      lock.open();
+      delete [] old;
+    }
+
+};
+
+
 
 #endif
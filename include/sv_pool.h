@@ -0,0 +1,112 @@
+/* 
+ *  The SvLis Geometric Modelling Kernel
+ *  ------------------------------------
+ *
+ *  Copyright (C) 1993, 1997, 1998, 2000 
+ *  University of Bath & Information Geometers Ltd
+ *
+ *  http://www.bath.ac.uk/
+ *  http://www.inge.com/
+ *
+ *  Principal author:
+ *
+ *     Adrian Bowyer
+ *     Department of Mechanical Engineering
+ *     Faculty of Engineering and Design
+ *     University of Bath
+ *     Bath BA2 7AY
+ *     U.K.
+ *
+ *     e-mail: A.Bowyer@bath.ac.uk
+ *        web: http://www.bath.ac.uk/~ensab/
+ *
+ *   SvLis is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   Licence as published by the Free Software Foundation; either
+ *   version 2 of the Licence, or (at your option) any later version.
+ *
+ *   SvLis is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public Licence for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   Licence along with svLis; if not, write to the Free
+ *   Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA,
+ *   or see
+ *
+ *      http://www.gnu.org/
+ * 
+ * =====================================================================
+ *
+ * SvLis - a persistent work-stealing pool of threads
+ *
+ * See the svLis web site for the manual and other details:
+ *
+ *    http://www.bath.ac.uk/~ensab/G_mod/Svlis/
+ *
+ * or see the file
+ *
+ *    docs/svlis.html
+ *
+ * First version: 18 October 2026
+ * This version: 18 October 2026
+ *
+ */
+
+
+#ifndef SVLIS_POOL
+#define SVLIS_POOL
+
+// A fixed set of worker threads, started on demand and kept for the
+// life of the program, that run fork-join tasks.  Each thread has its
+// own deque of tasks; it takes work from the bottom of its own deque and,
+// when that is empty, steals from the top of everyone else's.
+// A thread that waits for its tasks to finish runs other tasks while
+// it waits, so tasks may spawn tasks to any depth without deadlock.
+
+// The form of a task
+
+typedef void (*sv_task_fn)(void*);
+
+struct sv_task;
+
+// A group of tasks that are waited for together
+
+class sv_task_group
+{
+private:
+
+	sv_integer pending;	// Tasks spawned but not yet finished
+
+	friend void sv_run_task(const sv_task&);
+
+public:
+
+	sv_task_group() { pending = 0; }
+
+	~sv_task_group() { wait(); }
+
+// Spawn fn(arg); if the pool is not running this just calls it
+
+	void run(sv_task_fn fn, void* arg);
+
+// Wait for all the tasks spawned in this group to finish, helping
+// out with any other work there is in the meantime
+
+	void wait();
+};
+
+// Set and return the number of threads that do work (including the
+// thread that spawns the tasks).  1 or less runs everything serially.
+// The default is the number of processors on the machine.  Don't call
+// set_worker_threads while tasks are running.
+
+extern void set_worker_threads(sv_integer);
+extern sv_integer get_worker_threads();
+
+// Stop and join all the worker threads (they restart on demand)
+
+extern void sv_pool_end();
+
+#endif
@@ -70,6 +70,10 @@ extern void write(ostream&, set_op);
 
 sv_integer sv_c_flag(const sv_primitive&);
 
+// Lock for making and breaking the link between a set and its complement
+
+extern sv_lock sv_complement_lock;
+
 
 class sv_set
 {
@@ -88,42 +92,45 @@ private:
         sv_set *child_1;	// Children if the set is compound
         sv_set *child_2;
         sv_set *complement;	// The set's complement (see -set)
+        unsigned long hash;	// Structural hash of the geometry
+        sv_integer interned;	// Non-zero if this is in the hash-consing table
+        sv_real* bound;		// Bounding box low x, y, z then high, or 0 till it's wanted
+
+// Work out the hash from the node and its children
 
-        ~set_data() { delete child_1; delete child_2; delete complement; }
+        void rehash();
 
-// Special reference count decrement to handle *complement <-> *this
+        ~set_data() { delete child_1; delete child_2; delete complement; delete [] bound; }
+
+// Special reference count decrement to handle *complement <-> *this.
+// A set and its complement point at each other, so when each is only
+// referred to by the other they must both go.  Only sets that have a
+// complement need the lock; it stops two threads deciding at once.
 
         void remove_reference()
         {
-           lock.shut();
-           --ref_count;
+           sv_integer n;
 
-           if ((ref_count == 1) && complement->exists()) // From the complement?
+           if (!complement->exists())
            {
-	      complement->set_info->lock.shut();
-	      if(complement->set_info->ref_count == 1)
-	      {
-		ref_count = 10; // Hack
-		complement->set_info->lock.open();
-		lock.open();
-		delete complement;
-		complement = 0;
-		delete this;
-	      } else
-	      {
-		complement->set_info->lock.open();
-		lock.open();
-	      }
-
-	      return;
-           } 
-
-           if (ref_count <= 0) 
+              if (sv_atomic_dec(&ref_count) <= 0) delete this;
+              return;
+           }
+
+           sv_complement_lock.shut();
+           n = sv_atomic_dec(&ref_count);
+           if ((n == 1) && (sv_atomic_get(&(complement->set_info->ref_count)) == 1)) // From the complement?
            {
-              lock.open();
+              sv_complement_lock.open();
+              ref_count = 10; // Hack
+              delete complement;
+              complement = 0;
               delete this;
-           } else
-              lock.open();
+              return;
+           }
+           sv_complement_lock.open();
+
+           if (n <= 0) delete this;
         }
 
 // Constructor for when it's all or nothing.
@@ -137,6 +144,9 @@ private:
 		child_1 = new sv_set();
 		child_2 = new sv_set();
 		complement = new sv_set();
+		interned = 0;
+		bound = 0;
+		rehash();
 	}
 
 // Constructor for set that will be a simple primitive 
@@ -153,7 +163,10 @@ private:
 	   } else
 	        contents = 1;
 
-	   prim = p;
+	   if (hash_consing())
+		prim = p.intern();
+	   else
+		prim = p;
 
 // A single plane is a convex polygon - sv_c_flag detects this
 
@@ -161,6 +174,9 @@ private:
 	   child_1 = new sv_set();
 	   child_2 = new sv_set();
 	   complement = new sv_set();
+	   interned = 0;
+	   bound = 0;
+	   rehash();
         }
 
 // Constructor to build a compound set
@@ -172,9 +188,12 @@ private:
 		child_1 = new sv_set(a);
 		child_2 = new sv_set(b);
 	        complement = new sv_set();
+		interned = 0;
+		bound = 0;
+		rehash();
 	}
 
-// Set the complenment
+// Set the complenment (unlocked - see sv_set::pair_complement)
 
         void set_complement(const sv_set& c) 
         {
@@ -192,6 +211,7 @@ private:
 
 	sv_set complement() const { return(*(set_info->complement)); }
 	void complement(const sv_set& c) { set_info->set_complement(c); }
+	sv_set pair_complement(const sv_set&) const;
 
 // Constructor for set that is compound.
 
@@ -208,6 +228,27 @@ private:
 
    sv_smart_ptr<set_data> set_info;
 
+// The bounding box as low x, y, z and high x, y, z, worked out when
+// it's first wanted.  It's filled in lazily, like primitives' tapes, and
+// never changes after that, so threads can share it without locks.
+
+   const sv_real* bound_got() const
+   {
+	return((const sv_real*)sv_atomic_get_ptr((void**)&(set_info->bound)));
+   }
+   const sv_real* bound_p() const;
+   void make_bound() const;
+   void make_bounds() const;
+
+// Exact structural comparison of two nodes (see identical())
+
+   static int identical_r(const set_data*, const set_data*);
+
+// Value for a point, noting the winning leaf and the lowest set above
+// it with an attribute (see value())
+
+   sv_real value_r(const sv_point&, const sv_set**, const sv_set**) const;
+
 
 public:
 
@@ -264,6 +305,20 @@ public:
 
 	long unique() const { return(set_info.unique()); }
 
+// Structural hash (of the geometry only)
+
+	unsigned long hash() const { return(set_info->hash); }
+
+// Sets are identical if their geometry is built in exactly the
+// same way (a quick, exact version of same())
+
+	friend int identical(const sv_set&, const sv_set&);
+
+// The shared copy of this from the hash-consing table (see
+// sv_primitive::intern()); the attributes stay with this one
+
+	sv_set intern() const;
+
 // Unique tag
 
 	sv_integer tag() const;
@@ -298,6 +353,10 @@ public:
 
 	mem_test member(const sv_point&, sv_primitive []) const;
 
+// Membership test a batch of n points held as x, y and z arrays
+
+	void member(const sv_real*, const sv_real*, const sv_real*, mem_test*, sv_integer) const;
+
 // Value for a point (and winning leaf)
 
 	sv_real value(const sv_point&, sv_set*) const;
@@ -306,10 +365,38 @@ public:
 
 	sv_interval range(const sv_box&, sv_set*, sv_set*) const;
 
+// A conservative bounding box for the set, worked out the first time
+// it's wanted and kept.  It's exact for sets made of planes with
+// intersections, and for spheres, cylinders and tori it comes from
+// their sizes.  Other primitives are only found to be empty or not by
+// interval arithmetic, unless set_bound_search() is on.  If the set's
+// empty the box is too, and where the set is unbounded the box reaches
+// SV_BOUND_BIG.
+
+	sv_box bound() const;
+
+// Quick tests with the bounding box that the set is certainly empty in
+// a box, at a point, or along a line between parameters t0 and t1
+// (these can only say so for places inside SV_BOUND_BIG)
+
+	int misses(const sv_box&) const;
+	int misses(const sv_point&) const;
+	int misses(const sv_line&, sv_real, sv_real) const;
+
 // Prune a set to a box
 
 	sv_set prune(const sv_box&) const;
 
+// Range and pruning for the box of a memo of primitive ranges (see
+// prim.h), which may be shared by many sets pruned to the same box
+
+	sv_interval range(sv_range_memo&, sv_set*, sv_set*) const;
+	sv_set prune(sv_range_memo&) const;
+
+// Prune a set to each of n boxes in one pass
+
+	void prune(const sv_box*, sv_set*, sv_integer) const;
+
 // Return the characteristic point of a set
 
 	sv_point point() const;
@@ -340,6 +427,13 @@ public:
 
 	sv_set regularize() const;
 
+// An equivalent set that's quicker to classify against: runs of unions
+// or intersections are flattened, their cheapest parts put first, and
+// the tree balanced.  Its primitives are laid out in memory in the
+// order the new tree visits them, so value() doesn't get slower.
+
+	sv_set optimise() const;
+
 // Attribute stuff.
 // Colour, string, and polygons as attributes - special member functions cos 
 // they're so common, also surface
@@ -409,11 +503,22 @@ extern istream& operator>>(istream&, sv_set&);
 
 extern look_up<sv_set> s_write_list;
 
+// The hash-consing table for sets
+
+extern sv_intern_table<sv_set> s_intern_table;
+
 // Set flag for whether the results of pruning are
 // regularized (true forces regularization)
 
 extern void regular_prune(sv_integer);
 
+// Set flag for whether primitives other than planes, spheres, cylinders,
+// cones and tori get their bounds by a search with interval arithmetic
+// (tighter, but it takes thousands of range evaluations each)
+
+extern void set_bound_search(sv_integer);
+extern sv_integer get_bound_search();
+
 // ************** Inlines
 
 // Simplest way to subtract a point is to negate it and add
@@ -573,6 +678,11 @@ public:
 // Prune a set list to a box
 
 	sv_set_list prune(const sv_box&) const;
+	sv_set_list prune(sv_range_memo&) const;
+
+// Prune a set list to each of n boxes in one pass
+
+	void prune(const sv_box*, sv_set_list*, sv_integer) const;
 
 // Operators on collections of sets... 
 
@@ -600,6 +710,10 @@ public:
 
         sv_set_list percolate() const;
 
+// Optimise all the sets in the list (see sv_set::optimise())
+
+	sv_set_list optimise() const;
+
 // Polygons
 
 	sv_integer polygon_count() const;
@@ -717,5 +831,95 @@ inline void sv_set_list::replace_set(const sv_set& sold,  const sv_set& snew)
 // sv_set_list
 // *************************************************************************
 
+// Set lists compiled for pruning.  An sv_set_tree numbers the nodes of 
+// the sets in a list in an array that never changes; a node shared
+// between sets, or within one, is only in the array once.  Pruning it to a box
+// makes no new sets; it just records what happens to each node in an
+// sv_prune_mask (a byte a node), and the pruned set list - the same as 
+// sv_set_list::prune(...) would give - is only built if it's wanted.
+// As the tree isn't changed by pruning, many threads can prune it at 
+// once, each with its own mask.
+
+class sv_set_tree;
+
+class sv_prune_mask
+{
+private:
+
+	unsigned char* state;	// What happened to each node
+	sv_integer n;		// Length of state
+	sv_integer cts;		// The contents of the pruned list
+	sv_box b;		// The box pruned to
+
+	friend class sv_set_tree;
+
+// No copying
+
+	sv_prune_mask(const sv_prune_mask&);
+	sv_prune_mask& operator=(const sv_prune_mask&);
+
+public:
+
+	sv_prune_mask() { state = 0; n = 0; cts = 0; }
+	~sv_prune_mask() { delete [] state; }
+
+// The contents of the pruned set list, as sv_set_list::contents() (this
+// may be an overestimate in the rare cases where | or & would find the
+// two pruned halves of a set to be the same set, except when pruning is
+// regularized, when the list is built to count it)
+
+	sv_integer contents() const { return(cts); }
+
+// The box it was pruned to
+
+	sv_box box() const { return(b); }
+};
+
+class sv_set_tree
+{
+private:
+
+	struct node
+	{
+		sv_set s;		// The set the node came from
+		sv_primitive p;		// Its primitive if it has one
+		sv_integer c_1, c_2;	// Its children, or -1
+		sv_integer contents;
+		set_op op;
+	};
+
+	sv_set_list sl;		// The list compiled
+	node* nd;		// The nodes
+	sv_integer nodes;
+	sv_integer* root;	// The nodes of the sets in the list
+	sv_integer sets;
+
+	struct index;		// Nodes already seen, by unique()
+
+	sv_integer count(const sv_set&, index*) const;
+	sv_integer add(const sv_set&, sv_integer*, index*);
+	sv_integer prune_r(sv_integer, sv_range_memo&, unsigned char*) const;
+	sv_set build(sv_integer, const sv_prune_mask&) const;
+	sv_set_list build_list(sv_integer, const sv_prune_mask&) const;
+
+// No copying
+
+	sv_set_tree(const sv_set_tree&);
+	sv_set_tree& operator=(const sv_set_tree&);
+
+public:
+
+	sv_set_tree(const sv_set_list&);
+	~sv_set_tree();
+
+// Prune to a box
+
+	void prune(const sv_box&, sv_prune_mask*) const;
+
+// Build the pruned set list
+
+	sv_set_list set_list(const sv_prune_mask&) const;
+};
+
 #endif
 
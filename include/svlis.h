@@ -66,12 +66,16 @@
 #include "geometry.h"
 #include "interval.h"
 #include "sv_b_cls.h"
+#include "sv_pool.h"
 #include "prim.h"
+#include "tape.h"
 #include "attrib.h"
 #include "sv_set.h"
 #include "decision.h"
 #include "polygon.h"
 #include "model.h"
+#include "flatmod.h"
+#include "tune.h"
 
 // Useful extras
 
@@ -0,0 +1,214 @@
+/* 
+ *  The SvLis Geometric Modelling Kernel
+ *  ------------------------------------
+ *
+ *  Copyright (C) 1993, 1997, 1998, 2000 
+ *  University of Bath & Information Geometers Ltd
+ *
+ *  http://www.bath.ac.uk/
+ *  http://www.inge.com/
+ *
+ *  Principal author:
+ *
+ *     Adrian Bowyer
+ *     Department of Mechanical Engineering
+ *     Faculty of Engineering and Design
+ *     University of Bath
+ *     Bath BA2 7AY
+ *     U.K.
+ *
+ *     e-mail: A.Bowyer@bath.ac.uk
+ *        web: http://www.bath.ac.uk/~ensab/
+ *
+ *   SvLis is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   Licence as published by the Free Software Foundation; either
+ *   version 2 of the Licence, or (at your option) any later version.
+ *
+ *   SvLis is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public Licence for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   Licence along with svLis; if not, write to the Free
+ *   Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA,
+ *   or see
+ *
+ *      http://www.gnu.org/
+ * 
+ * =====================================================================
+ *
+ * SvLis - primitives compiled into flat evaluation tapes
+ *
+ * See the svLis web site for the manual and other details:
+ *
+ *    http://www.bath.ac.uk/~ensab/G_mod/Svlis/
+ *
+ * or see the file
+ *
+ *    docs/svlis.html
+ *
+ * First version: 18 October 2026
+ * This version: 18 October 2026
+ *
+ */
+
+
+#ifndef SVLIS_TAPE
+#define SVLIS_TAPE
+
+// A primitive tree is compiled into a tape: a list of steps, each of
+// which does one operation on a small file of registers.  The steps are 
+// in evaluation order so the tape can be run by a simple loop for both
+// point values and interval ranges, with no recursion, no smart-pointer
+// copies and no reference counting.  Registers are allocated in
+// Sethi-Ullman order, so a tree of n nodes needs at most log2(n) + 1.
+
+#define SV_TAPE_REGS 32
+
+// Batches of points are evaluated this many at a time; it must be a
+// multiple of the widest vector (8 floats for AVX)
+
+#define SV_TAPE_BLOCK 64
+
+// Polynomial tapes up to this degree can have their ranges found in
+// Bernstein form, subdividing boxes up to SV_BERN_SPLIT times where 
+// the bounds straddle 0
+
+#define SV_BERN_DEGREE 8
+#define SV_BERN_SPLIT 3
+
+// What a step does.  The _K forms have a real as their second argument,
+// the K_ forms have one as their first; those are inline in the range 
+// evaluation just as in sv_primitive::range(...)
+
+enum sv_tape_code
+{
+	SVTP_PLANE,	// d = plane[i]
+	SVTP_USER,	// d = user or svLis-supplied primitive number i
+	SVTP_PLUS,	// d = a + b
+	SVTP_PLUS_K,	// d = a + k
+	SVTP_K_PLUS,	// d = k + a
+	SVTP_MINUS,	// d = a - b
+	SVTP_MINUS_K,	// d = a - k
+	SVTP_K_MINUS,	// d = k - a
+	SVTP_TIMES,	// d = a*b
+	SVTP_TIMES_K,	// d = a*k
+	SVTP_K_TIMES,	// d = k*a
+	SVTP_DIVIDE_K,	// d = a/k
+	SVTP_POW,	// d = a^i
+	SVTP_COMP,	// d = -a
+	SVTP_ABS,	// d = |a| and so on
+	SVTP_SIN,
+	SVTP_COS,
+	SVTP_EXP,
+	SVTP_SSQRT,
+	SVTP_SIGN
+};
+
+// The power-basis form of a polynomial tape: c[(i*(n+1) + j)*(n+1) + k]
+// is the coefficient of x^i y^j z^k.  n is -1 if the tape isn't a 
+// polynomial of degree SV_BERN_DEGREE or less.
+
+struct sv_tape_poly
+{
+	sv_integer n;
+	double* c;
+
+	sv_tape_poly() { n = -1; c = 0; }
+	~sv_tape_poly() { delete [] c; }
+};
+
+struct sv_tape_step
+{
+	sv_integer code;	// An sv_tape_code
+	sv_integer d;		// Destination register
+	sv_integer a, b;	// Argument registers
+	sv_real k;		// Real argument
+	sv_integer i;		// Plane index, primitive kind, or exponent
+};
+
+class sv_prim_tape
+{
+private:
+
+	sv_tape_step* step;	// The steps, in order
+	sv_integer steps;
+	sv_plane* plane;	// The planes at the leaves
+	sv_integer planes;
+	sv_integer regs;	// Number of registers used
+	sv_integer user_steps;	// Number of user primitive steps
+	sv_integer rough_steps;	// Number of steps that aren't smooth (|a| etc)
+	sv_tape_poly* poly;	// Power-basis form, made when first wanted
+
+// Make the power-basis form
+
+	sv_tape_poly* make_poly() const;
+
+// No copying
+
+	sv_prim_tape(const sv_prim_tape&);
+	sv_prim_tape& operator=(const sv_prim_tape&);
+
+public:
+
+	sv_prim_tape();
+	~sv_prim_tape();
+
+// Compile a primitive; returns 0 if it can't be done (in which case
+// the primitive must be evaluated the old way)
+
+	int compile(const sv_primitive&);
+
+// Evaluate the tape
+
+	sv_real value(const sv_point&) const;
+	sv_interval range(const sv_box&) const;
+
+// Value and grad together in one pass, for a point and over a box.  
+// These return 0 if the tape has user primitives in it (see users()), 
+// which have no grads.
+
+	int grad(const sv_point&, sv_real*, sv_point*) const;
+	int grad(const sv_box&, sv_interval*, sv_box*) const;
+
+// Tighter ranges over a box (see sv_primitive::range(box, mode)).
+// affine() uses affine arithmetic with a noise symbol for each axis of
+// the box.  centred() uses the mean-value form, which needs the grad, so
+// it returns 0 if the tape has any user primitives, |a|, s_sqrt or sign
+// in it.
+
+	sv_interval affine(const sv_box&) const;
+	int centred(const sv_box&, sv_interval*) const;
+
+// Range over a box from the polynomial's coefficients in the Bernstein
+// basis for the box.  This returns 0 if the tape isn't a polynomial
+// (it has |a|, s_sqrt, sign, sin, cos, exp or user primitives in it) or
+// its degree is more than SV_BERN_DEGREE.
+
+	int bernstein(const sv_box&, sv_interval*) const;
+
+// Evaluate the tape for n points held as separate x, y and z arrays,
+// putting the values in v.  This uses SSE or AVX vector arithmetic if
+// the compiler is allowed to, and gives the same answers as value(point)
+
+	void value(const sv_real*, const sv_real*, const sv_real*, sv_real*, sv_integer) const;
+
+// Evaluate the tape for n boxes, putting the ranges in v.  Again the 
+// answers are the same as range(box).
+
+	void range(const sv_box*, sv_interval*, sv_integer) const;
+
+	sv_integer length() const { return(steps); }
+	sv_integer registers() const { return(regs); }
+	sv_integer users() const { return(user_steps); }
+};
+
+// The same for a single plane
+
+extern void sv_plane_value(const sv_plane&, const sv_real*, const sv_real*, 
+	const sv_real*, sv_real*, sv_integer);
+extern void sv_plane_range(const sv_plane&, const sv_box*, sv_interval*, sv_integer);
+
+#endif
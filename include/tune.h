@@ -0,0 +1,105 @@
+/* 
+ *  The SvLis Geometric Modelling Kernel
+ *  ------------------------------------
+ *
+ *  Copyright (C) 1993, 1997, 1998, 2000 
+ *  University of Bath & Information Geometers Ltd
+ *
+ *  http://www.bath.ac.uk/
+ *  http://www.inge.com/
+ *
+ *  Principal author:
+ *
+ *     Adrian Bowyer
+ *     Department of Mechanical Engineering
+ *     Faculty of Engineering and Design
+ *     University of Bath
+ *     Bath BA2 7AY
+ *     U.K.
+ *
+ *     e-mail: A.Bowyer@bath.ac.uk
+ *        web: http://www.bath.ac.uk/~ensab/
+ *
+ *   SvLis is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   Licence as published by the Free Software Foundation; either
+ *   version 2 of the Licence, or (at your option) any later version.
+ *
+ *   SvLis is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public Licence for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   Licence along with svLis; if not, write to the Free
+ *   Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA,
+ *   or see
+ *
+ *      http://www.gnu.org/
+ * 
+ * =====================================================================
+ *
+ * SvLis - tuning the division parameters to the work a model is for
+ *
+ * See the svLis web site for the manual and other details:
+ *
+ *    http://www.bath.ac.uk/~ensab/G_mod/Svlis/
+ *
+ * or see the file
+ *
+ *    docs/svlis.html
+ *
+ * First version: 18 October 2026
+ * This version: 18 October 2026
+ *
+ */
+
+#ifndef SVLIS_TUNE
+#define SVLIS_TUNE
+
+// What a model is to be used for - or these together
+
+#define SV_TUNE_RAYS 1
+#define SV_TUNE_MEMBER 2
+#define SV_TUNE_FACET 4
+
+// A set of division parameters, and how well they did
+
+struct sv_div_params
+{
+	sv_integer low_contents;	// See set_low_contents(...)
+	sv_real small_volume;		// See set_small_volume(...)
+	sv_real swell;			// See set_swell_fac(...)
+	sv_decision decision;		// dumb_decision, smart_decision or cost_decision
+	sv_integer strategy;		// The smart strategy or cost measure for those
+
+	double divide_time;		// Seconds to divide
+	double work_time;		// Seconds to do the sample work
+	sv_integer bytes;		// Rough memory used by the models made
+
+// Start with the current settings and dumb_decision
+
+	sv_div_params();
+
+// Make these the current settings
+
+	void use() const;
+
+// Print them
+
+	void print(ostream&) const;
+};
+
+// Try dividing set list sl in box b with a range of settings, doing a
+// sample of the work given (SV_TUNE_RAYS etc) with samples rays and 
+// points each time, and return the settings that took the least time
+// altogether.  Settings that use more than max_bytes are rejected, unless
+// max_bytes is 0.  Each parameter is varied in turn, keeping the best 
+// value found, until none of them gives an improvement.  Each trial
+// is reported to log if it's not 0.  The current settings are left
+// as they were; call use() on the answer to change them.
+
+extern sv_div_params tune_division(const sv_set_list& sl, const sv_box& b, 
+	sv_integer work, sv_integer samples, sv_integer max_bytes, ostream* log);
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * SvLis model division checks
+ *
+ *   18 October 2026
+ *
+ *   Each of the other ways of dividing a model is checked against plain
+ *   sv_model::divide(...) on the same test object: whether the tree is
+ *   cut in the same places (where it should be) and whether the two
+ *   models agree about random points.  It prints a line for each check
+ *   and exits with 1 if any failed.
+ *
+ *   Usage: div_chk
+ */
+
+#include <svlis.h>
+#include "sv_bench.h"
+#if macintosh
+ #pragma export on
+#endif
+
+#define POINTS 20000
+
+static sv_integer checks = 0;
+static sv_integer failed = 0;
+
+// Compare model m with model p made by divide(); if same is non-zero
+// they should be cut in the same places
+
+static void check(const char* what, const sv_model& p, const sv_model& m, int same)
+{
+	sv_integer bad = bench_member_check(p, m, POINTS);
+	int alike = bench_same_tree(p, m);
+
+	checks++;
+	cout << "  " << what << ": " << bench_leaves(m) << " leaves (" << bench_leaves(p) <<
+		" from divide()), trees " << (alike ? "the same" : "different");
+	if((same && !alike) || bad)
+	{
+		failed++;
+		cout << ", " << bad << " different answers - FAILED" << SV_EL;
+	} else
+		cout << ", answers agree" << SV_EL;
+}
+
+#define DECISIONS 3
+
+static const sv_decision decision[DECISIONS] = { &dumb_decision, &smart_decision, &cost_decision };
+static const char* decision_name[DECISIONS] = { "dumb", "smart", "cost" };
+
+// Breadth-first division makes the same tree
+
+static void check_bf(const sv_model& m)
+{
+	sv_model p;
+	sv_integer i;
+
+	cout << "Breadth-first division (divide_bf)" << SV_EL;
+	for(i = 0; i < DECISIONS; i++)
+	{
+		p = m.divide(0, decision[i]);
+		check(decision_name[i], p, m.divide_bf(0, decision[i], -1), 1);
+	}
+}
+
+// Progressive division run to the end makes the same tree, whether it's
+// done in one go or in pieces with a budget
+
+static void check_progressive(const sv_model& m)
+{
+	sv_div_budget all, some;
+	sv_model p, q;
+	sv_integer i;
+
+	cout << "Progressive division (divide_progressive)" << SV_EL;
+	some.nodes = 2000;
+	for(i = 0; i < DECISIONS; i++)
+	{
+		p = m.divide(0, decision[i]);
+		check(decision_name[i], p, m.divide_progressive(0, decision[i], all), 1);
+		q = m.divide_progressive(0, decision[i], some);
+		q = q.divide_progressive(0, decision[i], all);
+		check("in two goes", p, q, 1);
+	}
+}
+
+// Lazy division makes the same tree once it's all been looked at.  The
+// points are tried first, so they wake a model that is still lazy.
+
+static void check_lazy(const sv_model& m)
+{
+	sv_model p;
+	sv_integer i;
+
+	cout << "Lazy division (divide_lazy)" << SV_EL;
+	for(i = 0; i < DECISIONS; i++)
+	{
+		p = m.divide(0, decision[i]);
+		check(decision_name[i], p, m.divide_lazy(0, decision[i]), 1);
+	}
+}
+
+// Redividing with a dirty box round a sphere that's moved makes the same
+// tree as redividing everything
+
+static void check_dirty(const sv_box& b)
+{
+	sv_set s = bench_set(SV_BENCH_SPHERES, 60, b, 0.05);
+	sv_point c = b.centroid(), d = sv_point(0.3, 0.2, 0);
+	sv_real r = 0.5;
+	sv_box dirty = sv_box(sv_interval(c.x - r, c.x + r), sv_interval(c.y - r, c.y + r),
+		sv_interval(c.z - r, c.z + r));
+	sv_model m, p;
+	sv_set_list moved;
+	sv_integer i;
+
+	cout << "Redivision with a dirty box (redivide)" << SV_EL;
+	dirty = dirty | (dirty + d);
+	moved = sv_set_list(s | sphere(c + d, r));
+	for(i = 0; i < DECISIONS; i++)
+	{
+		m = sv_model(s | sphere(c, r), b, sv_model()).divide(0, decision[i]);
+		p = m.redivide(moved, 0, decision[i]);
+		check(decision_name[i], p, m.redivide(moved, dirty, 0, decision[i]), 1);
+	}
+}
+
+// Merging two divided models gives the same answers as dividing their 
+// merged set lists, both when the second covers the first and when it
+// only covers part of it (its root's list isn't pruned, so it's right
+// outside its box too)
+
+static void check_merge(const sv_box& b)
+{
+	sv_set s1 = bench_set(SV_BENCH_SPHERES, 30, b, 0.05);
+	sv_set s2 = bench_set(SV_BENCH_SPHERES, 30, b, 0.05);
+	sv_box part = b + sv_point(3, 0, 0);
+	sv_model m1, m2, p;
+	sv_integer i;
+
+	cout << "Merging divided models (merge)" << SV_EL;
+	m1 = sv_model(s1, b, sv_model()).divide(0, &dumb_decision);
+	p = sv_model(merge(sv_set_list(s1), sv_set_list(s2)), b, sv_model()).divide(0, &dumb_decision);
+	for(i = 0; i < 2; i++)
+	{
+		if(i)
+		{
+			m2 = sv_model(sv_set_list(s2), part, LEAF_M, sv_model()).divide(0, &dumb_decision);
+			cout << "Merging with the second model covering part of the first" << SV_EL;
+		} else
+			m2 = sv_model(s2, b, sv_model()).divide(0, &dumb_decision);
+		check("no decision", p, merge(m1, m2), 0);
+		check("dumb", p, merge(m1, m2, 0, &dumb_decision), 0);
+	}
+}
+
+// Compacting a model doesn't change its answers, however it was divided.
+// The lazy model is woken all over first, as compact() leaves lazy
+// leaves alone.
+
+static void check_compact(const sv_model& m)
+{
+	sv_div_budget all, some;
+	sv_model p, q;
+
+	cout << "Compaction (compact)" << SV_EL;
+	some.nodes = 2000;
+	p = m.divide(0, &dumb_decision);
+	check("divided", p, p.compact(), 0);
+	q = m.divide_lazy(0, &dumb_decision);
+	bench_leaves(q);
+	check("lazy", p, q.compact(), 0);
+	check("progressive", p, m.divide_progressive(0, &dumb_decision, all).compact(), 0);
+	check("progressive, part done", p, m.divide_progressive(0, &dumb_decision, some).compact(), 0);
+}
+
+// Division by the cost model gives the same answers as dumb division
+// (cutting in different places), with either measure and with one or
+// several trial cuts
+
+static void check_cost(const sv_model& m)
+{
+	static const char* name[2][2] = { { "area, 1 cut", "area, 7 cuts" },
+		{ "contents, 1 cut", "contents, 7 cuts" } };
+	sv_integer measure = get_cost_measure(), cuts = get_cost_cuts();
+	sv_model p = m.divide(0, &dumb_decision);
+	sv_integer i, j;
+
+	cout << "Cost-model division (cost_decision)" << SV_EL;
+	for(i = 0; i < 2; i++)
+	{
+		set_cost_measure(i ? SV_COST_CONTENTS : SV_COST_AREA);
+		for(j = 0; j < 2; j++)
+		{
+			set_cost_cuts(j ? 7 : 1);
+			check(name[i][j], p, m.divide(0, &cost_decision), 0);
+		}
+	}
+	set_cost_measure(measure);
+	set_cost_cuts(cuts);
+}
+
+// smart_decision makes the same tree whether or not it makes its trial
+// children in parallel.  Every set list is big enough for that here.
+// Without SV_PARALLEL the tasks run one after another, but the same
+// code is used.
+
+static void check_smart_parallel(const sv_model& m)
+{
+	sv_integer threads = get_worker_threads(), big = get_smart_parallel();
+	sv_model p;
+
+	cout << "Smart division in parallel (set_smart_parallel)" << SV_EL;
+	set_worker_threads(1);
+	p = m.divide(0, &smart_decision);
+	set_worker_threads(4);
+	set_smart_parallel(0);
+	check("4 threads", p, m.divide(0, &smart_decision), 1);
+	set_worker_threads(threads);
+	set_smart_parallel(big);
+}
+
+int main()
+{
+	sv_box b = sv_box(sv_point(0, 0, 0), sv_point(10, 10, 10));
+	sv_model m;
+
+	svlis_init();
+	set_low_contents(1);
+	set_small_volume(0.001);
+	m = sv_model(bench_set(SV_BENCH_HOLED, 60, b, 0.05), b, sv_model());
+
+	cout << SV_EL << "SvLis model division checks on " << m.set_list().contents() <<
+		" primitives" << SV_EL << SV_EL;
+
+	check_bf(m);
+	check_progressive(m);
+	check_lazy(m);
+	check_dirty(b);
+	check_merge(b);
+	check_compact(m);
+	check_cost(m);
+	check_smart_parallel(m);
+
+	cout << SV_EL << checks << " checks, " << failed << " failed" << SV_EL << SV_EL;
+	return(svlis_end(failed ? 1 : 0));
+}
+#if macintosh
+ #pragma export off
+#endif
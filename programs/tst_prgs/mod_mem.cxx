@@ -0,0 +1,80 @@
+/*
+ * SvLis model batch membership benchmark
+ *
+ *   18 October 2026
+ *
+ *   This times classifying a million random points against divided
+ *   models of a couple of hundred primitives, point by point with
+ *   sv_model::member(point) and then in one call to the batch test, and
+ *   checks that both give the same answers.
+ *
+ *   Usage: mod_mem [points]
+ */
+
+#include <svlis.h>
+#include "sv_bench.h"
+#if macintosh
+ #pragma export on
+#endif
+
+static const sv_integer kinds[2] = { SV_BENCH_SCOOPED, SV_BENCH_TORI };
+
+int main(int argc, char** argv)
+{
+	sv_box b = sv_box(sv_point(0, 0, 0), sv_point(10, 10, 10));
+	sv_box bb = sv_box(sv_point(-1, -1, -1), sv_point(11, 11, 11));
+	sv_integer n = 1000000;
+	sv_integer i, k, solid;
+	sv_real *x, *y, *z;
+	mem_test *m1, *m2;
+	sv_primitive known;
+	sv_bench_clock c;
+	sv_model md;
+	double t1, t2;
+
+	svlis_init();
+	if(argc > 1) n = atol(argv[1]);
+	x = new sv_real[n];
+	y = new sv_real[n];
+	z = new sv_real[n];
+	m1 = new mem_test[n];
+	m2 = new mem_test[n];
+
+// The points cover a box a bit bigger than the model's
+
+	bench_points(bb, n, x, y, z);
+
+	cout << SV_EL << "SvLis model batch membership benchmark" << SV_EL << SV_EL;
+
+	for(k = 0; k < 2; k++)
+	{
+		md = sv_model(bench_set(kinds[k], 200, b, 0.045), b, sv_model());
+		md = md.divide(0, &dumb_decision);
+
+		c.start();
+		for(i = 0; i < n; i++) m1[i] = md.member(sv_point(x[i], y[i], z[i]), &known);
+		t1 = c.time();
+
+		c.start();
+		md.member(x, y, z, m2, n);
+		t2 = c.time();
+
+		solid = 0;
+		for(i = 0; i < n; i++)
+			if(m1[i] == SV_SOLID) solid++;
+		cout << bench_name(kinds[k]) << ": " << n << " points, " << solid << " solid" << SV_EL;
+		bench_times(cout, "member", t1, t2, "one at a time", "in a batch");
+		bench_answers(cout, bench_differ(m1, m2, n));
+		cout << SV_EL;
+	}
+
+	delete [] x;
+	delete [] y;
+	delete [] z;
+	delete [] m1;
+	delete [] m2;
+	return(svlis_end(0));
+}
+#if macintosh
+ #pragma export off
+#endif
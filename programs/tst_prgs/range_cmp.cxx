@@ -0,0 +1,154 @@
+/*
+ * SvLis range comparison program
+ *
+ *   18 October 2026
+ *
+ *   This divides the same models with plain interval arithmetic,
+ *   affine arithmetic, the centred form, both of those together,
+ *   the Bernstein form, and all three (see set_range_mode(...)),
+ *   using the same decision procedure, and
+ *   reports the leaf counts and times.  It also checks that the ranges
+ *   each method gives for random boxes contain the primitives' values
+ *   at points in the boxes, and reports how wide they are on average.
+ */
+
+#include <svlis.h>
+#include "sv_bench.h"
+#if macintosh
+ #pragma export on
+#endif
+
+#define MODES 6
+
+static sv_integer mode[MODES] =
+{
+	SV_RANGE_INTERVAL,
+	SV_RANGE_AFFINE,
+	SV_RANGE_CENTRED,
+	SV_RANGE_AFFINE | SV_RANGE_CENTRED,
+	SV_RANGE_BERNSTEIN,
+	SV_RANGE_AFFINE | SV_RANGE_CENTRED | SV_RANGE_BERNSTEIN
+};
+
+static const char* mode_name[MODES] =
+{
+	"interval",
+	"affine",
+	"centred",
+	"both",
+	"bernstein",
+	"all"
+};
+
+// Some curved test objects: a row of spheres with a hole through them,
+// a torus, and a rounded (superquadric-like) block
+
+static const sv_integer kinds[3] = { SV_BENCH_ROW, SV_BENCH_TORUS, SV_BENCH_QUARTIC };
+
+// Check the ranges of a primitive over random boxes in b, and add up
+// their widths
+
+static sv_integer check_ranges(const sv_primitive& p, const sv_box& b,
+	sv_real* width)
+{
+	sv_integer i, j, m, bad = 0;
+	sv_point q, r;
+	sv_box bb;
+	sv_interval v;
+	sv_real f;
+
+	for(m = 0; m < MODES; m++) width[m] = 0;
+	for(i = 0; i < 500; i++)
+	{
+		q = ran_point(b);
+		r = q + sv_point(0.1, 0.1, 0.1)*(1 + (i % 20));
+		bb = sv_box(q, r);
+		for(m = 0; m < MODES; m++)
+		{
+			v = p.range(bb, mode[m]);
+			width[m] = width[m] + v.hi() - v.lo();
+			for(j = 0; j < 27; j++)
+			{
+				f = p.value(ran_point(bb));
+				if((f < v.lo() - 1.0e-4*(1 + fabs(f))) ||
+				   (f > v.hi() + 1.0e-4*(1 + fabs(f)))) bad++;
+			}
+		}
+	}
+	return(bad);
+}
+
+// The same for all the primitives in a set
+
+static sv_integer check_set(const sv_set& s, const sv_box& b, sv_real* width)
+{
+	sv_integer m, bad = 0;
+	sv_real w[MODES];
+
+	for(m = 0; m < MODES; m++) width[m] = 0;
+	switch(s.contents())
+	{
+	case SV_EVERYTHING:
+	case SV_NOTHING:
+		break;
+
+	case 1:
+		bad = check_ranges(s.primitive(), b, width);
+		break;
+
+	default:
+		bad = check_set(s.child_1(), b, width);
+		bad = bad + check_set(s.child_2(), b, w);
+		for(m = 0; m < MODES; m++) width[m] = width[m] + w[m];
+	}
+	return(bad);
+}
+
+int main()
+{
+	sv_box b = sv_box(sv_point(-10, -10, -10), sv_point(10, 10, 10));
+	sv_integer i, m, leaves, bad;
+	sv_real width[MODES];
+	sv_model md;
+	m_stats* ms;
+	sv_bench_clock c;
+	double t;
+	sv_set s;
+
+	svlis_init();
+	set_small_volume(0.01);
+	set_low_contents(0);
+
+	cout << SV_EL << "SvLis range method comparison" << SV_EL << SV_EL;
+
+	for(i = 0; i < 3; i++)
+	{
+		s = bench_set(kinds[i], 0, b, 0);
+		cout << bench_name(kinds[i]) << ":" << SV_EL;
+		for(m = 0; m < MODES; m++)
+		{
+			set_range_mode(mode[m]);
+			c.start();
+			md = sv_model(s, b, sv_model());
+			md = md.divide(0, &dumb_decision);
+			t = c.time();
+			ms = new m_stats(md);
+			leaves = ms->a_boxes + ms->s_boxes + ms->surface_boxes;
+			cout << "  " << mode_name[m] << ": " << leaves << " leaves (" <<
+				ms->surface_boxes << " surface) in " << t << "s" << SV_EL;
+			delete ms;
+		}
+
+		bad = check_set(s, b, width);
+		cout << "  mean range widths relative to interval:";
+		for(m = 1; m < MODES; m++)
+			cout << " " << mode_name[m] << " " << width[m]/width[0];
+		cout << SV_EL << "  values outside their ranges: " << bad << SV_EL << SV_EL;
+	}
+
+	set_range_mode(SV_RANGE_INTERVAL);
+	return(svlis_end(0));
+}
+#if macintosh
+ #pragma export off
+#endif
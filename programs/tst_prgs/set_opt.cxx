@@ -0,0 +1,154 @@
+/*
+ * SvLis set optimisation benchmark
+ *
+ *   18 October 2026
+ *
+ *   This builds unions of about 10000 primitives a piece at a time, as a
+ *   program making an object in a loop would, and times classifying
+ *   points against them (one at a time and in batches), finding their
+ *   values, and pruning them to boxes, before and after the sets are
+ *   optimised (see sv_set::optimise()).  It checks that the optimised
+ *   sets give the same answers.  Optimised sets are grouped so that
+ *   their subsets' bounding boxes are small, and pruning and membership
+ *   tests can reject most of them (see sv_set::bound()).  Values have
+ *   to visit every primitive, so they only gain from the primitives 
+ *   being laid out in the order they are visited; the time is printed
+ *   to show they don't lose.
+ *
+ *   Usage: set_opt [primitives]
+ */
+
+#include <svlis.h>
+#include "sv_bench.h"
+#if macintosh
+ #pragma export on
+#endif
+
+#define POINTS 2000
+#define BOXES 500
+
+// Depth of a set tree
+
+static sv_integer depth(const sv_set& s)
+{
+	if(s.contents() <= 1) return(1);
+	return(1 + max(depth(s.child_1()), depth(s.child_2())));
+}
+
+// Time member(point) and batch member for the points, returning the
+// answers in m and m_b
+
+static void time_member(const sv_set& s, const sv_point* p, const sv_real* x,
+	const sv_real* y, const sv_real* z, mem_test* m, mem_test* m_b, double* t)
+{
+	sv_primitive known[1];
+	sv_bench_clock c;
+	sv_integer i;
+
+	for(i = 0; i < POINTS; i++) m[i] = s.member(p[i], known);
+	t[0] = c.time();
+
+	c.start();
+	s.member(x, y, z, m_b, POINTS);
+	t[1] = c.time();
+}
+
+static const sv_integer kinds[2] = { SV_BENCH_SPHERES, SV_BENCH_MIXED };
+
+int main(int argc, char** argv)
+{
+	sv_box b = sv_box(sv_point(0, 0, 0), sv_point(10, 10, 10));
+	sv_integer n = 10000;
+	sv_integer i, k, bad;
+	sv_point* p = new sv_point[POINTS];
+	sv_real* x = new sv_real[POINTS];
+	sv_real* y = new sv_real[POINTS];
+	sv_real* z = new sv_real[POINTS];
+	mem_test* m[4];
+	sv_box* bx = new sv_box[BOXES];
+	sv_set* ps = new sv_set[BOXES];
+	sv_set* po = new sv_set[BOXES];
+	sv_integer cs, co;
+	sv_real* v = new sv_real[POINTS];
+	double t_m[2], t_o[2], t_v, t_p, t_opt;
+	sv_bench_clock c;
+	sv_set s, o, w;
+	sv_point q;
+
+	svlis_init();
+	if(argc > 1) n = atol(argv[1]);
+	for(k = 0; k < 4; k++) m[k] = new mem_test[POINTS];
+
+	bench_points(b, POINTS, x, y, z);
+	for(i = 0; i < POINTS; i++) p[i] = sv_point(x[i], y[i], z[i]);
+	for(i = 0; i < BOXES; i++)
+	{
+		q = ran_point(b);
+		bx[i] = sv_box(q, q + sv_point(0.5, 0.5, 0.5));
+	}
+
+	cout << SV_EL << "SvLis set optimisation benchmark" << SV_EL << SV_EL;
+
+	for(k = 0; k < 2; k++)
+	{
+		s = bench_set(kinds[k], n, b, 0.01);
+		c.start();
+		o = s.optimise();
+		t_opt = c.time();
+
+		cout << bench_name(kinds[k]) << ": " << s.contents() << " primitives, depth " <<
+			depth(s) << " (" << depth(o) << " optimised, in " << t_opt << "s)" << SV_EL;
+
+		time_member(s, p, x, y, z, m[0], m[1], t_m);
+		time_member(o, p, x, y, z, m[2], m[3], t_o);
+		bad = bench_differ(m[0], m[2], POINTS) + bench_differ(m[1], m[3], POINTS);
+		bench_times(cout, "member(point)", t_m[0], t_o[0]);
+		bench_times(cout, "batch member", t_m[1], t_o[1]);
+
+		c.start();
+		for(i = 0; i < POINTS; i++) v[i] = s.value(p[i], &w);
+		t_v = c.time();
+		c.start();
+		for(i = 0; i < POINTS; i++)
+			if(v[i] != o.value(p[i], &w)) bad++;
+		t_p = c.time();
+		bench_times(cout, "value", t_v, t_p);
+
+// The pruned sets needn't be the same, as the optimised one may have
+// had more thrown away, but they must agree about points in the box
+
+		c.start();
+		for(i = 0; i < BOXES; i++) ps[i] = s.prune(bx[i]);
+		t_v = c.time();
+		c.start();
+		for(i = 0; i < BOXES; i++) po[i] = o.prune(bx[i]);
+		t_p = c.time();
+		cs = 0;
+		co = 0;
+		for(i = 0; i < BOXES; i++)
+		{
+			cs = cs + max(ps[i].contents(), (sv_integer)0);
+			co = co + max(po[i].contents(), (sv_integer)0);
+			bad = bad + bench_member_check(ps[i], po[i], bx[i], 10);
+		}
+		bench_times(cout, "prune", t_v, t_p);
+		cout << "  mean primitives left by pruning: " << (sv_real)cs/BOXES << " before, " <<
+			(sv_real)co/BOXES << " after" << SV_EL;
+		bench_answers(cout, bad);
+		cout << SV_EL;
+	}
+
+	for(k = 0; k < 4; k++) delete [] m[k];
+	delete [] p;
+	delete [] x;
+	delete [] y;
+	delete [] z;
+	delete [] bx;
+	delete [] ps;
+	delete [] po;
+	delete [] v;
+	return(svlis_end(0));
+}
+#if macintosh
+ #pragma export off
+#endif
@@ -0,0 +1,221 @@
+/*
+ * SvLis - things shared by the test and benchmark programs
+ *
+ *   18 October 2026
+ *
+ *   Test objects made from random primitives, random points, timing,
+ *   and checks that two sets or models agree about which points are
+ *   solid and that two models are divided the same way.
+ */
+
+#ifndef SV_BENCH
+#define SV_BENCH
+
+// The test objects bench_set(...) makes
+
+#define SV_BENCH_SPHERES 0	// Spheres, each added on the right of the last
+#define SV_BENCH_MIXED 1	// Blocks, spheres and tori, each added on the left
+#define SV_BENCH_TORI 2		// Tori
+#define SV_BENCH_HOLED 3	// Spheres with a cylindrical hole through them
+#define SV_BENCH_SCOOPED 4	// Spheres with a block taken out of the middle
+#define SV_BENCH_ROW 5		// A row of three spheres with a hole through them
+#define SV_BENCH_TORUS 6	// One torus
+#define SV_BENCH_QUARTIC 7	// A rounded block from a quartic
+#define SV_BENCH_KINDS 8
+
+inline const char* bench_name(sv_integer k)
+{
+	static const char* name[SV_BENCH_KINDS] =
+	{
+		"spheres", "mixed", "tori", "holed spheres", "scooped spheres",
+		"row", "torus", "quartic"
+	};
+
+	if((k < 0) || (k >= SV_BENCH_KINDS)) return("unknown");
+	return(name[k]);
+}
+
+// Test object k with about n primitives in box b.  The random shapes'
+// sizes are r times the box's longest side, give or take a half.  The
+// last three are single objects, so n is ignored; they are the right
+// size for a box 20 across.
+
+inline sv_set bench_set(sv_integer k, sv_integer n, const sv_box& b, sv_real r)
+{
+	sv_set s, t;
+	sv_point p, c = b.centroid();
+	sv_primitive x, y, z;
+	sv_real l, size = max(b.xi.hi() - b.xi.lo(), max(b.yi.hi() - b.yi.lo(), b.zi.hi() - b.zi.lo()));
+	sv_integer i = 0, j = 0;
+
+	switch(k)
+	{
+	case SV_BENCH_ROW:
+		l = size/20;
+		s = sphere(c - sv_point(4*l, 0, 0), 3*l) | sphere(c, 3.5*l) |
+			sphere(c + sv_point(4*l, 0, 0), 3*l);
+		return(s - cylinder(sv_line(SV_X, c), 1.5*l));
+
+	case SV_BENCH_TORUS:
+		l = size/20;
+		return(torus(sv_line(sv_point(1, 1, 1), c), 5*l, 1.5*l));
+
+	case SV_BENCH_QUARTIC:
+		l = 3/size;
+		x = sv_primitive(sv_plane(SV_X, c))*l;
+		y = sv_primitive(sv_plane(SV_Y, c))*l;
+		z = sv_primitive(sv_plane(SV_Z, c))*l;
+		return(sv_set((x^4) + (y^4) + (z^4) + x*y*z - 1));
+
+	default:
+		break;
+	}
+
+	while(i < n)
+	{
+		p = ran_point(b);
+		l = r*size*(0.5 + ran_real());
+		if(k != SV_BENCH_MIXED) j = 1;
+		switch(k == SV_BENCH_TORI ? 2 : (j++) % 3)
+		{
+		case 0:
+			t = cuboid(p, p + sv_point(l, l, 2*l));
+			i = i + 6;
+			break;
+		case 1:
+			t = sphere(p, l);
+			i++;
+			break;
+		default:
+			t = torus(sv_line(ran_point(b) - c, p), 2*l,
+				(k == SV_BENCH_TORI) ? l/3 : l/2);
+			i++;
+			break;
+		}
+
+// The mixture is added on the left (making a right-leaning tree), and
+// everything else on the right (a left-leaning one)
+
+		if(!s.exists())
+			s = t;
+		else if(k == SV_BENCH_MIXED)
+			s = t | s;
+		else
+			s = s | t;
+	}
+
+	if(k == SV_BENCH_HOLED)
+		s = s - cylinder(sv_line(SV_X, c), 0.1*size);
+	if(k == SV_BENCH_SCOOPED)
+		s = s - cuboid(c - sv_point(0.3, 0.3, 0.3)*size, c + sv_point(0.3, 0.3, 0.3)*size);
+	return(s);
+}
+
+// n random points in a box, as separate coordinates
+
+inline void bench_points(const sv_box& b, sv_integer n, sv_real* x, sv_real* y, sv_real* z)
+{
+	sv_point p;
+
+	for(sv_integer i = 0; i < n; i++)
+	{
+		p = ran_point(b);
+		x[i] = p.x;
+		y[i] = p.y;
+		z[i] = p.z;
+	}
+}
+
+// Wall-clock time since the clock was made or last started
+
+class sv_bench_clock
+{
+private:
+
+	double t;
+
+public:
+
+	sv_bench_clock() { t = sv_wall_time(); }
+	void start() { t = sv_wall_time(); }
+	double time() const { return(sv_wall_time() - t); }
+};
+
+// Print two timings (before and after, unless they're called something
+// else), and the number of answers that differ
+
+inline void bench_times(ostream& s, const char* what, double t1, double t2,
+	const char* n1 = "before", const char* n2 = "after")
+{
+	s << "  " << what << ": " << t1 << "s " << n1 << ", " << t2 << "s " << n2 << SV_EL;
+}
+
+inline void bench_answers(ostream& s, sv_integer bad)
+{
+	s << "  different answers: " << bad << SV_EL;
+}
+
+// Where two lists of membership answers differ
+
+inline sv_integer bench_differ(const mem_test* a, const mem_test* b, sv_integer n)
+{
+	sv_integer bad = 0;
+
+	for(sv_integer i = 0; i < n; i++)
+		if(a[i] != b[i]) bad++;
+	return(bad);
+}
+
+// How many of n random points in box b two sets disagree about
+
+inline sv_integer bench_member_check(const sv_set& a, const sv_set& b, const sv_box& bx, sv_integer n)
+{
+	sv_primitive known;
+	sv_integer bad = 0;
+	sv_point p;
+
+	for(sv_integer i = 0; i < n; i++)
+	{
+		p = ran_point(bx);
+		if(a.member(p, &known) != b.member(p, &known)) bad++;
+	}
+	return(bad);
+}
+
+// The same for two models, with points in the first one's box
+
+inline sv_integer bench_member_check(const sv_model& a, const sv_model& b, sv_integer n)
+{
+	sv_primitive known;
+	sv_integer bad = 0;
+	sv_box bx = a.box();
+	sv_point p;
+
+	for(sv_integer i = 0; i < n; i++)
+	{
+		p = ran_point(bx);
+		if(a.member(p, &known) != b.member(p, &known)) bad++;
+	}
+	return(bad);
+}
+
+// The number of leaves in a model (dividing any lazy ones)
+
+inline sv_integer bench_leaves(const sv_model& m)
+{
+	if(m.kind() == LEAF_M) return(1);
+	return(bench_leaves(m.child_1()) + bench_leaves(m.child_2()));
+}
+
+// Are two models divided in the same places, with leaves whose set lists
+// have the same contents?
+
+inline int bench_same_tree(const sv_model& a, const sv_model& b)
+{
+	if(a.kind() != b.kind()) return(0);
+	if(a.kind() == LEAF_M) return(a.set_list().contents() == b.set_list().contents());
+	if(a.coord() != b.coord()) return(0);
+	return(bench_same_tree(a.child_1(), b.child_1()) && bench_same_tree(a.child_2(), b.child_2()));
+}
+
+#endif
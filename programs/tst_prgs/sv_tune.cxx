@@ -0,0 +1,143 @@
+/*
+ * SvLis division tuning program
+ *
+ *   18 October 2026
+ *
+ *   This finds the division settings (low contents, small volume, swell
+ *   and decision procedure) that let a model be divided and used most
+ *   quickly (see tune_division(...)).  The model is read from a svLis
+ *   file, which may hold a model, a set list or a set; a set or a set
+ *   list needs a box to be given too.  With no file a test model is used.
+ *
+ *   Usage: sv_tune [-r] [-m] [-f] [-n samples] [-M max_bytes]
+ *                  [-b x0 y0 z0 x1 y1 z1] [svlis_file]
+ *
+ *      -r  tune for firing rays
+ *      -m  tune for membership tests (-r and -m are the default)
+ *      -f  tune for faceting
+ */
+
+#include <svlis.h>
+#include "sv_bench.h"
+#if macintosh
+ #pragma export on
+#endif
+
+static int usage()
+{
+	cerr << "Usage: sv_tune [-r] [-m] [-f] [-n samples] [-M max_bytes]" << SV_EL;
+	cerr << "               [-b x0 y0 z0 x1 y1 z1] [svlis_file]" << SV_EL;
+	return(svlis_end(1));
+}
+
+int main(int argc, char* argv[])
+{
+	sv_box b = sv_box(sv_point(0, 0, 0), sv_point(1, 1, 1));
+	sv_integer work = 0;
+	sv_integer samples = 1000;
+	sv_integer max_bytes = 0;
+	int have_box = 0;
+	char* file = 0;
+	sv_set_list sl;
+	sv_div_params best;
+	sv_model m;
+	sv_set s;
+	int i;
+
+	svlis_init();
+
+	for(i = 1; i < argc; i++)
+	{
+		if(!sv_strcmp(argv[i], "-r"))
+			work = work | SV_TUNE_RAYS;
+		else if(!sv_strcmp(argv[i], "-m"))
+			work = work | SV_TUNE_MEMBER;
+		else if(!sv_strcmp(argv[i], "-f"))
+			work = work | SV_TUNE_FACET;
+		else if(!sv_strcmp(argv[i], "-n") && (i + 1 < argc))
+			samples = atol(argv[++i]);
+		else if(!sv_strcmp(argv[i], "-M") && (i + 1 < argc))
+			max_bytes = atol(argv[++i]);
+		else if(!sv_strcmp(argv[i], "-b") && (i + 6 < argc))
+		{
+			b = sv_box(sv_point(atof(argv[i + 1]), atof(argv[i + 2]), atof(argv[i + 3])),
+				sv_point(atof(argv[i + 4]), atof(argv[i + 5]), atof(argv[i + 6])));
+			have_box = 1;
+			i = i + 6;
+		} else if((argv[i][0] != '-') && !file)
+			file = argv[i];
+		else
+			return(usage());
+	}
+	if(!work) work = SV_TUNE_RAYS | SV_TUNE_MEMBER;
+
+	if(file)
+	{
+		ifstream ifs(file);
+		if(!ifs)
+		{
+			cerr << "Can't open " << file << SV_EL;
+			return(svlis_end(1));
+		}
+
+		sv_integer ver = -1;
+		sv_real r;
+
+		check_svlis_header(ifs);
+		sv_tag thing = get_token(ifs, ver, r, 0);
+		ifs.close();
+
+		ifstream ifs2(file);
+		switch(thing)
+		{
+		case SVT_MODEL:
+			ifs2 >> m;
+			sl = m.set_list();
+			if(!have_box) b = m.box();
+			have_box = 1;
+			break;
+
+		case SVT_SET_LIST:
+			ifs2 >> sl;
+			break;
+
+		case SVT_SET:
+			ifs2 >> s;
+			sl = sv_set_list(s);
+			break;
+
+		default:
+			cerr << "sv_tune can only tune models, set lists and sets." << SV_EL;
+			return(svlis_end(1));
+		}
+		if(!have_box)
+		{
+			cerr << "A set or set list needs a box (-b)." << SV_EL;
+			return(svlis_end(1));
+		}
+	} else
+		sl = sv_set_list(bench_set(SV_BENCH_HOLED, 40, b, 0.05));
+
+	cout << SV_EL << "SvLis division tuning" << SV_EL << SV_EL;
+	best = tune_division(sl, b, work, samples, max_bytes, &cout);
+
+	cout << SV_EL << "The best settings are:" << SV_EL << "  ";
+	best.print(cout);
+	cout << SV_EL << SV_EL;
+	cout << "  set_low_contents(" << best.low_contents << ");" << SV_EL;
+	cout << "  set_small_volume(" << best.small_volume << ");" << SV_EL;
+	cout << "  set_swell_fac(" << best.swell << ");" << SV_EL;
+	if(best.decision == &smart_decision)
+		cout << "  set_smart_strategy(" << 
+			((best.strategy == SV_MIN_MAX) ? "SV_MIN_MAX" : "SV_MIN_MIN") << ");" << SV_EL;
+	if(best.decision == &cost_decision)
+		cout << "  set_cost_measure(" << 
+			((best.strategy == SV_COST_CONTENTS) ? "SV_COST_CONTENTS" : "SV_COST_AREA") << 
+			");" << SV_EL;
+	cout << SV_EL;
+
+	return(svlis_end(0));
+}
+#if macintosh
+ #pragma export off
+#endif
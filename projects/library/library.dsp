@@ -120,6 +120,14 @@ SOURCE=..\..\Src\Model.cxx
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Src\Flatmod.cxx
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\Src\Tune.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Src\niederreiter.cxx
 # End Source File
 # Begin Source File
@@ -184,6 +192,10 @@ SOURCE=..\..\Src\Sv_graph.cxx
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Src\Sv_pool.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Src\Sv_util.cxx
 # End Source File
 # Begin Source File
@@ -196,6 +208,10 @@ SOURCE=..\..\Src\Svlis.cxx
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Src\Tape.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Src\U_attrib.cxx
 # End Source File
 # Begin Source File
@@ -183,6 +183,44 @@ void dumb_decision(const sv_model& m, sv_integer level, void* vp, mod_kind* k, s
 	return;
 }
 
+// Set lists with more than smart_parallel primitives have smart_decision's
+// trial children made in parallel (if there's a thread pool)
+
+static sv_integer smart_parallel = SV_SMART_PARALLEL;
+
+void set_smart_parallel(sv_integer n) { smart_parallel = n; }
+
+sv_integer get_smart_parallel() { return(smart_parallel); }
+
+// One of smart_decision's trial children: the compiled set list pruned 
+// to box b.  Only the two children chosen have their set lists built.
+
+struct sv_smart_trial
+{
+	const sv_set_tree* st;
+	sv_box b;
+	sv_prune_mask mask;
+	int done;
+};
+
+static void smart_trial(void* vp)
+{
+	sv_smart_trial* t = (sv_smart_trial*)vp;
+	t->st->prune(t->b, &(t->mask));
+	t->done = 1;
+}
+
+static sv_integer smart_contents(sv_smart_trial* t)
+{
+	if(!t->done) smart_trial((void*)t);
+	return(t->mask.contents());
+}
+
+static sv_model smart_child(const sv_smart_trial* t, const sv_model& m)
+{
+	return(sv_model(t->st->set_list(t->mask), t->b, LEAF_M, m));
+}
+
 // Do all possible even divisions and choose the one that minimises
 // the maximum contents
 
@@ -229,30 +267,58 @@ void smart_decision(const sv_model& m, sv_integer level, void* vp, mod_kind* k,
 	sl = m.set_list();
 	sv_real swell = 1 + get_swell_fac();
 
-// X_DIV
-
 	sv_interval x = mb.xi;
 	sv_interval y = mb.yi;
 	sv_interval z = mb.zi;
 
 	sv_real x_cut = (x.hi() - x.lo())*0.5;
+	sv_real y_cut = (y.hi() - y.lo())*0.5;
+	sv_real z_cut = (z.hi() - z.lo())*0.5;
+
+	sv_set_tree st(sl);
+	sv_smart_trial tr[6];
+	sv_integer i;
+
+	tr[0].b = sv_box(sv_interval(x.lo(), x.lo() + x_cut*swell), y, z);
+	tr[1].b = sv_box(sv_interval(x.hi() - x_cut*swell, x.hi()), y, z);
+	tr[2].b = sv_box(x, sv_interval(y.lo(), y.lo() + y_cut*swell), z);
+	tr[3].b = sv_box(x, sv_interval(y.hi() - y_cut*swell, y.hi()), z);
+	tr[4].b = sv_box(x, y, sv_interval(z.lo(), z.lo() + z_cut*swell));
+	tr[5].b = sv_box(x, y, sv_interval(z.hi() - z_cut*swell, z.hi()));
+	for(i = 0; i < 6; i++)
+	{
+		tr[i].st = &st;
+		tr[i].done = 0;
+	}
+
+#ifdef SV_PARALLEL
 
-	sv_interval i_part = sv_interval(x.lo(), x.lo() + x_cut*swell);
-        sv_box b_part = sv_box(i_part, y, z);
-	sv_model x_1 = sv_model(sl, b_part, m);
-	sv_integer x_1c = x_1.set_list().contents();
+// With a big enough set list prune to all six trial boxes at once on the
+// thread pool; each trial has its own mask, and the compiled set list 
+// isn't changed.  The answer is the same as pruning them one at a time;
+// it's just that the early returns below no longer save any work.
 
-	i_part = sv_interval(x.hi() - x_cut*swell, x.hi());
-	b_part = sv_box(i_part, y, z);
-	sv_model x_2 = sv_model(sl, b_part, m);
-	sv_integer x_2c = x_2.set_list().contents();
+	if((get_worker_threads() > 1) && (sl.contents() > smart_parallel))
+	{
+		sv_task_group tg;
+		for(i = 1; i < 6; i++) tg.run(smart_trial, (void*)&tr[i]);
+		smart_trial((void*)&tr[0]);
+		tg.wait();
+	}
+
+#endif
+
+// X_DIV
+
+	sv_integer x_1c = smart_contents(&tr[0]);
+	sv_integer x_2c = smart_contents(&tr[1]);
 
 // If we've hit a 0 return immediately
 
 	if((!x_1c) || (!x_2c))
 	{
-		*c_1 = x_1;
-		*c_2 = x_2;
+		*c_1 = smart_child(&tr[0], m);
+		*c_2 = smart_child(&tr[1], m);
 		*c = x.lo() + x_cut;
 		*k = X_DIV;
 		return;
@@ -260,24 +326,15 @@ void smart_decision(const sv_model& m, sv_integer level, void* vp, mod_kind* k,
 
 // Y_DIV
 
-	sv_real y_cut = (y.hi() - y.lo())*0.5;
-
-	i_part = sv_interval(y.lo(), y.lo() + y_cut*swell);
-        b_part = sv_box(x, i_part, z);
-	sv_model y_1 = sv_model(sl, b_part, m);
-	sv_integer y_1c = y_1.set_list().contents();
-
-	i_part = sv_interval(y.hi() - y_cut*swell, y.hi());
-	b_part = sv_box(x, i_part, z);
-	sv_model y_2 = sv_model(sl, b_part, m);
-	sv_integer y_2c = y_2.set_list().contents();
+	sv_integer y_1c = smart_contents(&tr[2]);
+	sv_integer y_2c = smart_contents(&tr[3]);
 
 // If we've hit a 0 return immediately
 
 	if((!y_1c) || (!y_2c))
 	{
-		*c_1 = y_1;
-		*c_2 = y_2;
+		*c_1 = smart_child(&tr[2], m);
+		*c_2 = smart_child(&tr[3], m);
 		*c = y.lo() + y_cut;
 		*k = Y_DIV;
 		return;
@@ -285,24 +342,15 @@ void smart_decision(const sv_model& m, sv_integer level, void* vp, mod_kind* k,
 
 // Z_DIV
 
-	sv_real z_cut = (z.hi() - z.lo())*0.5;
-
-	i_part = sv_interval(z.lo(), z.lo() + z_cut*swell);
-        b_part = sv_box(x, y, i_part);
-	sv_model z_1 = sv_model(sl, b_part, m);
-	sv_integer z_1c = z_1.set_list().contents();
-
-	i_part = sv_interval(z.hi() - z_cut*swell, z.hi());
-	b_part = sv_box(x, y, i_part);
-	sv_model z_2 = sv_model(sl, b_part, m);
-	sv_integer z_2c = z_2.set_list().contents();
+	sv_integer z_1c = smart_contents(&tr[4]);
+	sv_integer z_2c = smart_contents(&tr[5]);
 
 // If we've hit a 0 return immediately
 
 	if((!z_1c) || (!z_2c))
 	{
-		*c_1 = z_1;
-		*c_2 = z_2;
+		*c_1 = smart_child(&tr[4], m);
+		*c_2 = smart_child(&tr[5], m);
 		*c = z.lo() + z_cut;
 		*k = Z_DIV;
 		return;
@@ -338,23 +386,23 @@ void smart_decision(const sv_model& m, sv_integer level, void* vp, mod_kind* k,
 	{
 		if (ym > zm)
 		{
-			*c_1 = z_1;
-			*c_2 = z_2;
+			*c_1 = smart_child(&tr[4], m);
+			*c_2 = smart_child(&tr[5], m);
 			*k = Z_DIV;
 			*c = z.lo() + z_cut;
 		} else
 		{
 			if ( (ym == zm) && (y_cut < z_cut) )
 			{
-				*c_1 = z_1;
-				*c_2 = z_2;
+				*c_1 = smart_child(&tr[4], m);
+				*c_2 = smart_child(&tr[5], m);
 				*k = Z_DIV;
 				*c = z.lo() + z_cut;
 				return;
 			}
 
-			*c_1 = y_1;
-			*c_2 = y_2;
+			*c_1 = smart_child(&tr[2], m);
+			*c_2 = smart_child(&tr[3], m);
 			*k = Y_DIV;
 			*c = y.lo() + y_cut;
 		}
@@ -362,16 +410,16 @@ void smart_decision(const sv_model& m, sv_integer level, void* vp, mod_kind* k,
 	{
 		if (xm > zm)
 		{
-			*c_1 = z_1;
-			*c_2 = z_2;
+			*c_1 = smart_child(&tr[4], m);
+			*c_2 = smart_child(&tr[5], m);
 			*k = Z_DIV;
 			*c = z.lo() + z_cut;
 		} else
 		{
 			if( (xm == zm) && (x_cut < z_cut) )
 			{
-				*c_1 = z_1;
-				*c_2 = z_2;
+				*c_1 = smart_child(&tr[4], m);
+				*c_2 = smart_child(&tr[5], m);
 				*k = Z_DIV;
 				*c = z.lo() + z_cut;
 				return;
@@ -379,15 +427,15 @@ void smart_decision(const sv_model& m, sv_integer level, void* vp, mod_kind* k,
 
 			if( (xm == ym) && (x_cut < y_cut) )
 			{
-				*c_1 = y_1;
-				*c_2 = y_2;
+				*c_1 = smart_child(&tr[2], m);
+				*c_2 = smart_child(&tr[3], m);
 				*k = Y_DIV;
 				*c = y.lo() + y_cut;
 				return;
 			}
 
-			*c_1 = x_1;
-			*c_2 = x_2;
+			*c_1 = smart_child(&tr[0], m);
+			*c_2 = smart_child(&tr[1], m);
 			*k = X_DIV;
 			*c = x.lo() + x_cut;
 		}
@@ -395,6 +443,181 @@ void smart_decision(const sv_model& m, sv_integer level, void* vp, mod_kind* k,
 	return;
 }
 
+// Cost-model division.  cost_cuts candidate cuts are tried along each 
+// axis, evenly spaced.  The set list is compiled once and pruned to all
+// their boxes, and only the two children chosen have their set lists
+// built (see sv_set_tree).  With SV_COST_AREA the expected cost of a
+// division is taken to be the contents of each child weighted by the
+// chance of a ray visiting it, which is its surface area over its
+// parent's; with SV_COST_CONTENTS it is just the children's contents
+// added up.  The cheapest cut wins; ties go to the cut nearest the
+// middle, then to the longest side.
+
+static sv_integer cost_cuts = 3;
+
+void set_cost_cuts(sv_integer n)
+{
+	if(n < 1)
+	{
+		svlis_error("set_cost_cuts", "at least one cut is needed", SV_WARNING);
+		n = 1;
+	}
+	cost_cuts = n;
+}
+
+sv_integer get_cost_cuts() { return(cost_cuts); }
+
+static sv_integer cost_measure = SV_COST_AREA;
+
+void set_cost_measure(sv_integer m) { cost_measure = m; }
+
+sv_integer get_cost_measure() { return(cost_measure); }
+
+static sv_real cost_size(const sv_box& b)
+{
+	sv_real x = b.xi.hi() - b.xi.lo();
+	sv_real y = b.yi.hi() - b.yi.lo();
+	sv_real z = b.zi.hi() - b.zi.lo();
+
+	switch(cost_measure)
+	{
+	case SV_COST_AREA:
+		return(x*y + y*z + z*x);
+
+	case SV_COST_CONTENTS:
+		return(1);
+
+	default:
+		svlis_error("cost_decision","dud cost measure", SV_WARNING);
+	}
+	return(x*y + y*z + z*x);
+}
+
+void cost_decision(const sv_model& m, sv_integer level, void* vp, mod_kind* k, sv_real* c, 
+		sv_model* c_1, sv_model* c_2)
+{
+	sv_box mb = m.box();
+	sv_set_list sl = m.set_list();
+	sv_integer dont_divide = 1;
+	sv_integer contents;
+
+// Check each set in the list to see if it has enough contents to make 
+// further division needed.
+
+	while(sl.exists() && dont_divide)
+	{
+		contents = sl.set().contents();
+		if (contents > user_low_contents()) dont_divide = 0;
+		sl = sl.next();
+	}
+
+// If all the sets were simple enough, don't divide further.
+
+	if(dont_divide)
+	{
+		*k = LEAF_M;
+		return;
+	}
+
+// If the box is too small, don't divide it further
+
+	if (mb.vol() < user_little_box())
+	{
+		*k = LEAF_M;
+		return;
+	}
+
+// Make the pairs of child boxes for all the candidate cuts
+
+	sl = m.set_list();
+	sv_integer n = cost_cuts;
+	sv_real swell = get_swell_fac();
+	sv_box* b_part = new sv_box[6*n];
+	sv_prune_mask* mask = new sv_prune_mask[6*n];
+	sv_real* cut = new sv_real[3*n];
+	sv_interval ax[3];
+	sv_interval i_part[2];
+	sv_interval in;
+	sv_integer a, i, j;
+	sv_real t;
+
+	ax[0] = mb.xi;
+	ax[1] = mb.yi;
+	ax[2] = mb.zi;
+	j = 0;
+	for(a = 0; a < 3; a++)
+	{
+		in = ax[a];
+		for(i = 0; i < n; i++)
+		{
+			t = in.lo() + (in.hi() - in.lo())*(sv_real)(i + 1)/(sv_real)(n + 1);
+			cut[j] = t;
+			i_part[0] = sv_interval(in.lo(), t + (t - in.lo())*swell);
+			i_part[1] = sv_interval(t - (in.hi() - t)*swell, in.hi());
+			switch(a)
+			{
+			case 0:
+				b_part[2*j] = sv_box(i_part[0], mb.yi, mb.zi);
+				b_part[2*j + 1] = sv_box(i_part[1], mb.yi, mb.zi);
+				break;
+			case 1:
+				b_part[2*j] = sv_box(mb.xi, i_part[0], mb.zi);
+				b_part[2*j + 1] = sv_box(mb.xi, i_part[1], mb.zi);
+				break;
+			default:
+				b_part[2*j] = sv_box(mb.xi, mb.yi, i_part[0]);
+				b_part[2*j + 1] = sv_box(mb.xi, mb.yi, i_part[1]);
+			}
+			j++;
+		}
+	}
+
+	sv_set_tree st(sl);
+	for(j = 0; j < 6*n; j++) st.prune(b_part[j], &mask[j]);
+
+// Find the cheapest
+
+	sv_real size = cost_size(mb);
+	sv_real cost, off, len;
+	sv_real best_cost = 0, best_off = 0, best_len = 0;
+	sv_integer best = -1;
+
+	if(size <= 0) size = 1;
+	for(j = 0; j < 3*n; j++)
+	{
+		a = j/n;
+		in = ax[a];
+		cost = (cost_size(b_part[2*j])*(sv_real)mask[2*j].contents() + 
+			cost_size(b_part[2*j + 1])*(sv_real)mask[2*j + 1].contents())/size;
+		off = fabs((sv_real)(j % n) - 0.5*(sv_real)(n - 1));
+		len = in.hi() - in.lo();
+		if( (best < 0) || (cost < best_cost) || 
+		    ((cost == best_cost) && ((off < best_off) || 
+		    ((off == best_off) && (len > best_len)))) )
+		{
+			best = j;
+			best_cost = cost;
+			best_off = off;
+			best_len = len;
+		}
+	}
+
+	switch(best/n)
+	{
+	case 0: *k = X_DIV; break;
+	case 1: *k = Y_DIV; break;
+	default: *k = Z_DIV;
+	}
+	*c = cut[best];
+	*c_1 = sv_model(st.set_list(mask[2*best]), b_part[2*best], LEAF_M, m);
+	*c_2 = sv_model(st.set_list(mask[2*best + 1]), b_part[2*best + 1], LEAF_M, m);
+
+	delete [] b_part;
+	delete [] mask;
+	delete [] cut;
+	return;
+}
+
 #if macintosh
  #pragma export off
 #endif
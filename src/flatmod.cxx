@@ -0,0 +1,378 @@
+/* 
+ *  The SvLis Geometric Modelling Kernel
+ *  ------------------------------------
+ *
+ *  Copyright (C) 1993, 1997, 1998, 2000 
+ *  University of Bath & Information Geometers Ltd
+ *
+ *  http://www.bath.ac.uk/
+ *  http://www.inge.com/
+ *
+ *  Principal author:
+ *
+ *     Adrian Bowyer
+ *     Department of Mechanical Engineering
+ *     Faculty of Engineering and Design
+ *     University of Bath
+ *     Bath BA2 7AY
+ *     U.K.
+ *
+ *     e-mail: A.Bowyer@bath.ac.uk
+ *        web: http://www.bath.ac.uk/~ensab/
+ *
+ *   SvLis is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   Licence as published by the Free Software Foundation; either
+ *   version 2 of the Licence, or (at your option) any later version.
+ *
+ *   SvLis is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public Licence for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   Licence along with svLis; if not, write to the Free
+ *   Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA,
+ *   or see
+ *
+ *      http://www.gnu.org/
+ * 
+ * =====================================================================
+ *
+ * SvLis - flattened, read-only divided models
+ *
+ * See the svLis web site for the manual and other details:
+ *
+ *    http://www.bath.ac.uk/~ensab/G_mod/Svlis/
+ *
+ * or see the file
+ *
+ *    docs/svlis.html
+ *
+ * First version: 18 October 2026
+ * This version: 18 October 2026
+ *
+ */
+
+#include "sv_std.h"
+#include "enum_def.h"
+#include "flag.h"
+#include "sums.h"
+#include "geometry.h"
+#include "interval.h"
+#include "sv_b_cls.h"
+#include "prim.h"
+#include "attrib.h"
+#include "sv_set.h"
+#include "decision.h"
+#include "polygon.h"
+#include "model.h"
+#include "flatmod.h"
+#if macintosh
+ #pragma export on
+#endif
+
+// Working storage while a model is flattened.  Leaf set lists are
+// looked up by the sets in them in a hash table so that leaves with 
+// the same sets share one entry.
+
+struct sv_flat_build
+{
+	sv_flat_node* node;	// The nodes being filled in
+	sv_integer next;	// The next free one
+	sv_set_list* list;	// The leaf set lists found so far
+	sv_integer lists;
+	sv_integer* hash;	// Hash table of indices into list
+	sv_integer mask;	// Its length - 1
+	int odd;		// Set if a child box isn't part of its parent's
+};
+
+// Count the nodes and leaves in a model
+
+static void flat_count(const sv_model& m, sv_integer* nodes, sv_integer* leaves)
+{
+	(*nodes)++;
+	if(m.kind() == LEAF_M)
+	{
+		(*leaves)++;
+		return;
+	}
+	flat_count(m.child_1(), nodes, leaves);
+	flat_count(m.child_2(), nodes, leaves);
+}
+
+// Two set lists with the same sets in the same order?
+
+static int flat_match(const sv_set_list& a, const sv_set_list& b)
+{
+	sv_set_list x = a;
+	sv_set_list y = b;
+
+	if(x.unique() == y.unique()) return(1);
+	while(x.exists() && y.exists())
+	{
+		if(!(x.set() == y.set())) return(0);
+		x = x.next();
+		y = y.next();
+	}
+	return(!x.exists() && !y.exists());
+}
+
+// Find (or add) a leaf set list
+
+static sv_integer flat_list(const sv_set_list& sls, sv_flat_build* fb)
+{
+	sv_set_list sl = sls;
+	unsigned long h = 0;
+	sv_integer i;
+
+	while(sl.exists())
+	{
+		h = sv_hash(h, (unsigned long)sl.set().unique());
+		sl = sl.next();
+	}
+	i = (sv_integer)(h & fb->mask);
+	while(fb->hash[i] >= 0)
+	{
+		if(flat_match(fb->list[fb->hash[i]], sls)) return(fb->hash[i]);
+		i = (i + 1) & fb->mask;
+	}
+	fb->list[fb->lists] = sls;
+	fb->hash[i] = fb->lists;
+	return(fb->lists++);
+}
+
+// Do the faces of a child box that aren't along the division match 
+// its parent's?
+
+static int flat_same(const sv_interval& a, const sv_interval& b)
+{
+	return((a.lo() == b.lo()) && (a.hi() == b.hi()));
+}
+
+static int flat_fits(const sv_box& c, const sv_box& p, mod_kind k)
+{
+	if((k != X_DIV) && !flat_same(c.xi, p.xi)) return(0);
+	if((k != Y_DIV) && !flat_same(c.yi, p.yi)) return(0);
+	if((k != Z_DIV) && !flat_same(c.zi, p.zi)) return(0);
+	return(1);
+}
+
+// Fill in node n from model m; its children go in the next two free
+// slots, then their descendants
+
+static void flat_build(const sv_model& m, sv_integer n, sv_flat_build* fb)
+{
+	sv_flat_node* fn = &(fb->node[n]);
+	mod_kind k = m.kind();
+	sv_integer c;
+	sv_model c_1, c_2;
+	sv_box b1, b2;
+
+	fn->coord = m.coord();
+	if(k == LEAF_M)
+	{
+		fn->hi_1 = 0;
+		fn->lo_2 = 0;
+		fn->link = 4*flat_list(m.set_list(), fb) + LEAF_M;
+		return;
+	}
+
+	c_1 = m.child_1();
+	c_2 = m.child_2();
+	b1 = c_1.box();
+	b2 = c_2.box();
+	switch(k)
+	{
+	case X_DIV:
+		fn->hi_1 = b1.xi.hi();
+		fn->lo_2 = b2.xi.lo();
+		break;
+	case Y_DIV:
+		fn->hi_1 = b1.yi.hi();
+		fn->lo_2 = b2.yi.lo();
+		break;
+	case Z_DIV:
+		fn->hi_1 = b1.zi.hi();
+		fn->lo_2 = b2.zi.lo();
+		break;
+	default:
+		svlis_error("flat_build", "dud model kind", SV_CORRUPT);
+	}
+	if(!flat_fits(b1, m.box(), k) || !flat_fits(b2, m.box(), k)) fb->odd = 1;
+
+	c = fb->next;
+	fb->next = fb->next + 2;
+	fn->link = 4*c + k;
+	flat_build(c_1, c, fb);
+	flat_build(c_2, c + 1, fb);
+}
+
+// Flatten a model
+
+sv_flat_model::flat_model_data::flat_model_data(const sv_model& m)
+{
+	sv_flat_build fb;
+	sv_integer leaves = 0;
+	sv_integer i;
+
+	b = m.box();
+	sl = m.set_list();
+	nodes = 0;
+	flat_count(m, &nodes, &leaves);
+	node = new sv_flat_node[nodes];
+
+	fb.node = node;
+	fb.next = 1;
+	fb.list = new sv_set_list[leaves];
+	fb.lists = 0;
+	fb.mask = 1;
+	while(fb.mask < 2*leaves) fb.mask = fb.mask << 1;
+	fb.hash = new sv_integer[fb.mask];
+	for(i = 0; i < fb.mask; i++) fb.hash[i] = -1;
+	fb.mask--;
+	fb.odd = 0;
+
+	flat_build(m, 0, &fb);
+
+	if(fb.odd)
+		svlis_error("sv_flat_model::sv_flat_model(...)",
+			"the model has child boxes that aren't slices of their parents'", SV_WARNING);
+
+// Keep just the distinct lists
+
+	lists = fb.lists;
+	list = new sv_set_list[lists];
+	for(i = 0; i < lists; i++) list[i] = fb.list[i];
+	delete [] fb.list;
+	delete [] fb.hash;
+}
+
+// The boxes of the children of node n with box b
+
+sv_box sv_flat_model::box_1(sv_integer n, const sv_box& b) const
+{
+	sv_flat_node* fn = &(flat_info->node[n]);
+
+	switch(fn->link & 3)
+	{
+	case X_DIV: return(sv_box(sv_interval(b.xi.lo(), fn->hi_1), b.yi, b.zi));
+	case Y_DIV: return(sv_box(b.xi, sv_interval(b.yi.lo(), fn->hi_1), b.zi));
+	case Z_DIV: return(sv_box(b.xi, b.yi, sv_interval(b.zi.lo(), fn->hi_1)));
+	default:
+		svlis_error("sv_flat_model::box_1", "leaf has no children", SV_WARNING);
+	}
+	return(b);
+}
+
+sv_box sv_flat_model::box_2(sv_integer n, const sv_box& b) const
+{
+	sv_flat_node* fn = &(flat_info->node[n]);
+
+	switch(fn->link & 3)
+	{
+	case X_DIV: return(sv_box(sv_interval(fn->lo_2, b.xi.hi()), b.yi, b.zi));
+	case Y_DIV: return(sv_box(b.xi, sv_interval(fn->lo_2, b.yi.hi()), b.zi));
+	case Z_DIV: return(sv_box(b.xi, b.yi, sv_interval(fn->lo_2, b.zi.hi())));
+	default:
+		svlis_error("sv_flat_model::box_2", "leaf has no children", SV_WARNING);
+	}
+	return(b);
+}
+
+// Return the leaf containing a point
+
+sv_integer sv_flat_model::leaf(const sv_point& p, sv_box* lb) const
+{
+	const sv_flat_node* nd = flat_info->node;
+	sv_integer n = 0;
+	sv_integer l;
+	int lower;
+
+	if(flat_info->b.member(p) == SV_AIR) return(-1);
+	if(lb) *lb = flat_info->b;
+
+	while((l = nd[n].link) & 3)
+	{
+		switch(l & 3)
+		{
+		case X_DIV: lower = (p.x < nd[n].coord); break;
+		case Y_DIV: lower = (p.y < nd[n].coord); break;
+		default:    lower = (p.z < nd[n].coord); break;
+		}
+		if(lb) *lb = lower ? box_1(n, *lb) : box_2(n, *lb);
+		n = (l >> 2) + (lower ? 0 : 1);
+	}
+	return(n);
+}
+
+// Membership test a point against a flat model; as for sv_model, the
+// lists in the leaves are unioned.
+
+mem_test sv_flat_model::member(const sv_point& p, sv_primitive* ks) const
+{
+	sv_integer n = leaf(p, 0);
+	mem_test result = SV_AIR;
+	mem_test temp;
+	sv_set_list sl;
+
+	if(n < 0) return(SV_AIR);
+
+	sl = flat_info->list[flat_info->node[n].link >> 2];
+	while(sl.exists())
+	{
+		temp = sl.set().member(p, ks);
+		if(temp == SV_SURFACE) result = SV_SURFACE;
+		if(temp == SV_SOLID) return(SV_SOLID);
+		sl = sl.next();
+	}
+	return(result);
+}
+
+// Gather statistics for node n, whose box is b.  Divided nodes don't
+// keep set lists, so only the leaves' polygons are counted.
+
+void m_stats::flat_stats(const sv_flat_model& f, sv_integer n, const sv_box& b)
+{
+	sv_set_list sl;
+	sv_integer i;
+
+	if (b.diag_sq() < littlest.diag_sq()) littlest = b;
+	total_boxes++;
+
+	if(f.kind(n) == LEAF_M)
+	{
+		sl = f.set_list(n);
+		i = sl.polygon_count();
+		if(i) pgl_stats(i, b);
+		leaf_stats(sl, b);
+		return;
+	}
+	if((f.kind(f.child_1(n)) == LEAF_M) && (f.kind(f.child_2(n)) == LEAF_M) &&
+	   (f.set_list(f.child_1(n)).unique() == f.set_list(f.child_2(n)).unique()))
+		twin_leaves++;
+	flat_stats(f, f.child_1(n), f.box_1(n, b));
+	flat_stats(f, f.child_2(n), f.box_2(n, b));
+}
+
+m_stats::m_stats(const sv_flat_model& f)
+{
+	zero(f.box());
+	flat_stats(f, 0, f.box());
+	leaf_lists = f.list_count();
+	different_lists = leaf_lists;
+	model_stats_av(this);
+}
+
+// Print a stats report to a stream
+
+void sv_flat_model::div_stat_report(ostream& f) const
+{
+	m_stats* ms = new m_stats(*this);
+	ms->report(f, box(), set_list().contents());
+	delete ms;
+}
+
+#if macintosh
+ #pragma export off
+#endif
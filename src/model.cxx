@@ -67,6 +67,10 @@
 #include "decision.h"
 #include "polygon.h"
 #include "model.h"
+#include "sv_pool.h"
+#ifdef SV_UNIX
+#include <sched.h>
+#endif
 #if macintosh
  #pragma export on
 #endif
@@ -238,12 +242,87 @@ static sv_real swell_fac = DEF_SWELL_FAC;
 void set_swell_fac(sv_real sf) {swell_fac = sf;}
 sv_real get_swell_fac() {return(swell_fac);}
 
+// With SV_PARALLEL, subtrees deeper than serial_level are divided
+// serially by whichever thread gets to them
+
+static sv_integer serial_level = DEF_SERIAL_LEVEL;
+
+void set_serial_level(sv_integer l) {serial_level = l;}
+sv_integer get_serial_level() {return(serial_level);}
+
+// Split box b at cut in direction k into b_part[0] and b_part[1]
+
+static void div_boxes(const sv_box& b, mod_kind k, sv_real cut, sv_box* b_part)
+{
+	sv_interval x = b.xi;		// The parent box intervals
+	sv_interval y = b.yi;
+	sv_interval z = b.zi;
+	sv_interval i_part;		// The lower and upper halves of the divided interval
+
+	switch (k)
+	{ 
+	case X_DIV:
+		i_part = sv_interval(x.lo(), cut + (cut - x.lo())*swell_fac);
+		b_part[0] = sv_box(i_part, y, z);
+		i_part = sv_interval(cut - (x.hi() - cut)*swell_fac, x.hi());
+		b_part[1] = sv_box(i_part, y, z);
+		break;
+
+	  case Y_DIV:
+		i_part = sv_interval(y.lo(), cut + (cut - y.lo())*swell_fac);
+		b_part[0] = sv_box(x, i_part, z);
+		i_part = sv_interval(cut - (y.hi() - cut)*swell_fac, y.hi());
+		b_part[1] = sv_box(x, i_part, z);
+		break;
+
+	  case Z_DIV:
+		i_part = sv_interval(z.lo(), cut + (cut - z.lo())*swell_fac);
+		b_part[0] = sv_box(x, y, i_part);
+		i_part = sv_interval(cut - (z.hi() - cut)*swell_fac, z.hi());
+		b_part[1] = sv_box(x, y, i_part);
+		break;
+
+	  default:
+	  	svlis_error("div_boxes", "dud model kind", SV_CORRUPT);
+	}
+}
+
+// Do two boxes overlap?
+
+static int box_meets(const sv_box& a, const sv_box& b)
+{
+	return( (a.xi.lo() <= b.xi.hi()) && (b.xi.lo() <= a.xi.hi()) &&
+		(a.yi.lo() <= b.yi.hi()) && (b.yi.lo() <= a.yi.hi()) &&
+		(a.zi.lo() <= b.zi.hi()) && (b.zi.lo() <= a.zi.hi()) );
+}
+
+// When redividing after a change inside the box dirty, can the old 
+// child c be kept for the new box b?
+
+static int keep_child(const sv_model& c, const sv_box& b, const sv_box* dirty)
+{
+	if(!dirty || !c.exists()) return(0);
+	if(same(c.box(), b) != SV_PLUS) return(0);
+	return(!box_meets(b, *dirty));
+}
+
+// If c is a new leaf with the same box as the old child o, give it o's
+// division, so that redivide_r can look at o's children
+
+static sv_model old_below(const sv_model& o, const sv_model& c, const sv_model& m)
+{
+	if(!o.exists() || (o == c) || (c.kind() != LEAF_M)) return(c);
+	if(same(o.box(), c.box()) != SV_PLUS) return(c);
+	if(o.kind() == LEAF_M) return(c);
+	return(sv_model(m, c.set_list(), c.box(), o.child_1(), o.child_2(), o.kind(), 
+		o.coord(), o.flags()));
+}
+
 void redivide_r(void* vsdd)
 {
 	sv_div_data *sdd = (sv_div_data*) vsdd;
 	sv_set_list s = sdd->set_list();
-	sv_model m = sv_model(sdd->model().parent(), s, sdd->model().box(), sdd->model().child_1(),
-		sdd->model().child_2(), sdd->model().kind(), sdd->model().coord(), sdd->model().flags()); 
+	sv_model m = sdd->model().snapshot(s);
 	sv_integer level = sdd->level();
 	void* vp = sdd->pointer();
 	sv_model result;
@@ -252,11 +331,8 @@ void redivide_r(void* vsdd)
 	mod_kind k;			// The result from decision
 	sv_real cut;			// The result from decision
 	sv_box b = m.box();
-	sv_interval x = b.xi;		// The parent box intervals
-	sv_interval y = b.yi;
-	sv_interval z = b.zi;
-	sv_interval i_part;		// The lower and upper halves of the divided interval
-	sv_box b_part;			// The sub-boxes
+	sv_box b_part[2];		// The sub-boxes
+	sv_set_list s_part[2];		// The set list pruned to them
 	sv_model nul;			// Get rid of unwanted sub-trees by assigning this
 
 	sv_decision decis = sdd->decision();
@@ -275,181 +351,1131 @@ void redivide_r(void* vsdd)
 		return;
 
 	case X_DIV:
-		if ( !c_1.exists() )
+	case Y_DIV:
+	case Z_DIV:
+		div_boxes(b, k, cut, b_part);
+		break;
+
+	  default:
+	  	svlis_error("redivide_r", "dud model kind", SV_CORRUPT);
+	}
+
+// If only part of the set list has changed, keep any old children that
+// are clear of the change.
+
+	if ( !c_1.exists() && keep_child(m.child_1(), b_part[0], sdd->dirty()) )
+		c_1 = m.child_1();
+	if ( !c_2.exists() && keep_child(m.child_2(), b_part[1], sdd->dirty()) )
+		c_2 = m.child_2();
+
+// Prune the set list to both halves in one pass if the decision didn't
+// supply either child.
+
+	if ( !c_1.exists() && !c_2.exists() )
+	{
+		s.prune(b_part, s_part, 2);
+		c_1 = sv_model(s_part[0], b_part[0], LEAF_M, m);
+		c_2 = sv_model(s_part[1], b_part[1], LEAF_M, m);
+	} else
+	{
+		if ( !c_1.exists() ) c_1 = sv_model(s, b_part[0], m);
+		if ( !c_2.exists() ) c_2 = sv_model(s, b_part[1], m);
+	}
+
+// Children that are in the changed region but have the same boxes as 
+// before take their old sub-trees down with them, so parts of those
+// can be kept too.
+
+	if ( sdd->dirty() )
+	{
+		c_1 = old_below(m.child_1(), c_1, m);
+		c_2 = old_below(m.child_2(), c_2, m);
+	}
+
+	level++;
+
+	sv_div_data sd1 = sv_div_data(c_1, c_1.set_list(), level, vp, decis, sdd->dirty());
+	sv_div_data sd2 = sv_div_data(c_2, c_2.set_list(), level, vp, decis, sdd->dirty());
+
+// If the model already has children, check if they're the same as those
+// found and, if so, don't bother to replace them.
+
+	sv_integer get_c1 = (m.kind() == LEAF_M) || (m.child_1() != c_1);
+	sv_integer get_c2 = (m.kind() == LEAF_M) || (m.child_2() != c_2);
+
+#ifdef SV_PARALLEL
+
+// On a parallel machine hand one half to the thread pool and do the
+// other here.  The children share their sets with the parent; that's safe
+// as everything the division changes in a shared node is locked.  Below
+// serial_level there's no point in spawning more tasks.
+
+	if(get_c1 && get_c2 && (level <= serial_level))
+	{
+		sv_task_group tg;
+		tg.run(redivide_r, (void*)&sd1);
+		redivide_r((void*)&sd2);
+		tg.wait();
+	} else
+	{
+		if(get_c1) redivide_r((void*)&sd1);
+		if(get_c2) redivide_r((void*)&sd2);
+	}
+
+#else
+
+// Ordinary von Neuman architecture
+
+	if(get_c1) redivide_r((void*)&sd1);
+	if(get_c2) redivide_r((void*)&sd2);
+
+#endif
+
+// Get the computed sub-models if they are needed
+
+	if(get_c1) c_1 = sd1.result();
+	if(get_c2) c_2 = sd2.result();
+
+	sv_model mcc = sv_model(m, c_1, c_2, k, cut);
+	mcc.set_flags_priv(m.flags());
+	sdd->result( mcc );
+}
+
+// Storage for the root model
+
+static sv_model r_m;
+
+// While a lazy leaf divides, root_model() gives its tree's root.  That is
+// set per thread where the compiler allows it, as leaves of different
+// trees may be dividing at once.
+
+#if defined(SV_UNIX) && defined(__GNUC__)
+static __thread const sv_model* lazy_root = 0;
+#else
+static const sv_model* lazy_root = 0;
+#endif
+
+sv_model root_model()
+{
+	if(lazy_root) return(*lazy_root);
+	return(r_m);
+}
+
+// Initialize recursive division 
+
+sv_model sv_model::redivide(const sv_set_list& s, void* vp, sv_decision decision ) const
+{
+	r_m = *this;
+	sv_model nul;
+	sv_div_data sdd = sv_div_data(*this, s, 0, vp, decision);
+	sv_model result;
+	redivide_r((void*)&sdd);
+	result = sdd.result();
+	r_m = nul;	// Easy way to force system to junk storage for *this.
+				// If it goes away later, r_m won't be left pointing
+				// to it.
+	return(result);
+}
+
+sv_model sv_model::redivide(const sv_set_list& s, const sv_box& dirty, void* vp, 
+			    sv_decision decision ) const
+{
+	r_m = *this;
+	sv_model nul;
+	sv_div_data sdd = sv_div_data(*this, s, 0, vp, decision, &dirty);
+	sv_model result;
+	redivide_r((void*)&sdd);
+	result = sdd.result();
+	r_m = nul;
+	return(result);
+}
+
+// Merging two divided models.  Both are walked down together; where
+// neither is divided across the box being filled in, its leaf is 
+// built from the two models' sets.
+
+// Go down m as far as possible while box is inside one child.  If box
+// isn't inside m at all (the second model not covering the first), m's
+// cuts aren't followed: they could lie outside box, and cutting there 
+// would never make it smaller.
+
+static sv_model merge_down(const sv_model& mm, const sv_box& box)
+{
+	sv_model m = mm;
+
+	if(!box.inside(m.box()))
+		return(sv_model(m.set_list(), m.box(), LEAF_M, m.parent()));
+
+	while(m.kind() != LEAF_M)
+	{
+		if(box.inside(m.child_1().box()))
+			m = m.child_1();
+		else if(box.inside(m.child_2().box()))
+			m = m.child_2();
+		else
+			break;
+	}
+	return(m);
+}
+
+// The part of box b on the low (side 0) or high (side 1) side of face f
+// in the direction k
+
+static sv_box merge_part(const sv_box& b, mod_kind k, sv_real f, sv_integer side)
+{
+	sv_interval x = b.xi;
+	sv_interval y = b.yi;
+	sv_interval z = b.zi;
+
+	switch(k)
+	{
+	case X_DIV:
+		x = side ? sv_interval(max(f, x.lo()), x.hi()) : sv_interval(x.lo(), min(f, x.hi()));
+		break;
+	case Y_DIV:
+		y = side ? sv_interval(max(f, y.lo()), y.hi()) : sv_interval(y.lo(), min(f, y.hi()));
+		break;
+	case Z_DIV:
+		z = side ? sv_interval(max(f, z.lo()), z.hi()) : sv_interval(z.lo(), min(f, z.hi()));
+		break;
+	default:
+		svlis_error("merge_part", "dud model kind", SV_CORRUPT);
+	}
+	return(sv_box(x, y, z));
+}
+
+// Low and high faces of the children of m in the direction they're cut
+
+static void merge_faces(const sv_model& m, sv_real* f1, sv_real* f2)
+{
+	sv_box b1 = m.child_1().box();
+	sv_box b2 = m.child_2().box();
+
+	switch(m.kind())
+	{
+	case X_DIV: *f1 = b1.xi.hi(); *f2 = b2.xi.lo(); break;
+	case Y_DIV: *f1 = b1.yi.hi(); *f2 = b2.yi.lo(); break;
+	case Z_DIV: *f1 = b1.zi.hi(); *f2 = b2.zi.lo(); break;
+	default:
+		*f1 = 0;
+		*f2 = 0;
+		svlis_error("merge_faces", "dud model kind", SV_CORRUPT);
+	}
+}
+
+// The set list of m pruned to box b
+
+static sv_set_list merge_list(const sv_model& m, const sv_box& b)
+{
+	if(same(m.box(), b) == SV_PLUS) return(m.set_list());
+	return(m.set_list().prune(b));
+}
+
+static sv_model merge_r(const sv_model& aa, const sv_model& bb, const sv_box& box, 
+			const sv_model& pt, sv_integer level, void* vp, sv_decision decis)
+{
+	sv_model a = merge_down(aa, box);
+	sv_model b = merge_down(bb, box);
+	sv_model cutter, m, c_1, c_2;
+	sv_set_list sa, sb;
+	sv_real f1, f2;
+
+	if(a.kind() != LEAF_M)
+		cutter = a;
+	else if(b.kind() != LEAF_M)
+		cutter = b;
+
+	if(cutter.exists())
+	{
+		m = sv_model(merge(merge_list(a, box), merge_list(b, box)), box, LEAF_M, pt);
+		merge_faces(cutter, &f1, &f2);
+		c_1 = merge_r(a, b, merge_part(box, cutter.kind(), f1, 0), m, level + 1, vp, decis);
+		c_2 = merge_r(a, b, merge_part(box, cutter.kind(), f2, 1), m, level + 1, vp, decis);
+		return(sv_model(m, c_1, c_2, cutter.kind(), cutter.coord()));
+	}
+
+	sa = merge_list(a, box);
+	sb = merge_list(b, box);
+	m = sv_model(merge(sa, sb), box, LEAF_M, pt);
+	if(!decis || (sa.contents() <= 0) || (sb.contents() <= 0)) return(m);
+
+	sv_div_data sdd = sv_div_data(m, m.set_list(), level, vp, decis);
+	redivide_r((void*)&sdd);
+	return(sdd.result());
+}
+
+sv_model merge(const sv_model& a, const sv_model& b, void* vp, sv_decision decis)
+{
+	sv_model result;
+	sv_model nul;
+
+	r_m = sv_model(merge(a.set_list(), b.set_list()), a.box(), LEAF_M, sv_model());
+	result = merge_r(a, b, a.box(), a.parent(), 0, vp, decis);
+	r_m = nul;
+	return(result);
+}
+
+sv_model merge(const sv_model& a, const sv_model& b) { return(merge(a, b, 0, 0)); }
+
+// Compaction.  Leaf set lists are looked up by their sets in a hash 
+// table (growing as needed) so that leaves with the same sets share one 
+// list; then two sibling leaves that share a list are replaced by a 
+// single leaf.  Sets only match if they are the same set, or are simple
+// and identical with the same attributes.  The statistics use the same
+// table to count the list objects themselves (by_object set).
+
+struct sv_compact
+{
+	sv_set_list* list;	// The leaf set lists found so far
+	sv_integer lists;
+	sv_integer* hash;	// Hash table of indices into list
+	sv_integer mask;	// Its length - 1
+	int by_object;		// Match lists only if they're the same object
+	sv_integer shared;	// The number of leaves given a shared list
+	sv_integer merged;	// The number of sibling pairs merged
+
+	sv_compact(int bo)
+	{
+		sv_integer i;
+
+		mask = 1023;
+		list = new sv_set_list[(mask + 1)/2];
+		hash = new sv_integer[mask + 1];
+		for(i = 0; i <= mask; i++) hash[i] = -1;
+		lists = 0;
+		by_object = bo;
+		shared = 0;
+		merged = 0;
+	}
+
+	~sv_compact() { delete [] list; delete [] hash; }
+};
+
+static unsigned long compact_hash(const sv_set_list& sls, int by_object)
+{
+	sv_set_list sl = sls;
+	sv_set s;
+	unsigned long h = 0;
+
+	if(by_object) return(sv_hash(h, (unsigned long)sl.unique()));
+	while(sl.exists())
+	{
+		s = sl.set();
+		if(s.contents() <= 1)
+			h = sv_hash(h, s.hash());
+		else
+			h = sv_hash(h, (unsigned long)s.unique());
+		sl = sl.next();
+	}
+	return(h);
+}
+
+static int compact_match(const sv_set_list& a, const sv_set_list& b, int by_object)
+{
+	sv_set_list x = a;
+	sv_set_list y = b;
+	sv_set s, t;
+
+	if(x.unique() == y.unique()) return(1);
+	if(by_object) return(0);
+	while(x.exists() && y.exists())
+	{
+		s = x.set();
+		t = y.set();
+		if(!(s == t))
 		{
-			i_part = sv_interval(x.lo(), cut + (cut - x.lo())*swell_fac);
-          		b_part = sv_box(i_part, y, z);
-			c_1 = sv_model(s, b_part, m);
+			if((s.contents() > 1) || !(s.attribute() == t.attribute()) || 
+			   !identical(s, t)) 
+				return(0);
 		}
-		if ( !c_2.exists() )
+		x = x.next();
+		y = y.next();
+	}
+	return(!x.exists() && !y.exists());
+}
+
+static void compact_grow(sv_compact* cp)
+{
+	sv_integer i, j, n = 2*(cp->mask + 1);
+	sv_set_list* list = new sv_set_list[n/2];
+
+	delete [] cp->hash;
+	cp->hash = new sv_integer[n];
+	cp->mask = n - 1;
+	for(i = 0; i < n; i++) cp->hash[i] = -1;
+	for(i = 0; i < cp->lists; i++)
+	{
+		list[i] = cp->list[i];
+		j = (sv_integer)(compact_hash(list[i], cp->by_object) & cp->mask);
+		while(cp->hash[j] >= 0) j = (j + 1) & cp->mask;
+		cp->hash[j] = i;
+	}
+	delete [] cp->list;
+	cp->list = list;
+}
+
+static sv_set_list compact_list(const sv_set_list& sls, sv_compact* cp)
+{
+	sv_integer i;
+
+	if(2*(cp->lists + 1) > cp->mask + 1) compact_grow(cp);
+	i = (sv_integer)(compact_hash(sls, cp->by_object) & cp->mask);
+	while(cp->hash[i] >= 0)
+	{
+		if(compact_match(cp->list[cp->hash[i]], sls, cp->by_object)) 
+			return(cp->list[cp->hash[i]]);
+		i = (i + 1) & cp->mask;
+	}
+	cp->list[cp->lists] = sls;
+	cp->hash[i] = cp->lists++;
+	return(sls);
+}
+
+static int compact_leaf(const sv_model& m)
+{
+	return(!m.lazy() && (m.kind() == LEAF_M) && !m.has_polygons());
+}
+
+// The parent for a leaf that replaces divided model m.  The parent of a
+// model made by divide() is the leaf it was divided from, so that leaf's
+// parent is used.  A lazy leaf is divided where it is, so an expanded 
+// model's parent is the real one (or none, at the root).
+
+static sv_model compact_parent(const sv_model& m)
+{
+	sv_model p = m.parent();
+
+	if(!p.exists() || p.lazy() || (p.kind() != LEAF_M) || (same(p.box(), m.box()) != SV_PLUS))
+		return(p);
+	return(p.parent());
+}
+
+static sv_model compact_r(const sv_model& m, sv_compact* cp)
+{
+	sv_model c_1, c_2;
+	sv_set_list sl;
+
+	if(m.lazy() || m.has_polygons()) return(m);
+
+	if(m.kind() == LEAF_M)
+	{
+		sl = compact_list(m.set_list(), cp);
+		if(sl.unique() == m.set_list().unique()) return(m);
+		cp->shared++;
+		return(sv_model(m.parent(), sl, m.box(), sv_model(), sv_model(), 
+			LEAF_M, 0, m.flags()));
+	}
+
+	c_1 = compact_r(m.child_1(), cp);
+	c_2 = compact_r(m.child_2(), cp);
+
+	if(compact_leaf(c_1) && compact_leaf(c_2) && 
+	   (c_1.set_list().unique() == c_2.set_list().unique()))
+	{
+		cp->merged++;
+		return(sv_model(c_1.set_list(), m.box(), LEAF_M, compact_parent(m)));
+	}
+
+	if((c_1.unique() == m.child_1().unique()) && (c_2.unique() == m.child_2().unique()))
+		return(m);
+	return(sv_model(m.parent(), m.set_list(), m.box(), c_1, c_2, m.kind(), 
+		m.coord(), m.flags()));
+}
+
+sv_model sv_model::compact() const
+{
+	sv_compact cp(0);
+	return(compact_r(*this, &cp));
+}
+
+// Count the leaf set lists for the statistics, and the sibling leaves
+// compact() would merge
+
+static void compact_count(const sv_model& m, sv_compact* obj, sv_compact* sets, 
+			  m_stats* ms)
+{
+	sv_model c_1, c_2;
+
+	if(m.lazy() || (m.kind() == LEAF_M))
+	{
+		compact_list(m.set_list(), obj);
+		compact_list(m.set_list(), sets);
+		return;
+	}
+	c_1 = m.child_1();
+	c_2 = m.child_2();
+	if(compact_leaf(c_1) && compact_leaf(c_2) && !m.has_polygons() &&
+	   compact_match(c_1.set_list(), c_2.set_list(), 0))
+		ms->twin_leaves++;
+	compact_count(c_1, obj, sets, ms);
+	compact_count(c_2, obj, sets, ms);
+}
+
+void m_stats::list_stats(const sv_model& m)
+{
+	sv_compact obj(1);
+	sv_compact sets(0);
+
+	compact_count(m, &obj, &sets, this);
+	leaf_lists = obj.lists;
+	different_lists = sets.lists;
+}
+
+// Breadth-first division.  The nodes at each level are kept in an array;
+// every one of them is offered to the decision procedure, and pruned to
+// its two children if it's divided, before any node at the next level 
+// is looked at.  The tree is then built bottom-up, level by level.  The
+// models made are the same as redivide's.
+
+struct sv_bf_node
+{
+	sv_model md;		// The node as it was before deciding
+	sv_set_list sl;		// The set list it is to be divided with
+	mod_kind k;		// The decision
+	sv_real cut;
+	sv_model c_1;		// Its children
+	sv_model c_2;
+	sv_integer get_c1;	// Do they need dividing in turn?
+	sv_integer get_c2;
+	sv_integer c;		// Where they are in the next level
+	sv_model result;	// The finished sub-model
+};
+
+struct sv_bf_level
+{
+	sv_bf_node* node;	// The nodes at this level
+	sv_integer n;		// How many
+	sv_integer level;	// Its depth below the root
+	sv_bf_level* up;	// The level above
+
+	sv_bf_level(sv_integer nn, sv_integer l, sv_bf_level* u)
+	{
+		node = new sv_bf_node[nn];
+		n = nn;
+		level = l;
+		up = u;
+	}
+
+	~sv_bf_level() { delete [] node; }
+};
+
+// Work for one batch of nodes in a level
+
+struct sv_bf_batch
+{
+	sv_bf_level* lev;
+	sv_integer from;	// Nodes [from, to)
+	sv_integer to;
+	sv_integer stop;	// Level at which to stop dividing (-ve for none)
+	void* vp;
+	sv_decision decis;
+};
+
+// Decide on a node at the given level, and make its children (if any);
+// this is the first half of redivide_r
+
+static void bf_decide(sv_bf_node* bn, sv_integer level, sv_integer stop, void* vp, 
+		      sv_decision decis)
+{
+	sv_model m = bn->md.snapshot(bn->sl);
+	sv_box b_part[2];
+	sv_set_list s_part[2];
+
+	bn->md = m;
+	bn->k = LEAF_M;
+	bn->get_c1 = 0;
+	bn->get_c2 = 0;
+	if((stop < 0) || (level < stop))
+		(*decis) (m, level, vp, &(bn->k), &(bn->cut), &(bn->c_1), &(bn->c_2));
+
+	switch (bn->k)
+	{ 
+	case LEAF_M:
+		if (bn->c_1.exists())
+			bn->result = bn->c_1;
+		else
+			bn->result = sv_model(m.set_list(), m.box(), m.parent());
+		bn->c_1 = sv_model();
+		bn->c_2 = sv_model();
+		return;
+
+	case X_DIV:
+	case Y_DIV:
+	case Z_DIV:
+		div_boxes(m.box(), bn->k, bn->cut, b_part);
+		break;
+
+	  default:
+	  	svlis_error("bf_decide", "dud model kind", SV_CORRUPT);
+		return;
+	}
+
+	if ( !bn->c_1.exists() && !bn->c_2.exists() )
+	{
+		bn->sl.prune(b_part, s_part, 2);
+		bn->c_1 = sv_model(s_part[0], b_part[0], LEAF_M, m);
+		bn->c_2 = sv_model(s_part[1], b_part[1], LEAF_M, m);
+	} else
+	{
+		if ( !bn->c_1.exists() ) bn->c_1 = sv_model(bn->sl, b_part[0], m);
+		if ( !bn->c_2.exists() ) bn->c_2 = sv_model(bn->sl, b_part[1], m);
+	}
+
+	bn->get_c1 = (m.kind() == LEAF_M) || (m.child_1() != bn->c_1);
+	bn->get_c2 = (m.kind() == LEAF_M) || (m.child_2() != bn->c_2);
+}
+
+static void bf_batch(void* vb)
+{
+	sv_bf_batch* bb = (sv_bf_batch*)vb;
+	sv_integer i;
+
+	for(i = bb->from; i < bb->to; i++)
+		bf_decide(&(bb->lev->node[i]), bb->lev->level, bb->stop, bb->vp, bb->decis);
+}
+
+// Nodes in a level are handed out to the thread pool this many at a time
+
+#define SV_BF_BATCH 64
+
+// Decide on all the nodes in a level
+
+static void bf_level(sv_bf_level* lev, sv_integer stop, void* vp, sv_decision decis)
+{
+	sv_integer i, nb = (lev->n + SV_BF_BATCH - 1)/SV_BF_BATCH;
+	sv_bf_batch* bb = new sv_bf_batch[nb];
+
+	for(i = 0; i < nb; i++)
+	{
+		bb[i].lev = lev;
+		bb[i].from = i*SV_BF_BATCH;
+		bb[i].to = bb[i].from + SV_BF_BATCH;
+		if(bb[i].to > lev->n) bb[i].to = lev->n;
+		bb[i].stop = stop;
+		bb[i].vp = vp;
+		bb[i].decis = decis;
+	}
+
+#ifdef SV_PARALLEL
+	if(nb > 1)
+	{
+		sv_task_group tg;
+		for(i = 1; i < nb; i++) tg.run(bf_batch, (void*)&bb[i]);
+		bf_batch((void*)&bb[0]);
+		tg.wait();
+	} else
+		bf_batch((void*)&bb[0]);
+#else
+	for(i = 0; i < nb; i++) bf_batch((void*)&bb[i]);
+#endif
+
+	delete [] bb;
+}
+
+// Make the next level down from the children that need dividing
+
+static sv_bf_level* bf_next(sv_bf_level* lev)
+{
+	sv_integer i, j = 0;
+	sv_bf_node* bn;
+	sv_bf_level* next;
+
+	for(i = 0; i < lev->n; i++) j = j + lev->node[i].get_c1 + lev->node[i].get_c2;
+	if(!j) return(0);
+
+	next = new sv_bf_level(j, lev->level + 1, lev);
+	j = 0;
+	for(i = 0; i < lev->n; i++)
+	{
+		bn = &(lev->node[i]);
+		bn->c = j;
+		if(bn->get_c1)
 		{
-			i_part = sv_interval(cut - (x.hi() - cut)*swell_fac, x.hi());
-			b_part = sv_box(i_part, y, z);
-			c_2 = sv_model(s, b_part, m);
+			next->node[j].md = bn->c_1;
+			next->node[j].sl = bn->c_1.set_list();
+			j++;
 		}
-		break;
+		if(bn->get_c2)
+		{
+			next->node[j].md = bn->c_2;
+			next->node[j].sl = bn->c_2.set_list();
+			j++;
+		}
+	}
+	return(next);
+}
+
+// Build the finished sub-models of a level from those of the level below
+
+static void bf_build(sv_bf_level* lev, sv_bf_level* below)
+{
+	sv_integer i, j;
+	sv_bf_node* bn;
+
+	for(i = 0; i < lev->n; i++)
+	{
+		bn = &(lev->node[i]);
+		if(bn->k == LEAF_M) continue;
+		j = bn->c;
+		if(bn->get_c1) bn->c_1 = below->node[j++].result;
+		if(bn->get_c2) bn->c_2 = below->node[j].result;
+		bn->result = sv_model(bn->md, bn->md.set_list(), bn->md.box(), bn->c_1, 
+			bn->c_2, bn->k, bn->cut, bn->md.flags());
+		bn->c_1 = sv_model();
+		bn->c_2 = sv_model();
+	}
+}
+
+// Divide breadth-first, not offering nodes at level stop (or below) to 
+// the decision procedure if stop >= 0
+
+sv_model sv_model::redivide_bf(const sv_set_list& s, void* vp, sv_decision decision, 
+			       sv_integer stop) const
+{
+	sv_model nul;
+	sv_model result;
+	sv_bf_level* lev = new sv_bf_level(1, 0, 0);
+	sv_bf_level* below = 0;
+	sv_bf_level* next;
+
+	r_m = *this;
+	lev->node[0].md = *this;
+	lev->node[0].sl = s;
+
+	for(;;)
+	{
+		bf_level(lev, stop, vp, decision);
+		if(!(next = bf_next(lev))) break;
+		lev = next;
+	}
+
+	while(lev)
+	{
+		bf_build(lev, below);
+		delete below;
+		below = lev;
+		lev = lev->up;
+	}
+	result = below->node[0].result;
+	delete below;
+
+	r_m = nul;
+	return(result);
+}
+
+// Lazy division.  The leaves share a lazy_data that says how to divide
+// them.  A leaf's division is worked out without any lock; the first
+// thread to finish claims the leaf by setting its level to SV_LAZY_BUSY,
+// fills it in, and then sets the level to -1.  Any other thread that was
+// dividing the same leaf throws its answer away.  Looking at models that
+// are already divided needs no lock.
+
+#define SV_LAZY_BUSY -2
+
+// Wait while another thread fills in a leaf's division; that doesn't call
+// anything, so it won't be long
+
+static void lazy_wait(sv_integer* level)
+{
+	while(sv_atomic_get(level) == SV_LAZY_BUSY)
+	{
+#ifdef SV_UNIX
+		sched_yield();
+#endif
+	}
+}
+
+sv_model::lazy_data::lazy_data(const sv_model& r, void* up, sv_decision dec)
+{
+	d = dec;
+	vp = up;
+	root = new sv_model(r);
+}
+
+sv_model::lazy_data::~lazy_data() { delete root; }
+
+sv_model sv_model::snapshot(const sv_set_list& s) const
+{
+	model_data* md = &(*model_info);
+	sv_integer level = sv_atomic_get(&(md->lazy_level));
+
+	if(level >= 0)
+		return(sv_model(parent(), s, box(), sv_model(), sv_model(), LEAF_M, 0, flags()));
+	if(level == SV_LAZY_BUSY) lazy_wait(&(md->lazy_level));
+	return(sv_model(parent(), s, box(), *(md->child_1), *(md->child_2), md->kind, 
+		md->coord, flags()));
+}
+
+// The root for root_model() has to be a different model from the lazy
+// one, or they'd hold references to each other and never be deleted
+
+sv_model sv_model::divide_lazy(void* vp, sv_decision decision) const
+{
+	sv_model result = sv_model(parent(), set_list(), box(), sv_model(), sv_model(), 
+		LEAF_M, 0, flags());
+	sv_model root = sv_model(parent(), set_list(), box(), sv_model(), sv_model(), 
+		LEAF_M, 0, flags());
+
+	result.model_info->lazy = new lazy_data(root, vp, decision);
+	result.model_info->lazy_level = 0;
+	return(result);
+}
+
+// A lazy leaf to go under m, one level down
+
+static sv_model lazy_child(const sv_model& m, const sv_model& c)
+{
+	return(sv_model(m, c.set_list(), c.box(), sv_model(), sv_model(), LEAF_M, 0, c.flags()));
+}
+
+// Divide a lazy leaf one level, as redivide_r would.  Both new children
+// are lazy leaves, whether the decision procedure made them or not, just
+// as redivide_r goes on to divide both.
+
+void sv_model::expand() const
+{
+	model_data* md = &(*model_info);
+	sv_smart_ptr<lazy_data> ld;
+	sv_model m, c_1, c_2;
+	const sv_model* old_r;
+	sv_integer level;
+	mod_kind k;
+	sv_real cut;
+	sv_box b_part[2];
+	sv_set_list s_part[2];
+
+	level = sv_atomic_get(&(md->lazy_level));
+	if(level < 0)	// Divided, or being filled in by someone else
+	{
+		lazy_wait(&(md->lazy_level));
+		return;
+	}
+
+// The lazy data is never taken away from a leaf once it's divided, as
+// other threads may still be reading it
 
-	  case Y_DIV:
-		if ( !c_1.exists() )
-		{
-			i_part = sv_interval(y.lo(), cut + (cut - y.lo())*swell_fac);
-          		b_part = sv_box(x, i_part, z);
-			c_1 = sv_model(s, b_part, m);
-		}
-		if ( !c_2.exists() )
-		{
-			i_part = sv_interval(cut - (y.hi() - cut)*swell_fac, y.hi());
-			b_part = sv_box(x, i_part, z);
-			c_2 = sv_model(s, b_part, m);
-		}
+	ld = md->lazy;
+	m = sv_model(parent(), set_list(), box(), sv_model(), sv_model(), LEAF_M, 0, flags());
+	old_r = lazy_root;
+	lazy_root = ld->root;
+	(*(ld->d)) (m, level, ld->vp, &k, &cut, &c_1, &c_2);
+	lazy_root = old_r;
+
+	switch (k)
+	{ 
+	case LEAF_M:
+		if (c_1.exists())	// User done the work?
+			c_1 = c_1.snapshot(c_1.set_list());
 		break;
 
-	  case Z_DIV:
-		if ( !c_1.exists() )
+	case X_DIV:
+	case Y_DIV:
+	case Z_DIV:
+		div_boxes(m.box(), k, cut, b_part);
+		if (!c_1.exists() && !c_2.exists())
 		{
-			i_part = sv_interval(z.lo(), cut + (cut - z.lo())*swell_fac);
-          		b_part = sv_box(x, y, i_part);
-			c_1 = sv_model(s, b_part, m);
-		}
-		if ( !c_2.exists() )
+			m.set_list().prune(b_part, s_part, 2);
+			c_1 = sv_model(s_part[0], b_part[0], LEAF_M, m);
+			c_2 = sv_model(s_part[1], b_part[1], LEAF_M, m);
+		} else
 		{
-			i_part = sv_interval(cut - (z.hi() - cut)*swell_fac, z.hi());
-			b_part = sv_box(x, y, i_part);
-			c_2 = sv_model(s, b_part, m);
+			c_1 = c_1.exists() ? lazy_child(m, c_1) : sv_model(m.set_list(), b_part[0], m);
+			c_2 = c_2.exists() ? lazy_child(m, c_2) : sv_model(m.set_list(), b_part[1], m);
 		}
+		c_1.model_info->lazy = ld;
+		c_1.model_info->lazy_level = level + 1;
+		c_2.model_info->lazy = ld;
+		c_2.model_info->lazy_level = level + 1;
 		break;
 
 	  default:
-	  	svlis_error("redivide_r", "dud model kind", SV_CORRUPT);
+	  	svlis_error("sv_model::expand", "dud model kind", SV_CORRUPT);
 	}
 
+// Fill in the leaf unless another thread got there first
 
-	level++;
+	if(!sv_atomic_cas(&(md->lazy_level), level, SV_LAZY_BUSY))
+	{
+		lazy_wait(&(md->lazy_level));
+		return;
+	}
 
-// Create two threads on a parallel machine to divide the two halves of the model
+	if(k != LEAF_M)
+	{
+		md->kind = k;
+		md->coord = cut;
+		*(md->child_1) = c_1;
+		*(md->child_2) = c_2;
+	} else if(c_1.exists())
+	{
+		md->kind = c_1.model_info->kind;
+		md->coord = c_1.model_info->coord;
+		*(md->child_1) = *(c_1.model_info->child_1);
+		*(md->child_2) = *(c_1.model_info->child_2);
+	}
+	sv_atomic_set(&(md->lazy_level), -1);
+}
 
-#ifdef SV_PARALLEL
+// Progressive division.  The tree is held as an array of nodes that can 
+// be changed, with the leaves waiting to be looked at in a heap ordered
+// by contents times volume.  When the budget runs out the sv_model is
+// built from the array; sub-trees that didn't change are reused.
 
-	sv_model d_1 = c_1.deep();
-	sv_model d_2 = c_2.deep();
-	sv_div_data sd1 = sv_div_data(d_1, d_1.set_list(), level, vp, decis);
-	sv_div_data sd2 = sv_div_data(d_2, d_2.set_list(), level, vp, decis);
+struct sv_pg_node
+{
+	sv_model md;		// The model here when it was found
+	sv_integer level;	// Its depth
+	sv_integer c;		// The index of its first child, or -1
+	mod_kind k;		// How it was divided, if it was
+	sv_real cut;
+	sv_integer fresh;	// Set if it was divided here
+	sv_real priority;	// Key in the heap for leaves
+};
+
+struct sv_pg_tree
+{
+	sv_pg_node* node;	// The nodes
+	sv_integer nodes;	// How many there are
+	sv_integer len;		// Space for this many
+	sv_integer* heap;	// Leaves to be looked at
+	sv_integer leaves;	// How many
+	sv_integer hlen;
+	sv_real bytes;		// Rough memory estimate
+
+	sv_pg_tree()
+	{
+		len = 1024;
+		node = new sv_pg_node[len];
+		nodes = 0;
+		hlen = 1024;
+		heap = new sv_integer[hlen];
+		leaves = 0;
+		bytes = 0;
+	}
 
-	pthread_t th_1;
-	pthread_t th_2;
-	pthread_attr_t attr;
-	sv_integer t1 = 1;	// Go to 0 if thread 1/2 runs
-	sv_integer t2 = 1;	
-	sv_integer get_c1 = 0;  // Go to 1 if we need a new c_1/2
-	sv_integer get_c2 = 0;
-	void* rtval;
+	~sv_pg_tree() { delete [] node; delete [] heap; }
+};
 
-//	if(t1 = pthread_attr_setstacksize(&attr, (size_t) 1000000))
-//		svlis_error("redivide_r","can't change stack size",SV_WARNING);
+// Rough memory cost of a model node and each entry in a set list
 
-	if (t1 = pthread_attr_init(&attr))
-              svlis_error("redivide_r","can't initialise thread attribute",
-		SV_WARNING);
+#define SV_PG_NODE_BYTES (sizeof(sv_refct) + sizeof(sv_set_list) + sizeof(sv_box) + \
+	3*(sizeof(sv_model*) + sizeof(sv_model)) + sizeof(mod_kind) + sizeof(sv_real))
+#define SV_PG_LIST_BYTES (sizeof(sv_refct) + sizeof(sv_set) + sizeof(sv_set_list*) + \
+	sizeof(sv_set_list))
 
-	if (m.kind() == LEAF_M)
-	{
-		get_c1 = 1;
-		get_c2 = 1;
-		if(t1 = pthread_create(&th_1, &attr, (void *(*)(void *))redivide_r, (void *)&sd1))
-			redivide_r((void*) &sd1);
+// Rough memory cost of a whole model (each leaf's set list is counted in
+// full, even if it's shared)
 
-		if(t2 = pthread_create(&th_2, &attr, (void *(*)(void *))redivide_r, (void *)&sd2))
-			redivide_r((void*) &sd2);
-	} else
-	{
+sv_integer model_bytes(const sv_model& m)
+{
+	sv_integer b = SV_PG_NODE_BYTES;
 
-// If the model already has children, check if they're the same as those
-// found and, if so, don't bother to replace them.
-  
-		if (m.child_1() != c_1)
-		{
-			get_c1 = 1;
-			if(t1 = pthread_create(&th_1, &attr, (void *(*)(void *))redivide_r, (void *)&sd1))
-				redivide_r((void*) &sd1);			
-		}
+	if(m.lazy() || (m.kind() == LEAF_M))
+		return(b + SV_PG_LIST_BYTES*m.set_list().count());
+	return(b + model_bytes(m.child_1()) + model_bytes(m.child_2()));
+}
 
-		if (m.child_2() != c_2)
-		{
-			get_c2 = 1;
-			if(t2 = pthread_create(&th_2, &attr, (void *(*)(void *))redivide_r, (void *)&sd2))
-				redivide_r((void*) &sd2);	
-		}
+// Add a node
 
+static sv_integer pg_new(sv_pg_tree* t)
+{
+	sv_pg_node* nn;
+	sv_integer i;
+
+	if(t->nodes >= t->len)
+	{
+		nn = new sv_pg_node[2*t->len];
+		for(i = 0; i < t->nodes; i++) nn[i] = t->node[i];
+		delete [] t->node;
+		t->node = nn;
+		t->len = 2*t->len;
 	}
+	t->node[t->nodes].c = -1;
+	t->node[t->nodes].fresh = 0;
+	return(t->nodes++);
+}
 
-// Wait for t1 and/or t2 to come back
+// Put leaf n in the heap
 
-	if(!t1)
-	  if(pthread_join(th_1, &rtval))
-		svlis_error("redivide_r","can't join thread 1",SV_WARNING);
-	if(!t2)
-	  if(pthread_join(th_2, &rtval))
-		svlis_error("redivide_r","can't join thread 2",SV_WARNING);
+static void pg_push(sv_pg_tree* t, sv_integer n)
+{
+	sv_integer* nh;
+	sv_integer i, j;
 
-// Get the computed sub-models if they are needed
+	if(t->leaves >= t->hlen)
+	{
+		nh = new sv_integer[2*t->hlen];
+		for(i = 0; i < t->leaves; i++) nh[i] = t->heap[i];
+		delete [] t->heap;
+		t->heap = nh;
+		t->hlen = 2*t->hlen;
+	}
+	i = t->leaves++;
+	while(i > 0)
+	{
+		j = (i - 1)/2;
+		if(t->node[t->heap[j]].priority >= t->node[n].priority) break;
+		t->heap[i] = t->heap[j];
+		i = j;
+	}
+	t->heap[i] = n;
+}
 
-	if(get_c1) c_1 = sd1.result();
-	if(get_c2) c_2 = sd2.result();
+// Take the leaf with the highest priority from the heap
 
-#else
+static sv_integer pg_pop(sv_pg_tree* t)
+{
+	sv_integer top = t->heap[0];
+	sv_integer last = t->heap[--t->leaves];
+	sv_integer i = 0;
+	sv_integer j;
 
-// Ordinary von Neuman architecture
+	while((j = 2*i + 1) < t->leaves)
+	{
+		if((j + 1 < t->leaves) && 
+		   (t->node[t->heap[j + 1]].priority > t->node[t->heap[j]].priority)) j++;
+		if(t->node[last].priority >= t->node[t->heap[j]].priority) break;
+		t->heap[i] = t->heap[j];
+		i = j;
+	}
+	t->heap[i] = last;
+	return(top);
+}
 
-	sv_div_data sd1 = sv_div_data(c_1, c_1.set_list(), level, vp, decis);
-	sv_div_data sd2 = sv_div_data(c_2, c_2.set_list(), level, vp, decis);
+// Copy model m into node n, putting its leaves in the heap
 
-	if (m.kind() == LEAF_M)
-	{
-		redivide_r((void*)&sd1);
-		redivide_r((void*)&sd2);
-		c_1 = sd1.result();
-		c_2 = sd2.result();
-	} else
-	{
-		if (m.child_1() != c_1)
-		{
-			redivide_r((void*)&sd1);
-			c_1 = sd1.result();
-		}
+static void pg_seed(sv_pg_tree* t, sv_integer n, const sv_model& m, sv_integer level)
+{
+	sv_set_list sl;
+	sv_integer c;
 
-		if (m.child_2() != c_2)
+	t->node[n].md = m;
+	t->node[n].level = level;
+	t->bytes = t->bytes + SV_PG_NODE_BYTES;
+	if(m.kind() == LEAF_M)
+	{
+		sl = m.set_list();
+		t->node[n].priority = m.box().vol()*(sv_real)sl.contents();
+		while(sl.exists())
 		{
-			redivide_r((void*)&sd2);
-			c_2 = sd2.result();
+			t->bytes = t->bytes + SV_PG_LIST_BYTES;
+			sl = sl.next();
 		}
+		pg_push(t, n);
+		return;
 	}
+	c = pg_new(t);
+	pg_new(t);
+	t->node[n].c = c;
+	pg_seed(t, c, m.child_1(), level + 1);
+	pg_seed(t, c + 1, m.child_2(), level + 1);
+}
 
-#endif
+// Offer leaf n to the decision procedure; this is redivide_r without
+// the recursion
 
-	sv_model mcc = sv_model(m, c_1, c_2, k, cut);
-	mcc.set_flags_priv(m.flags());
-	sdd->result( mcc );
-}
+static void pg_decide(sv_pg_tree* t, sv_integer n, void* vp, sv_decision decis)
+{
+	sv_model m = t->node[n].md;
+	sv_integer level = t->node[n].level;
+	sv_model c_1, c_2;
+	mod_kind k;
+	sv_real cut;
+	sv_box b_part[2];
+	sv_set_list s_part[2];
+	sv_integer c;
 
-// Storage for the root model
+	(*decis) (m, level, vp, &k, &cut, &c_1, &c_2);
 
-static sv_model r_m;
+	switch (k)
+	{ 
+	case LEAF_M:
+		if (c_1.exists()) t->node[n].md = c_1;
+		return;
 
-sv_model root_model() { return(r_m); }
+	case X_DIV:
+	case Y_DIV:
+	case Z_DIV:
+		div_boxes(m.box(), k, cut, b_part);
+		break;
 
-// Initialize recursive division 
+	  default:
+	  	svlis_error("pg_decide", "dud model kind", SV_CORRUPT);
+		return;
+	}
 
-sv_model sv_model::redivide(const sv_set_list& s, void* vp, sv_decision decision ) const
+	if ( !c_1.exists() && !c_2.exists() )
+	{
+		m.set_list().prune(b_part, s_part, 2);
+		c_1 = sv_model(s_part[0], b_part[0], LEAF_M, m);
+		c_2 = sv_model(s_part[1], b_part[1], LEAF_M, m);
+	} else
+	{
+		if ( !c_1.exists() ) c_1 = sv_model(m.set_list(), b_part[0], m);
+		if ( !c_2.exists() ) c_2 = sv_model(m.set_list(), b_part[1], m);
+	}
+
+	c = pg_new(t);
+	pg_new(t);
+	t->node[n].c = c;
+	t->node[n].k = k;
+	t->node[n].cut = cut;
+	t->node[n].fresh = 1;
+	pg_seed(t, c, c_1, level + 1);
+	pg_seed(t, c + 1, c_2, level + 1);
+}
+
+// Build the model from node n
+
+static sv_model pg_build(sv_pg_tree* t, sv_integer n)
 {
-	r_m = *this;
+	sv_pg_node* pn = &(t->node[n]);
+	sv_model md = pn->md;
+	sv_model c_1, c_2;
+
+	if(pn->c < 0) return(md);
+	c_1 = pg_build(t, pn->c);
+	c_2 = pg_build(t, pn->c + 1);
+	pn = &(t->node[n]);
+	if(pn->fresh) 
+		return(sv_model(md, md.set_list(), md.box(), c_1, c_2, pn->k, pn->cut, md.flags()));
+	if((c_1 == md.child_1()) && (c_2 == md.child_2())) return(md);
+	return(sv_model(md.parent(), md.set_list(), md.box(), c_1, c_2, md.kind(), 
+		md.coord(), md.flags()));
+}
+
+sv_model sv_model::divide_progressive(void* vp, sv_decision decision, 
+				      const sv_div_budget& bud) const
+{
+	sv_pg_tree* t = new sv_pg_tree();
+	double t0 = sv_wall_time();
+	sv_real sec = 0;
+	sv_integer count = 0;
 	sv_model nul;
-	sv_div_data sdd = sv_div_data(*this, s, 0, vp, decision);
 	sv_model result;
-	redivide_r((void*)&sdd);
-	result = sdd.result();
-	r_m = nul;	// Easy way to force system to junk storage for *this.
-				// If it goes away later, r_m won't be left pointing
-				// to it.
+
+	r_m = *this;
+	pg_seed(t, pg_new(t), *this, 0);
+
+	while(t->leaves)
+	{
+		pg_decide(t, pg_pop(t), vp, decision);
+		count++;
+		if(bud.seconds > 0 || bud.progress)
+			sec = (sv_real)(sv_wall_time() - t0);
+		if((bud.seconds > 0) && (sec >= bud.seconds)) break;
+		if((bud.nodes > 0) && (t->nodes >= bud.nodes)) break;
+		if((bud.bytes > 0) && (t->bytes >= (sv_real)bud.bytes)) break;
+		if(bud.progress && (bud.every > 0) && !(count % bud.every))
+			if((*bud.progress)(t->nodes, t->leaves, sec, bud.progress_data)) break;
+	}
+
+	result = pg_build(t, 0);
+	if(bud.progress)
+		(*bud.progress)(t->nodes, t->leaves, (sv_real)(sv_wall_time() - t0), bud.progress_data);
+	delete t;
+
+	r_m = nul;
 	return(result);
 }
 
@@ -535,6 +1561,312 @@ mem_test sv_model::member(const sv_point& p, sv_primitive* ks) const
 	return(result);
 }
 
+// Batch membership tests against a model.  The points are put in Morton
+// (Z-curve) order within the model's box, so points near one another in
+// space are near one another in the arrays, and then handed down the tree
+// together; each leaf tests all the points that reach it against its set
+// list with the sets' own batch membership test.
+
+#define SV_MORTON_BITS 10	// Bits per axis in the Morton codes
+#define SV_MEM_LEAF 256		// Points a leaf tests at a time
+#define SV_MEM_PARALLEL 4096	// Fewer points than this aren't split among threads
+
+// Spread the bottom 10 bits of i out to every third bit
+
+static sv_integer morton_spread(sv_integer i)
+{
+	i = (i | (i << 16)) & 0x030000FF;
+	i = (i | (i << 8)) & 0x0300F00F;
+	i = (i | (i << 4)) & 0x030C30C3;
+	i = (i | (i << 2)) & 0x09249249;
+	return(i);
+}
+
+// Quantize a coordinate in an interval to SV_MORTON_BITS
+
+static sv_integer morton_cell(sv_real c, const sv_interval& i)
+{
+	sv_integer top = (1 << SV_MORTON_BITS) - 1;
+	sv_real w = i.hi() - i.lo();
+	sv_integer k;
+
+	if(w <= 0) return(0);
+	c = (c - i.lo())/w;
+	if(!(c > 0)) return(0);
+	if(c >= 1) return(top);
+	k = (sv_integer)(c*(top + 1));
+	return(min(k, top));
+}
+
+// Put the points in Morton order in box b; ord[i] is set to the index
+// of the ith point in that order.  This is a radix sort, a digit of
+// SV_MORTON_BITS at a time, so it's stable and linear in n.
+
+static void morton_order(const sv_box& b, const sv_real* x, const sv_real* y,
+	const sv_real* z, sv_integer n, sv_integer* ord)
+{
+	sv_integer* key = new sv_integer[n];
+	sv_integer* k2 = new sv_integer[n];
+	sv_integer* o2 = new sv_integer[n];
+	sv_integer count[1 << SV_MORTON_BITS];
+	sv_integer i, j, d, sh, mask = (1 << SV_MORTON_BITS) - 1;
+
+	for(i = 0; i < n; i++)
+	{
+		key[i] = morton_spread(morton_cell(x[i], b.xi)) |
+			(morton_spread(morton_cell(y[i], b.yi)) << 1) |
+			(morton_spread(morton_cell(z[i], b.zi)) << 2);
+		ord[i] = i;
+	}
+
+	for(sh = 0; sh < 3*SV_MORTON_BITS; sh += SV_MORTON_BITS)
+	{
+		for(d = 0; d <= mask; d++) count[d] = 0;
+		for(i = 0; i < n; i++) count[(key[i] >> sh) & mask]++;
+		j = 0;
+		for(d = 0; d <= mask; d++)
+		{
+			i = count[d];
+			count[d] = j;
+			j = j + i;
+		}
+		for(i = 0; i < n; i++)
+		{
+			j = count[(key[i] >> sh) & mask]++;
+			k2[j] = key[i];
+			o2[j] = ord[i];
+		}
+		for(i = 0; i < n; i++)
+		{
+			key[i] = k2[i];
+			ord[i] = o2[i];
+		}
+	}
+
+	delete [] key;
+	delete [] k2;
+	delete [] o2;
+}
+
+// The points that go into one node of the tree: ix[0..n-1] index the
+// (sorted) coordinate and answer arrays, and tmp is scratch space as
+// long as ix
+
+struct sv_mem_batch
+{
+	sv_model m;
+	const sv_real* x;
+	const sv_real* y;
+	const sv_real* z;
+	mem_test* r;
+	sv_integer* ix;
+	sv_integer* tmp;
+	sv_integer n;
+};
+
+// Test up to SV_MEM_LEAF points against a leaf's set list; as in
+// member(point) the list is a union, so points stop being tested when 
+// they are found to be solid
+
+static void member_leaf(const sv_set_list& list, const sv_mem_batch* mb, 
+	const sv_integer* ix, sv_integer n)
+{
+	sv_real x[SV_MEM_LEAF], y[SV_MEM_LEAF], z[SV_MEM_LEAF];
+	sv_integer live[SV_MEM_LEAF];
+	mem_test t[SV_MEM_LEAF];
+	sv_set_list sl = list;
+	sv_integer i, j, k;
+
+	for(i = 0; i < n; i++)
+	{
+		k = ix[i];
+		x[i] = mb->x[k];
+		y[i] = mb->y[k];
+		z[i] = mb->z[k];
+		live[i] = k;
+		mb->r[k] = SV_AIR;
+	}
+
+	while(sl.exists() && n)
+	{
+		sl.set().member(x, y, z, t, n);
+		j = 0;
+		for(i = 0; i < n; i++)
+		{
+			k = live[i];
+			if(t[i] == SV_SOLID)
+			{
+				mb->r[k] = SV_SOLID;
+				continue;
+			}
+			if(t[i] == SV_SURFACE) mb->r[k] = SV_SURFACE;
+			x[j] = x[i];
+			y[j] = y[i];
+			z[j] = z[i];
+			live[j] = k;
+			j++;
+		}
+		n = j;
+		sl = sl.next();
+	}
+}
+
+// Hand a batch of points down the tree.  The points going to each child
+// are kept in the order they came in.
+
+static void member_batch_r(void* vp)
+{
+	sv_mem_batch* mb = (sv_mem_batch*)vp;
+	sv_mem_batch c[2];
+	sv_integer i, j, k, n1, n2;
+	const sv_real* cd;
+	sv_real cut;
+	sv_box b;
+
+	if(!mb->n) return;
+
+// As in member(point), points outside the box are air
+
+	b = mb->m.box();
+	j = 0;
+	for(i = 0; i < mb->n; i++)
+	{
+		k = mb->ix[i];
+		if(b.member(sv_point(mb->x[k], mb->y[k], mb->z[k])) == SV_AIR)
+			mb->r[k] = SV_AIR;
+		else
+			mb->ix[j++] = k;
+	}
+	mb->n = j;
+	if(!mb->n) return;
+
+	switch(mb->m.kind())
+	{
+	case X_DIV:
+		cd = mb->x;
+		break;
+	case Y_DIV:
+		cd = mb->y;
+		break;
+	case Z_DIV:
+		cd = mb->z;
+		break;
+
+	case LEAF_M:
+		for(i = 0; i < mb->n; i += SV_MEM_LEAF)
+			member_leaf(mb->m.set_list(), mb, mb->ix + i, min(mb->n - i, (sv_integer)SV_MEM_LEAF));
+		return;
+
+	default:
+		svlis_error("member_batch_r(...)","dud model kind",SV_CORRUPT);
+		return;
+	}
+
+// Split the points between the children, the first child's at the
+// start of tmp and the second's in reverse from its end, then copy them
+// back to ix in order
+
+	cut = mb->m.coord();
+	n1 = 0;
+	n2 = mb->n;
+	for(i = 0; i < mb->n; i++)
+	{
+		k = mb->ix[i];
+		if(cd[k] < cut)
+			mb->tmp[n1++] = k;
+		else
+			mb->tmp[--n2] = k;
+	}
+	for(i = 0; i < n1; i++) mb->ix[i] = mb->tmp[i];
+	for(i = n1, j = mb->n - 1; i < mb->n; i++, j--) mb->ix[i] = mb->tmp[j];
+
+	for(i = 0; i < 2; i++)
+	{
+		c[i].x = mb->x;
+		c[i].y = mb->y;
+		c[i].z = mb->z;
+		c[i].r = mb->r;
+	}
+	c[0].m = mb->m.child_1();
+	c[0].ix = mb->ix;
+	c[0].tmp = mb->tmp;
+	c[0].n = n1;
+	c[1].m = mb->m.child_2();
+	c[1].ix = mb->ix + n1;
+	c[1].tmp = mb->tmp + n1;
+	c[1].n = mb->n - n1;
+
+#ifdef SV_PARALLEL
+
+// The children's points are in separate parts of the arrays, so big
+// batches can go down both sides at once
+
+	if((c[0].n >= SV_MEM_PARALLEL) && (c[1].n >= SV_MEM_PARALLEL) &&
+		(get_worker_threads() > 1))
+	{
+		sv_task_group tg;
+		tg.run(member_batch_r, (void*)&c[1]);
+		member_batch_r((void*)&c[0]);
+		tg.wait();
+		return;
+	}
+
+#endif
+
+	member_batch_r((void*)&c[0]);
+	member_batch_r((void*)&c[1]);
+}
+
+// Membership test a batch of points against a model
+
+void sv_model::member(const sv_real* x, const sv_real* y, const sv_real* z, 
+	mem_test* r, sv_integer n) const
+{
+	sv_integer* ord;
+	sv_real* sx;
+	sv_real* sy;
+	sv_real* sz;
+	mem_test* sr;
+	sv_mem_batch mb;
+	sv_integer i;
+
+	if(n <= 0) return;
+
+	ord = new sv_integer[n];
+	morton_order(box(), x, y, z, n, ord);
+	sx = new sv_real[n];
+	sy = new sv_real[n];
+	sz = new sv_real[n];
+	sr = new mem_test[n];
+	mb.ix = new sv_integer[n];
+	mb.tmp = new sv_integer[n];
+	for(i = 0; i < n; i++)
+	{
+		sx[i] = x[ord[i]];
+		sy[i] = y[ord[i]];
+		sz[i] = z[ord[i]];
+		mb.ix[i] = i;
+	}
+
+	mb.m = *this;
+	mb.x = sx;
+	mb.y = sy;
+	mb.z = sz;
+	mb.r = sr;
+	mb.n = n;
+	member_batch_r((void*)&mb);
+
+	for(i = 0; i < n; i++) r[ord[i]] = sr[i];
+
+	delete [] ord;
+	delete [] sx;
+	delete [] sy;
+	delete [] sz;
+	delete [] sr;
+	delete [] mb.ix;
+	delete [] mb.tmp;
+}
+
 // Return the leaf containing a point
 
 sv_model sv_model::leaf(const sv_point& p) const
@@ -579,18 +1911,12 @@ sv_model sv_model::leaf(const sv_point& p) const
 
 void m_stats::model_stats(const sv_model& m, m_stats* ms)
 {
-	sv_set_list sl;
-	sv_set s;
-	sv_integer i, j, sol;
+	sv_integer i;
 	sv_box b = m.box();
-	sv_real x = b.xi.hi() - b.xi.lo();
-	sv_real y = b.yi.hi() - b.yi.lo();
-	sv_real z = b.zi.hi() - b.zi.lo();
 
 	if (b.diag_sq() < ms->littlest.diag_sq()) ms->littlest = b;
 	ms->total_boxes++;
 
-
 	i = m.polygon_count();
 	if(i)
 	{
@@ -599,61 +1925,12 @@ void m_stats::model_stats(const sv_model& m, m_stats* ms)
 			svlis_error("m_stats::model_stats(...)","model polygon flag un-set",SV_WARNING);
 			// m.set_flags_priv(SV_POLYGON_FLAG);
 		}
-		ms->pg_count = ms->pg_count + (sv_real)i;
-		if (i > ms->max_pg_count) ms->max_pg_count = i;
-		ms->pgl_x = ms->pgl_x + x;
-		ms->pgl_y = ms->pgl_y + y;
-		ms->pgl_z = ms->pgl_z + z;
-		ms->pgl_boxes++;
-		ms->pgl_volume = ms->pgl_volume + b.vol();
+		ms->pgl_stats(i, b);
 	}
 
 	switch(m.kind())
 	{
-	case LEAF_M:	sl = m.set_list();
-
-			// Anything there other than NOTHING or EVERYTHING?
-
-			j = 0;
-                        sol = 0;
-			while(sl.exists())
-			{
-				s = sl.set();
-				if ((i = s.contents()) > 0) j = j + i;
-				if (i == SV_EVERYTHING) sol = 1;       // Set lists unioned
-				sl = sl.next();
-			}
-
-			if(!j || sol)
-			{
-			      if(sol)
-			      {
-				ms->s_volume = ms->s_volume + b.vol();
-				ms->s_boxes++;
-				ms->s_x = ms->s_x + x;
-				ms->s_y = ms->s_y + y;
-				ms->s_z = ms->s_z + z;
-			      } else
-			      {
-				ms->a_volume = ms->a_volume + b.vol();
-				ms->a_boxes++;
-				ms->a_x = ms->a_x + x;
-				ms->a_y = ms->a_y + y;
-				ms->a_z = ms->a_z + z;
-			      }
-			} else
-			{
-				ms->surface_volume = ms->surface_volume + b.vol();
-				ms->surface_boxes++;
-				ms->surface_x = ms->surface_x + x;
-				ms->surface_y = ms->surface_y + y;
-				ms->surface_z = ms->surface_z + z;
-				ms->surface_contents = ms->surface_contents + 
-					(sv_real)j;
-				if (j > ms->max_surface_contents) 
-					ms->max_surface_contents = j;
-			}
-
+	case LEAF_M:	ms->leaf_stats(m.set_list(), b);
 			break;
 
 	case X_DIV:
@@ -669,6 +1946,72 @@ void m_stats::model_stats(const sv_model& m, m_stats* ms)
 	}
 }
 
+// Add a box containing i polygons
+
+void m_stats::pgl_stats(sv_integer i, const sv_box& b)
+{
+	pg_count = pg_count + (sv_real)i;
+	if (i > max_pg_count) max_pg_count = i;
+	pgl_x = pgl_x + b.xi.hi() - b.xi.lo();
+	pgl_y = pgl_y + b.yi.hi() - b.yi.lo();
+	pgl_z = pgl_z + b.zi.hi() - b.zi.lo();
+	pgl_boxes++;
+	pgl_volume = pgl_volume + b.vol();
+}
+
+// Add a leaf box with set list sl
+
+void m_stats::leaf_stats(const sv_set_list& sls, const sv_box& b)
+{
+	sv_set_list sl = sls;
+	sv_set s;
+	sv_integer i, j, sol;
+	sv_real x = b.xi.hi() - b.xi.lo();
+	sv_real y = b.yi.hi() - b.yi.lo();
+	sv_real z = b.zi.hi() - b.zi.lo();
+
+	// Anything there other than NOTHING or EVERYTHING?
+
+	j = 0;
+	sol = 0;
+	while(sl.exists())
+	{
+		s = sl.set();
+		if ((i = s.contents()) > 0) j = j + i;
+		if (i == SV_EVERYTHING) sol = 1;       // Set lists unioned
+		sl = sl.next();
+	}
+
+	if(!j || sol)
+	{
+	      if(sol)
+	      {
+		s_volume = s_volume + b.vol();
+		s_boxes++;
+		s_x = s_x + x;
+		s_y = s_y + y;
+		s_z = s_z + z;
+	      } else
+	      {
+		a_volume = a_volume + b.vol();
+		a_boxes++;
+		a_x = a_x + x;
+		a_y = a_y + y;
+		a_z = a_z + z;
+	      }
+	} else
+	{
+		surface_volume = surface_volume + b.vol();
+		surface_boxes++;
+		surface_x = surface_x + x;
+		surface_y = surface_y + y;
+		surface_z = surface_z + z;
+		surface_contents = surface_contents + (sv_real)j;
+		if (j > max_surface_contents) 
+			max_surface_contents = j;
+	}
+}
+
 // Compute averages after stats have been gathered
 
 void m_stats::model_stats_av(m_stats* ms)
@@ -716,13 +2059,19 @@ void m_stats::model_stats_av(m_stats* ms)
 void sv_model::div_stat_report(ostream& f) const
 {
 	m_stats* ms = new m_stats(*this);
+	ms->report(f, box(), set_list().contents());
+	delete ms;
+}
+
+// Print the statistics for a model with box b and cts primitives
 
-	sv_box b = box();
+void m_stats::report(ostream& f, const sv_box& b, sv_integer cts) const
+{
+	const m_stats* ms = this;
 	sv_real x = b.xi.hi() - b.xi.lo();
 	sv_real y = b.yi.hi() - b.yi.lo();
 	sv_real z = b.zi.hi() - b.zi.lo();
 	sv_real vol = b.vol();
-	sv_integer cts = set_list().contents();
 
 	f << SV_EL << "SvLis division statistics" << SV_EL << SV_EL;
 	f << "  Note: percentages will total more than 100 if box swell is > 0." << SV_EL << SV_EL;
@@ -770,6 +2119,11 @@ void sv_model::div_stat_report(ostream& f) const
 	} else
 		f << SV_EL;
 
+	f << "  The leaf boxes have " << ms->leaf_lists << " set lists between them, of which " <<
+		ms->different_lists << " are different." << SV_EL;
+	f << "    There are " << ms->twin_leaves << 
+		" pairs of sibling leaves with the same sets (see sv_model::compact())." << SV_EL << SV_EL;
+
 	f << "  There are " << ms->pgl_boxes << " boxes in the tree containing polygons." << SV_EL;
 	if (ms->pgl_boxes)
 	{
@@ -789,8 +2143,6 @@ void sv_model::div_stat_report(ostream& f) const
 	f << SV_EL << SV_EL;
 
 	f.flush();
-
-	delete ms;
 }
 #if macintosh
  #pragma export off
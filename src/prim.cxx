@@ -63,6 +63,7 @@
 #include "interval.h"
 #include "sv_b_cls.h"
 #include "prim.h"
+#include "tape.h"
 #if macintosh
  #pragma export on
 #endif
@@ -72,6 +73,126 @@
 // of an exponentiation is assumed to be real (and indeed is sometimes
 // rounded to an integer, which it ought to be).
 
+// Primitive nodes are all the same size, so they are carved out of
+// big chunks and recycled on free lists.  Each thread has its own list
+// where the compiler allows it, so there is no locking; a node freed by
+// one thread may be reused by another.  When a thread exits its list is
+// handed to a shared spare list, which threads that run out take from
+// before they make a new chunk.  Chunks are never given back.
+
+#define SV_PRIM_CHUNK 1024
+
+struct sv_prim_free_node { sv_prim_free_node* next; };
+
+#if defined(SV_UNIX) && defined(__GNUC__)
+static __thread sv_prim_free_node* prim_free = 0;
+static __thread int prim_keyed = 0;
+static sv_prim_free_node* prim_spare = 0;
+static sv_lock prim_spare_lock;
+static pthread_key_t prim_key;
+static pthread_once_t prim_once = PTHREAD_ONCE_INIT;
+#define SV_PRIM_POOL_LOCK
+#define SV_PRIM_POOL_UNLOCK
+
+// Give an exiting thread's free list (pointed to by v) to the spares
+
+static void prim_thread_end(void* v)
+{
+	sv_prim_free_node** l = (sv_prim_free_node**)v;
+	sv_prim_free_node* n = *l;
+
+	if(!n) return;
+	while(n->next) n = n->next;
+	prim_spare_lock.shut();
+	n->next = prim_spare;
+	prim_spare = *l;
+	prim_spare_lock.open();
+	*l = 0;
+}
+
+static void prim_key_make() { pthread_key_create(&prim_key, prim_thread_end); }
+
+// The first time a thread uses the pool it's set up to give its list
+// back when it exits
+
+static inline void prim_thread_start()
+{
+	if(prim_keyed) return;
+	pthread_once(&prim_once, prim_key_make);
+	pthread_setspecific(prim_key, (void*)&prim_free);
+	prim_keyed = 1;
+}
+
+// Refill this thread's empty list from the spares; 0 if there are none
+
+static int prim_refill()
+{
+	prim_spare_lock.shut();
+	prim_free = prim_spare;
+	prim_spare = 0;
+	prim_spare_lock.open();
+	return(prim_free != 0);
+}
+#else
+static sv_prim_free_node* prim_free = 0;
+static sv_lock prim_pool_lock;
+#define SV_PRIM_POOL_LOCK prim_pool_lock.shut()
+#define SV_PRIM_POOL_UNLOCK prim_pool_lock.open()
+
+static inline void prim_thread_start() { }
+static int prim_refill() { return(0); }
+#endif
+
+static size_t prim_node_size = 0;
+
+void* sv_prim_alloc(size_t s)
+{
+	sv_prim_free_node* n;
+	char* c;
+	sv_integer i;
+
+// Round up so that nodes stay aligned
+
+	s = (s + 15) & ~((size_t)15);
+	if(!prim_node_size) prim_node_size = s;
+	if(s != prim_node_size)
+		svlis_error("sv_prim_alloc", "nodes of different sizes", SV_CORRUPT);
+
+	prim_thread_start();
+	SV_PRIM_POOL_LOCK;
+	if(!prim_free && !prim_refill())
+	{
+		if(!(c = (char*)malloc(s*SV_PRIM_CHUNK)))
+		{
+			SV_PRIM_POOL_UNLOCK;
+			svlis_error("sv_prim_alloc", "out of memory", SV_FATAL);
+			return(0);
+		}
+		for(i = SV_PRIM_CHUNK - 1; i >= 0; i--)
+		{
+			n = (sv_prim_free_node*)(c + i*s);
+			n->next = prim_free;
+			prim_free = n;
+		}
+	}
+	n = prim_free;
+	prim_free = n->next;
+	SV_PRIM_POOL_UNLOCK;
+	return((void*)n);
+}
+
+void sv_prim_free(void* p)
+{
+	sv_prim_free_node* n = (sv_prim_free_node*)p;
+
+	if(!p) return;
+	prim_thread_start();
+	SV_PRIM_POOL_LOCK;
+	n->next = prim_free;
+	prim_free = n;
+	SV_PRIM_POOL_UNLOCK;
+}
+
 // Unique tag
 
 sv_integer sv_primitive::tag() const { return(SVT_F*SVT_PRIM); }
@@ -227,10 +348,73 @@ void lazy_grad(const sv_primitive& p, sv_primitive& x, sv_primitive& y, sv_primi
 	}
 }
 
+// Build the grad primitives and cache them.  Another thread may
+// have got there first while we were waiting for the lock.  The slot is
+// only filled in once the grads are complete, so readers need no lock.
+
+static sv_lock grad_lock;
+
+void sv_primitive::make_grads() const
+{
+	sv_primitive x, y, z;
+
+	grad_lock.shut();
+	if (!grads())
+	{
+		lazy_grad(*this, x, y, z);
+		sv_atomic_set_ptr((void**)&(prim_info->grads), 0, 
+			(void*)new sv_prim_grads(x, y, z));
+	}
+	grad_lock.open();
+}
+
+void sv_grads_delete(sv_prim_grads* g) { delete g; }
+
+// The grad primitives are only built when something asks for them (or
+// when they have been set explicitly, as for the torus).  Otherwise
+// compound primitives get their grads from a forward-mode pass over their
+// tape, which gives the value as well.
+
+const sv_prim_tape* sv_primitive::grad_tape() const
+{
+	const sv_prim_tape* t;
+
+	if(grads()) return(0);
+	if(!(t = tape())) return(0);
+	if(!t->users()) return(t);
+	return(0);
+}
+
 // The grad at a point
 
 sv_point sv_primitive::grad(const sv_point& p) const
 {
+	const sv_prim_tape* t;
+	sv_point g;
+	sv_real v;
+
+	if((t = grad_tape()))
+	{
+		t->grad(p, &v, &g);
+		return(g);
+	}
+	return( sv_point( this->grad_x().value(p), this->grad_y().value(p), 
+		this->grad_z().value(p) ) );
+}
+
+// The grad and the value at a point
+
+sv_point sv_primitive::grad(const sv_point& p, sv_real& v) const
+{
+	const sv_prim_tape* t;
+	sv_point g;
+
+	if((t = grad_tape()))
+	{
+		t->grad(p, &v, &g);
+		return(g);
+	}
+	v = value(p);
 	return( sv_point( this->grad_x().value(p), this->grad_y().value(p), 
 		this->grad_z().value(p) ) );
 }
@@ -242,8 +426,7 @@ sv_point sv_primitive::p_grad(const sv_point& p) const
 {
         sv_primitive q = *this;
 	if(q.op() == SV_ABS) q = q.child_1();
-	return( sv_point( q.grad_x().value(p), q.grad_y().value(p), 
-		q.grad_z().value(p) ) );
+	return(q.grad(p));
 }
 
 // The range of grads in a box
@@ -251,6 +434,14 @@ sv_point sv_primitive::p_grad(const sv_point& p) const
 sv_box sv_primitive::grad(const sv_box& b) const
 {
 	sv_box result;
+	const sv_prim_tape* t;
+	sv_interval r;
+
+	if ((kind() != SV_PLANE) && (t = grad_tape()))
+	{
+		t->grad(b, &r, &result);
+		return(result);
+	}
 
 	if (kind() == SV_PLANE)
 	{
@@ -264,6 +455,22 @@ sv_box sv_primitive::grad(const sv_box& b) const
 	return(result);
 }
 
+// The ranges of grads and of the value in a box
+
+sv_box sv_primitive::grad(const sv_box& b, sv_interval& r) const
+{
+	sv_box result;
+	const sv_prim_tape* t;
+
+	if ((kind() != SV_PLANE) && (t = grad_tape()))
+	{
+		t->grad(b, &r, &result);
+		return(result);
+	}
+	r = range(b);
+	return(grad(b));
+}
+
                
 // Normal user i/o functions
 
@@ -800,9 +1007,7 @@ sv_primitive p_torus(const sv_line& axis, sv_real rr, sv_real r)
 
 // explicitly set the gradients
 
-	*(t.prim_info->grad_x) = x;
-	*(t.prim_info->grad_y) = y;
-	*(t.prim_info->grad_z) = z;
+	t.prim_info->grads = new sv_prim_grads(x, y, z);
 
         return(t);
 }
@@ -1149,6 +1354,7 @@ prim_op same(const sv_primitive& aa, const sv_primitive& bb)
 	int flip = 0;
 	
 	if (aa == bb) return(SV_PLUS); // Well, that bit was easy...
+	if (identical(aa, bb)) return(SV_PLUS); // So's that, if the hashes differ
 	
 	sv_primitive a = aa.dump_scales();
 	sv_primitive b = bb.dump_scales();
@@ -1248,6 +1454,170 @@ prim_op same(const sv_primitive& aa, const sv_primitive& bb)
 		return(SV_PLUS);	
 }
 
+// Structural hashing.  A real is hashed by its bit pattern, after
+// adding 0 so that -0 and 0 hash the same.
+
+unsigned long sv_hash_real(unsigned long h, sv_real r)
+{
+	union { sv_real f; unsigned char c[sizeof(sv_real)]; } u;
+
+	u.f = r + (sv_real)0.0;
+	for(int i = 0; i < (int)sizeof(sv_real); i++) h = sv_hash(h, (unsigned long)u.c[i]);
+	return(h);
+}
+
+unsigned long sv_hash_plane(unsigned long h, const sv_plane& f)
+{
+	h = sv_hash_real(h, f.normal.x);
+	h = sv_hash_real(h, f.normal.y);
+	h = sv_hash_real(h, f.normal.z);
+	return(sv_hash_real(h, f.d));
+}
+
+// The hash of a node depends on its kind, its operator, its real or
+// plane, and its children's hashes.  The children of + and * are
+// combined in hash order, as a + b and b + a are identical.
+
+void sv_primitive::prim_data::rehash()
+{
+	unsigned long h = sv_hash((unsigned long)kind, (unsigned long)op);
+	unsigned long h1, h2, ht;
+
+	if(kind == SV_REAL) h = sv_hash_real(h, r);
+	if(kind == SV_PLANE) h = sv_hash_plane(h, flat);
+	if(child_2.exists())
+	{
+		h1 = child_1->hash;
+		h2 = child_2->hash;
+		if(((op == SV_PLUS) || (op == SV_TIMES)) && (h2 < h1))
+		{
+			ht = h1;
+			h1 = h2;
+			h2 = ht;
+		}
+		h = sv_hash(sv_hash(h, h1), h2);
+	} else if(child_1.exists())
+		h = sv_hash(h, child_1->hash);
+	hash = h;
+}
+
+// Are two nodes built in exactly the same way?
+
+int sv_primitive::identical_r(const prim_data* a, const prim_data* b)
+{
+	int result;
+
+	if (a == b) return(1);
+	if (!a || !b) return(0);
+	if (a->hash != b->hash) return(0);
+	if ((a->kind != b->kind) || (a->op != b->op)) return(0);
+	if (a->kind == SV_REAL)
+		if (a->r != b->r) return(0);
+	if (a->kind == SV_PLANE)
+	{
+		if ((a->flat.normal.x != b->flat.normal.x) || 
+		    (a->flat.normal.y != b->flat.normal.y) ||
+		    (a->flat.normal.z != b->flat.normal.z) ||
+		    (a->flat.d != b->flat.d)) return(0);
+	}
+	result = identical_r(a->child_1.operator->(), b->child_1.operator->()) &&
+		identical_r(a->child_2.operator->(), b->child_2.operator->());
+	if (!result && ((a->op == SV_PLUS) || (a->op == SV_TIMES)) && a->child_2.exists())
+		result = identical_r(a->child_1.operator->(), b->child_2.operator->()) &&
+			identical_r(a->child_2.operator->(), b->child_1.operator->());
+	return(result);
+}
+
+int identical(const sv_primitive& a, const sv_primitive& b)
+{
+	return(sv_primitive::identical_r(a.prim_info.operator->(), b.prim_info.operator->()));
+}
+
+// Hash-consing
+
+static sv_integer hash_cons = 0;
+
+void hash_consing(sv_integer f) { hash_cons = f; }
+sv_integer hash_consing() { return(hash_cons); }
+
+// Are two reals the same bit for bit?
+
+static int same_bits(sv_real a, sv_real b)
+{
+	union { sv_real f; unsigned char c[sizeof(sv_real)]; } ua, ub;
+
+	ua.f = a;
+	ub.f = b;
+	for(int i = 0; i < (int)sizeof(sv_real); i++)
+		if(ua.c[i] != ub.c[i]) return(0);
+	return(1);
+}
+
+// Two primitives may be shared if everything about them is the
+// same, and their children are already shared.  This is stricter
+// than identical(): a + b and b + a aren't shared (they evaluate in a
+// different order) and neither are ones with different flags.
+
+static int intern_match(const sv_primitive& a, const sv_primitive& b)
+{
+	sv_plane fa, fb;
+
+	if ((a.kind() != b.kind()) || (a.op() != b.op())) return(0);
+	if ((a.flags() & ~WRIT_BIT) != (b.flags() & ~WRIT_BIT)) return(0);
+	if (a.kind() == SV_REAL)
+		if (!same_bits(a.real(), b.real())) return(0);
+	if (a.kind() == SV_PLANE)
+	{
+		fa = a.plane();
+		fb = b.plane();
+		if (!same_bits(fa.normal.x, fb.normal.x) || 
+		    !same_bits(fa.normal.y, fb.normal.y) ||
+		    !same_bits(fa.normal.z, fb.normal.z) ||
+		    !same_bits(fa.d, fb.d)) return(0);
+	}
+	return((a.child_1() == b.child_1()) && (a.child_2() == b.child_2()));
+}
+
+sv_intern_table<sv_primitive> p_intern_table;
+
+// Return the shared copy of a primitive.  Its children are interned
+// first, so if an identical tree is already in the table the whole
+// thing comes back as one pointer.  If the children changed, a new
+// node is made over the shared children that is the same as this one
+// in every other way.
+
+sv_primitive sv_primitive::intern() const
+{
+	if (!exists()) return(*this);
+	if (sv_atomic_get(&(prim_info->interned))) return(*this);
+
+	sv_primitive result = *this;
+	sv_primitive c_1, c_2;
+
+	if (prim_info->child_1.exists())
+	{
+		c_1 = child_1().intern();
+		if (prim_info->child_2.exists()) c_2 = child_2().intern();
+		if ((c_1 != child_1()) || (c_2 != child_2()))
+		{
+			if (c_2.exists())
+				result = sv_primitive(c_1, c_2, op());
+			else
+				result = sv_primitive(c_1, op());
+			result.prim_info->kind = kind();
+			if (kind() == SV_REAL) result.prim_info->r = real();
+			if (kind() == SV_PLANE) result.prim_info->flat = plane();
+			result.prim_info->rehash();
+			result.set_flags_priv(flags() & ~WRIT_BIT);
+			if (grads()) result.prim_info->grads = new sv_prim_grads(*grads());
+		}
+	}
+
+	result = p_intern_table.find_or_add(result);
+	sv_atomic_or(&(result.prim_info->interned), 1);
+	return(result);
+}
+
 /*
  * The 5 arithmetic operations
  *
@@ -1398,6 +1768,29 @@ sv_primitive operator^(const sv_primitive& a, const sv_primitive& b)
 }
 
 
+// A new top node sharing the children.  Reals, planes and user
+// primitives are cheap to look at anyway, so they are left as they are.
+
+sv_primitive sv_primitive::copy_top() const
+{
+	sv_primitive c;
+	sv_prim_grads* g = grads();
+
+	if(prim_info->interned || (op() == SV_ZERO)) return(*this);
+
+	if(diadic(op()))
+		c.prim_info = new prim_data(child_1(), child_2(), op());
+	else
+		c.prim_info = new prim_data(child_1(), op());
+	c.prim_info->flat = prim_info->flat;	// Complemented planes keep theirs
+	c.prim_info->r = prim_info->r;
+	c.prim_info->degree = degree();
+	c.prim_info->set_flags(flags());
+	if(g) c.prim_info->grads = new sv_prim_grads(g->x, g->y, g->z);
+	c.set_kind(kind());
+	return(c);
+}
+
 // Deep copy
 
 sv_primitive sv_primitive::deep() const
@@ -1996,6 +2389,7 @@ sv_real sv_primitive::value(const sv_point& q) const
 {
 	sv_real c;
 	sv_integer k;
+	const sv_prim_tape* t;
 
 	switch(k = kind())
 	{
@@ -2016,6 +2410,11 @@ sv_real sv_primitive::value(const sv_point& q) const
 	case SV_TORUS:
 	case SV_CYCLIDE:
 	case SV_GENERAL:
+		if((t = tape()))	// Compiled?
+		{
+			c = t->value(q);
+			break;
+		}
 		switch(op())
 		{
 		case SV_PLUS:
@@ -2082,13 +2481,85 @@ sv_real sv_primitive::value(const sv_point& q) const
 	return(c);
 }
 
+// Values of a batch of points in a primitive.  Anything that compiles 
+// to a tape is done in vector blocks; the rest falls back to one point
+// at a time.
+
+void sv_primitive::value(const sv_real* x, const sv_real* y, const sv_real* z, 
+	sv_real* v, sv_integer n) const
+{
+	sv_integer i;
+	const sv_prim_tape* t;
+
+	switch(kind())
+	{
+	case SV_REAL:
+		for(i = 0; i < n; i++) v[i] = real();
+		return;
+
+	case SV_PLANE:
+		if(op() == SV_ZERO)
+		{
+			sv_plane_value(plane(), x, y, z, v, n);
+			return;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	if((t = tape()))
+		t->value(x, y, z, v, n);
+	else
+		for(i = 0; i < n; i++) v[i] = value(sv_point(x[i], y[i], z[i]));
+}
+
 // Value of a box in a primitive
 
-sv_interval sv_primitive::range(const sv_box& b) const
+// The range methods to use
+
+static sv_integer range_m = SV_RANGE_INTERVAL;
+
+void set_range_mode(sv_integer m) { range_m = m; }
+sv_integer get_range_mode() { return(range_m); }
+
+// Narrow c to its overlap with r.  If rounding means they don't 
+// overlap, c is left alone.
+
+static void range_meet(sv_interval* c, const sv_interval& r)
+{
+	sv_real l, h;
+
+	if (r.empty()) return;
+	l = max(c->lo(), r.lo());
+	h = min(c->hi(), r.hi());
+	if (l <= h) *c = sv_interval(l, h);
+}
+
+// Tighten the plain interval range of a tape over a box by the other
+// methods in mode
+
+static sv_interval range_tighten(const sv_prim_tape* t, const sv_box& b, 
+	sv_interval c, sv_integer mode)
+{
+	sv_interval r;
+
+	if (c.empty()) return(c);
+	if (mode & SV_RANGE_AFFINE) range_meet(&c, t->affine(b));
+	if (mode & SV_RANGE_CENTRED)
+		if (t->centred(b, &r)) range_meet(&c, r);
+	if (mode & SV_RANGE_BERNSTEIN)
+		if (t->bernstein(b, &r)) range_meet(&c, r);
+	return(c);
+}
+
+sv_interval sv_primitive::range(const sv_box& b, sv_integer mode) const
 {
 	sv_interval c;
 	sv_integer k;
 	int c_1, c_2;			// Logical - T if child is a real
+	const sv_prim_tape* t;
 
 	switch(k = kind())
 	{
@@ -2118,6 +2589,12 @@ sv_interval sv_primitive::range(const sv_box& b) const
 	case SV_TORUS:
 	case SV_CYCLIDE:
 	case SV_GENERAL:
+		if((t = tape()))	// Compiled?
+		{
+			c = t->range(b);
+			if (mode) c = range_tighten(t, b, c, mode);
+			break;
+		}
 		if (diadic(op()))
 		{
 			c_1 = (child_1().kind() == SV_REAL);
@@ -2138,13 +2615,13 @@ sv_interval sv_primitive::range(const sv_box& b) const
 							child_1().real() + child_2().real() );
 				}	
 				else
-					c = child_1().real() + child_2().range(b);
+					c = child_1().real() + child_2().range(b, mode);
 			} else
 			{
 				if (c_2)
-					c = child_1().range(b) + child_2().real();
+					c = child_1().range(b, mode) + child_2().real();
 				else
-					c = child_1().range(b) + child_2().range(b);
+					c = child_1().range(b, mode) + child_2().range(b, mode);
 			}
 			break;
 
@@ -2159,13 +2636,13 @@ sv_interval sv_primitive::range(const sv_box& b) const
 							child_1().real() - child_2().real() );
 				}	
 				else
-					c = child_1().real() - child_2().range(b);
+					c = child_1().real() - child_2().range(b, mode);
 			} else
 			{
 				if (c_2)
-					c = child_1().range(b) - child_2().real();
+					c = child_1().range(b, mode) - child_2().real();
 				else
-					c = child_1().range(b) - child_2().range(b);
+					c = child_1().range(b, mode) - child_2().range(b, mode);
 			}
 			break;
 
@@ -2180,13 +2657,13 @@ sv_interval sv_primitive::range(const sv_box& b) const
 							child_1().real()*child_2().real() );
 				}	
 				else
-					c = child_1().real()*child_2().range(b);
+					c = child_1().real()*child_2().range(b, mode);
 			} else
 			{
 				if (c_2)
-					c = child_1().range(b)*child_2().real();
+					c = child_1().range(b, mode)*child_2().real();
 				else
-					c = child_1().range(b)*child_2().range(b);
+					c = child_1().range(b, mode)*child_2().range(b, mode);
 			}
 			break;
 
@@ -2204,7 +2681,7 @@ sv_interval sv_primitive::range(const sv_box& b) const
 							child_1().real()/child_2().real() );
 				}
 				else
-					c = child_1().range(b)/child_2().real();
+					c = child_1().range(b, mode)/child_2().real();
 			}
 			break;
 
@@ -2222,36 +2699,36 @@ sv_interval sv_primitive::range(const sv_box& b) const
 							pow(child_1().real(),round(child_2().real())) );						
 				}
 				else
-					c = pow( child_1().range(b), round( child_2().real() ) );
+					c = pow( child_1().range(b, mode), round( child_2().real() ) );
 			}
 			break;
 
 		case SV_COMP:
-			c = -(child_1().range(b));
+			c = -(child_1().range(b, mode));
 			break;
 
 		case SV_ABS:
-			c = abs(child_1().range(b));
+			c = abs(child_1().range(b, mode));
 			break;
 
 		case SV_SIN:
-			c = sin(child_1().range(b));
+			c = sin(child_1().range(b, mode));
 			break;
 
 		case SV_COS:
-			c = cos(child_1().range(b));
+			c = cos(child_1().range(b, mode));
 			break;
 
 		case SV_EXP:
-			c = exp(child_1().range(b));
+			c = exp(child_1().range(b, mode));
 			break;
 
 		case SV_SSQRT:
-			c = s_sqrt(child_1().range(b));
+			c = s_sqrt(child_1().range(b, mode));
 			break;
 
 		case SV_SIGN:
-			c = sign(child_1().range(b));
+			c = sign(child_1().range(b, mode));
 			break;
 
 		default:
@@ -2270,6 +2747,96 @@ sv_interval sv_primitive::range(const sv_box& b) const
 	return(c);
 }
 
+// Memos of primitive ranges in a box (see prim.h)
+
+sv_range_memo::sv_range_memo(const sv_box& bx)
+{
+	b = bx;
+	mode = get_range_mode();
+	size = SV_RANGE_MEMO;
+	used = 0;
+	key = key_s;
+	val = val_s;
+	for(sv_integer i = 0; i < size; i++) key[i] = 0;
+}
+
+// Where a primitive is, or should go, in a table of length s.
+// Pointers are aligned, so the low bits are thrown away.
+
+static inline sv_integer memo_slot(const long* k, sv_integer s, long p)
+{
+	unsigned long h = (unsigned long)p;
+	sv_integer i = (sv_integer)((h >> 4) ^ (h >> 11)) & (s - 1);
+
+	while(k[i] && (k[i] != p)) i = (i + 1) & (s - 1);
+	return(i);
+}
+
+// Double the table, moving it to the heap
+
+void sv_range_memo::grow()
+{
+	sv_integer i, j, s = 2*size;
+	long* k = new long[s];
+	sv_interval* v = new sv_interval[s];
+
+	for(i = 0; i < s; i++) k[i] = 0;
+	for(i = 0; i < size; i++)
+	{
+		if(!key[i]) continue;
+		j = memo_slot(k, s, key[i]);
+		k[j] = key[i];
+		v[j] = val[i];
+	}
+	if(key != key_s)
+	{
+		delete [] key;
+		delete [] val;
+	}
+	key = k;
+	val = v;
+	size = s;
+}
+
+sv_interval sv_range_memo::range(const sv_primitive& p)
+{
+	if(p.op() == SV_COMP) return(-range(p.child_1()));
+
+	long u = p.unique();
+	sv_integer i = memo_slot(key, size, u);
+
+	if(!key[i])
+	{
+		val[i] = p.range(b, mode);
+		key[i] = u;
+		if(4*(++used) > 3*size)
+		{
+			grow();
+			i = memo_slot(key, size, u);
+		}
+	}
+	return(val[i]);
+}
+
+// Ranges of a batch of boxes in a primitive, vectorized like the batch
+// point values
+
+void sv_primitive::range(const sv_box* b, sv_interval* v, sv_integer n) const
+{
+	sv_integer i, mode;
+	const sv_prim_tape* t;
+
+	if((kind() == SV_PLANE) && (op() == SV_ZERO))
+		sv_plane_range(plane(), b, v, n);
+	else if((t = tape()))
+	{
+		t->range(b, v, n);
+		if ((mode = get_range_mode()))
+			for(i = 0; i < n; i++) v[i] = range_tighten(t, b[i], v[i], mode);
+	} else
+		for(i = 0; i < n; i++) v[i] = range(b[i]);
+}
+
 
 
 // This is probably balls and needs to go.
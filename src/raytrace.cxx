@@ -446,6 +446,102 @@ ray_model_test(const sv_model& mod,		// model to fire ray into
 
 
 
+//
+// The same for a flat model, starting at node n.  This always works from
+// the faces along the division, as ray_model_test does with USE_LINE_BOX 
+// off; a ray parallel to the division goes into whichever children it's 
+// inside over the whole of valid_model_interval.
+//
+
+sv_set
+sv_flat_model::ray_test(sv_integer n,			// node to start at
+	       const sv_line& ray,			// ray to fire
+	       const sv_real& rootfinding_tmax,	// the max t value to find roots for
+	       const sv_interval& valid_model_interval, // the limits within which the model is valid
+	       // Returns
+	       sv_real*	hit_ray_param) const		// parametric value at intersection
+{
+   const sv_flat_node* fn = &(flat_info->node[n]);
+   sv_integer c = fn->link >> 2;
+   sv_real o, d;
+   sv_interval child_1_valid_int;
+   sv_interval child_2_valid_int;
+   sv_set hit_surface;
+
+   switch(fn->link & 3) {
+    case LEAF_M:
+      return ray_leaf_node_test(flat_info->list[c], ray, rootfinding_tmax, valid_model_interval, hit_ray_param);
+
+    case X_DIV:
+      o = ray.origin.x;
+      d = ray.direction.x;
+      break;
+
+    case Y_DIV:
+      o = ray.origin.y;
+      d = ray.direction.y;
+      break;
+
+    default:
+      o = ray.origin.z;
+      d = ray.direction.z;
+      break;
+   }
+
+   if(d > 0.0) {
+      child_1_valid_int = sv_interval(valid_model_interval.lo(),
+	    min(valid_model_interval.hi(), (fn->hi_1 - o)/d));
+      child_2_valid_int = sv_interval(max(valid_model_interval.lo(), (fn->lo_2 - o)/d),
+	    valid_model_interval.hi());
+   } else if(d < 0.0) {
+      child_1_valid_int = sv_interval(max(valid_model_interval.lo(), (fn->hi_1 - o)/d),
+	    valid_model_interval.hi());
+      child_2_valid_int = sv_interval(valid_model_interval.lo(),
+	    min(valid_model_interval.hi(), (fn->lo_2 - o)/d));
+   } else {
+      if(o <= fn->hi_1) child_1_valid_int = valid_model_interval;
+      if(o >= fn->lo_2) child_2_valid_int = valid_model_interval;
+   }
+
+   if(child_1_valid_int.empty() && child_2_valid_int.empty())
+      return hit_surface;	// empty set!
+
+   if(child_1_valid_int.empty())
+      return ray_test(c + 1, ray, rootfinding_tmax, child_2_valid_int, hit_ray_param);
+
+   if(child_2_valid_int.empty())
+      return ray_test(c, ray, rootfinding_tmax, child_1_valid_int, hit_ray_param);
+
+   if(child_1_valid_int.lo() < child_2_valid_int.lo()) {
+      hit_surface = ray_test(c, ray, rootfinding_tmax, child_1_valid_int, hit_ray_param);
+      if(hit_surface.exists())
+	 return hit_surface;
+      return ray_test(c + 1, ray, rootfinding_tmax, child_2_valid_int, hit_ray_param);
+   }
+
+   hit_surface = ray_test(c + 1, ray, rootfinding_tmax, child_2_valid_int, hit_ray_param);
+   if(hit_surface.exists())
+      return hit_surface;
+   return ray_test(c, ray, rootfinding_tmax, child_1_valid_int, hit_ray_param);
+}
+
+//
+// Fire a ray into a flat model and report what it hits
+//
+
+sv_set
+sv_flat_model::fire_ray(
+	 const sv_line& ray,			// ray to fire
+	 const sv_interval& ray_param_interval,		// parameter range that is of interest
+	 /* Returns */
+	 sv_real*	hit_ray_param) const			// parametric value at intersection
+{
+   current_ray_number++;
+   return ray_test(0, ray, ray_param_interval.hi(), ray_param_interval, hit_ray_param);
+}
+
+
+
 //
 // Generate intersections between ray and primitive (within given ray interval)
 //
@@ -561,6 +657,12 @@ ray_set_intersection_test(const sv_set& set_to_test,
 	rootfinding_tmax);
 
     default:
+
+      // No solid along the ray if it misses the set's bounding box
+
+      if(set_to_test.misses(ray, rootfinding_tmin, rootfinding_tmax))
+	 return sorted_interval_list();
+
       switch(set_to_test.op()) {
        case SV_UNION:
 #if DEBUG
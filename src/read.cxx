@@ -252,6 +252,7 @@ void read(istream& s, sv_primitive& p)
 			}
 
 			result.set_flags_priv(fl);
+			if (hash_consing()) result = result.intern();
 
 			p_write_list.add(result, p_ptr);
 		}
@@ -342,6 +343,12 @@ void read(istream& s, sv_set& sr)
 				c_1.set_info->set_complement(result);
 			}
 
+// Sets that were complemented when they were written keep
+// their own nodes, as the pair must point at each other
+
+			if (hash_consing() && !result.complement().exists())
+				result = result.intern();
+
 			s_write_list.add(result, s_ptr);
 		}
 		check_token(s, SVT_CB_S);
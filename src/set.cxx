@@ -64,6 +64,7 @@
 #include "interval.h"
 #include "sv_b_cls.h"
 #include "prim.h"
+#include "tape.h"
 #include "attrib.h"
 #include "sv_set.h"
 #include "decision.h"
@@ -338,6 +339,7 @@ prim_op same(const sv_set& a, const sv_set& b)
 	int flip = 0;
 	
 	if (a == b) return(SV_PLUS);  // Simple things first...
+	if (identical(a, b)) return(SV_PLUS);
 
 	if(a.complement().exists())
 		if(a.complement() == b) return(SV_COMP); 
@@ -404,6 +406,153 @@ prim_op same(const sv_set& a, const sv_set& b)
 	return(SV_ZERO);
 }
 
+// The hash of a set node depends on its contents, its primitive if
+// it's a leaf, and on its operator and its children's hashes if not.
+// Union and intersection both commute, so the children are combined
+// in hash order.
+
+void sv_set::set_data::rehash()
+{
+	unsigned long h = sv_hash(0x5e7UL, (unsigned long)contents);
+	unsigned long h1, h2;
+
+	if (contents == 1)
+		h = sv_hash(h, prim.hash());
+	else if (contents > 1)
+	{
+		h1 = child_1->hash();
+		h2 = child_2->hash();
+		if (h2 < h1)
+		{
+			h = sv_hash(sv_hash(h, (unsigned long)op), h2);
+			h = sv_hash(h, h1);
+		} else
+		{
+			h = sv_hash(sv_hash(h, (unsigned long)op), h1);
+			h = sv_hash(h, h2);
+		}
+	}
+	hash = h;
+}
+
+// Is the geometry of two nodes built in exactly the same way?
+
+int sv_set::identical_r(const set_data* a, const set_data* b)
+{
+	const set_data* a1;
+	const set_data* a2;
+	const set_data* b1;
+	const set_data* b2;
+
+	if (a == b) return(1);
+	if (!a || !b) return(0);
+	if (a->hash != b->hash) return(0);
+	if (a->contents != b->contents) return(0);
+
+	switch(a->contents)
+	{
+	case SV_EVERYTHING:
+	case SV_NOTHING:
+		return(1);
+
+	case 1:
+		return(identical(a->prim, b->prim));
+
+	default:
+		if (a->op != b->op) return(0);
+		a1 = a->child_1->set_info.operator->();
+		a2 = a->child_2->set_info.operator->();
+		b1 = b->child_1->set_info.operator->();
+		b2 = b->child_2->set_info.operator->();
+		if (identical_r(a1, b1) && identical_r(a2, b2)) return(1);
+		return(identical_r(a1, b2) && identical_r(a2, b1));
+	}
+}
+
+int identical(const sv_set& a, const sv_set& b)
+{
+	return(sv_set::identical_r(a.set_info.operator->(), b.set_info.operator->()));
+}
+
+// Two sets may be shared if everything about them (including their
+// children's attributes) is the same, and their primitives and
+// children are already shared.
+
+static int intern_match(const sv_set& a, const sv_set& b)
+{
+	if (a.contents() != b.contents()) return(0);
+	if ((a.flags() & ~WRIT_BIT) != (b.flags() & ~WRIT_BIT)) return(0);
+	switch(a.contents())
+	{
+	case SV_EVERYTHING:
+	case SV_NOTHING:
+		return(1);
+
+	case 1:
+		return(a.primitive() == b.primitive());
+
+	default:
+		return((a.op() == b.op()) && (a.child_1() == b.child_1()) && 
+			(a.child_2() == b.child_2()));
+	}
+}
+
+sv_intern_table<sv_set> s_intern_table;
+
+// Return the shared copy of a set.  As with primitives, the children
+// (and primitive) are interned first; the table holds the geometry
+// without attributes.
+
+sv_set sv_set::intern() const
+{
+	if (!exists()) return(*this);
+	if (sv_atomic_get(&(set_info->interned))) return(*this);
+
+	sv_set result = *this;
+	sv_set c_1, c_2;
+	sv_primitive p;
+
+	switch(contents())
+	{
+	case SV_EVERYTHING:
+	case SV_NOTHING:
+		break;
+
+	case 1:
+		p = primitive().intern();
+		if (p != primitive())
+		{
+			result = sv_set(p);
+			result.set_flags_priv(flags() & ~WRIT_BIT);
+		}
+		break;
+
+	default:
+		c_1 = child_1().intern();
+		c_2 = child_2().intern();
+		if ((c_1 != child_1()) || (c_2 != child_2()))
+		{
+			result = sv_set(c_1, c_2, op());
+			result.set_flags_priv(flags() & ~WRIT_BIT);
+		}
+		break;
+	}
+
+	result.a = sv_attribute();
+	result = s_intern_table.find_or_add(result);
+	sv_atomic_or(&(result.set_info->interned), 1);
+	result.a = a;
+	return(result);
+}
+
+// Empty both hash-consing tables
+
+void clean_hash_cons()
+{
+	s_intern_table.clean();
+	p_intern_table.clean();
+}
+
 // Deep copy
 
 sv_set sv_set::deep() const
@@ -575,6 +724,33 @@ sv_set sv_set::mirror(const sv_plane& m) const
 	return(att_mirror(b, *this, m));
 }
 
+// Record that b is the complement of this (and vice versa) and return it.
+// If another thread has got in first, return what it found instead.
+// The two must always point at each other, so if b already has a
+// complement of its own no link is made.  No reference may be dropped
+// while the lock is shut, as that could need the lock too.
+
+sv_lock sv_complement_lock;
+
+sv_set sv_set::pair_complement(const sv_set& b) const
+{
+	sv_set result = b;
+	sv_set other;
+
+	sv_complement_lock.shut();
+	if (set_info->complement->exists())
+		other = *(set_info->complement);
+	else if (!b.set_info->complement->exists() && (b.set_info.unique() != set_info.unique()))
+	{
+		*(set_info->complement) = b;
+		*(b.set_info->complement) = *this;
+	}
+	sv_complement_lock.open();
+
+	if (other.exists()) result = other;
+	return(result);
+}
+
 // Complement a set.  If this has been done already, the result is
 // in a.complement(); if not it needs to be computed.
 
@@ -612,10 +788,7 @@ sv_set operator-(const sv_set& aa)
 // Remember the results so it doesn't have to be done again
 
 	b = att_complement(b, a);
-	a.complement(b);
-	b.complement(a);
-
-	return(b);
+	return(a.pair_complement(b));
 }
 
 // Set union
@@ -702,6 +875,7 @@ sv_set operator|(const sv_set& a, const sv_set& b)
 			break;
 		}
 	}
+	if (hash_consing()) c = c.intern();
 	return(att_union(c, a, b));
 }
 
@@ -790,6 +964,7 @@ sv_set operator&(const sv_set& a, const sv_set& b)
 	}
 
 	if( (a.flags() & SV_CV_POL) && (b.flags() & SV_CV_POL) ) c.set_flags_priv(SV_CV_POL);
+	if (hash_consing()) c = c.intern();
 
 	return(att_intersection(c, a, b));
 }
@@ -984,218 +1159,1381 @@ sv_set sv_set::regularize() const
 		break;
 	}
 
-	return(*this);	
+	return(*this);
 }
 
-// This membership-tests a point against a set
-// When points are on surfaces, the result is regularized.
-// If the point is known to lie on the surfaces of some primitives,
-// they should be listed in known_surface[]; the list is terminated
-// with an undefined primitive.  If no such primitives exist, just
-// send a pointer to an undefined primitive for the third argument.
+// Set tree optimisation.  Sets built a primitive at a time in a loop are
+// long chains; optimise() flattens each run of unions or intersections
+// into one n-ary list of operands, puts the cheapest operands first so
+// membership tests can stop early as soon as possible, and builds a
+// balanced tree from them.  Operands that cost the same are grouped by
+// where their bounding boxes are, so the subtrees have small boxes that
+// pruning and membership tests can reject quickly.
 
-mem_test sv_set::member(const sv_point& p, sv_primitive known_surface[]) const
+struct sv_opt_key
 {
-	mem_test result_1 = SV_AIR;
-	mem_test result_2 = SV_AIR;
-	sv_integer i = 0;
-	sv_real work;
+	sv_integer cost;	// Rough cost of classifying against an operand
+	sv_integer order;	// Where it was in the original
+};
 
-	switch (contents())
-	{
-	case SV_EVERYTHING:
-		return(SV_SOLID);
+struct sv_opt_list
+{
+	sv_set* s;		// The operands, optimised
+	sv_opt_key* k;
+	sv_integer n, size;
 
-	case SV_NOTHING:
-		return(SV_AIR);
+	sv_opt_list() { s = 0; k = 0; n = 0; size = 0; }
+	~sv_opt_list() { delete [] s; delete [] k; }
+	void add(const sv_set& a, sv_integer c)
+	{
+		sv_integer i;
 
-	case 1:
-		while(known_surface[i].exists())
-			if (primitive() == known_surface[i++]) return(SV_SURFACE);
-//		result_1 = member(primitive().value(p));
-// That won't go with Microsoft Visual C++, so time for a workround...
-		work = primitive().value(p);
-		if (work > 0)
-			result_1 = SV_AIR;
-		else
+		if(n >= size)
 		{
-			if (work < 0) 
-				result_1 = SV_SOLID;
-			else
-				result_1 = SV_SURFACE;
+			size = size ? 2*size : 16;
+			sv_set* s2 = new sv_set[size];
+			sv_opt_key* k2 = new sv_opt_key[size];
+			for(i = 0; i < n; i++)
+			{
+				s2[i] = s[i];
+				k2[i] = k[i];
+			}
+			delete [] s;
+			delete [] k;
+			s = s2;
+			k = k2;
 		}
-		return(result_1);
-	
-	default:
+		s[n] = a;
+		k[n].cost = c;
+		k[n].order = n;
+		n++;
+	}
+};
 
-// child_1 should have a lower complexity than child_2
+static sv_set optimise_r(const sv_set&, sv_integer*);
 
-		result_1 = child_1().member(p,known_surface);
+// Gather the operands of a run of op; nodes with attributes of their
+// own aren't looked through, as the attribute would be lost
 
-		if (op() == SV_UNION)
-		{
-			if (result_1 == SV_SOLID) return(SV_SOLID);
-			result_2 = child_2().member(p,known_surface);
-			if (result_2 == SV_SOLID) return(SV_SOLID);
-			if ((result_1 == SV_SURFACE)||(result_2 == SV_SURFACE))
-				return(SV_SURFACE);
-			else
-				return(SV_AIR);
-		} else
-		{
-			if (result_1 == SV_AIR) return(SV_AIR);
-			result_2 = child_2().member(p,known_surface);
-			if (result_2 == SV_AIR) return(SV_AIR);
-			if ((result_1 == SV_SURFACE)||(result_2 == SV_SURFACE))
-				return(SV_SURFACE);
-			else
-				return(SV_SOLID);
-		}
-		break;
+static void optimise_gather(const sv_set& s, set_op o, sv_opt_list* l)
+{
+	sv_integer c;
+	sv_set t;
+
+	if((s.contents() > 1) && (s.op() == o) && !s.has_attribute())
+	{
+		optimise_gather(s.child_1(), o, l);
+		optimise_gather(s.child_2(), o, l);
+		return;
 	}
+	t = optimise_r(s, &c);
+	l->add(t, c);
+}
 
-// Should never get to here.
+// Cheapest first; otherwise keep the original order
 
-	svlis_error("sv_set::member(sv_point...)","returning AIR",SV_CORRUPT);
+static int optimise_cmp(const void* a, const void* b)
+{
+	const sv_opt_key* p = (const sv_opt_key*)a;
+	const sv_opt_key* q = (const sv_opt_key*)b;
 
-	return(result_1);   
+	if(p->cost != q->cost) return((p->cost < q->cost) ? -1 : 1);
+	if(p->order != q->order) return((p->order < q->order) ? -1 : 1);
+	return(0);
 }
 
-// Value for a point (and winning leaf)
+// Order by position along an axis
 
-sv_real sv_set::value(const sv_point& p, sv_set* winner) const
+struct sv_opt_place
 {
-	sv_real result;
-	sv_real result_2;
-	sv_set w_2;
+	sv_real x;
+	sv_integer order;
+};
 
-	switch (contents())
+static int optimise_place_cmp(const void* a, const void* b)
+{
+	const sv_opt_place* p = (const sv_opt_place*)a;
+	const sv_opt_place* q = (const sv_opt_place*)b;
+
+	if(p->x != q->x) return((p->x < q->x) ? -1 : 1);
+	if(p->order != q->order) return((p->order < q->order) ? -1 : 1);
+	return(0);
+}
+
+// Sort sets s[0..n-1] along the axis their boxes' centres are most
+// spread out on
+
+static void optimise_space(sv_set* s, sv_integer n)
+{
+	sv_opt_place* pl = new sv_opt_place[n];
+	sv_point* c = new sv_point[n];
+	sv_set* t = new sv_set[n];
+	sv_point lo, hi;
+	sv_integer i, k;
+	sv_box b;
+
+	for(i = 0; i < n; i++)
 	{
-	case SV_EVERYTHING:
-		*winner = *this;
-		return(-1.0);
+		b = s[i].bound();
+		c[i] = b.empty() ? SV_OO : b.centroid();
+		if(!i) lo = hi = c[i];
+		lo = sv_point(min(lo.x, c[i].x), min(lo.y, c[i].y), min(lo.z, c[i].z));
+		hi = sv_point(max(hi.x, c[i].x), max(hi.y, c[i].y), max(hi.z, c[i].z));
+	}
+	hi = hi - lo;
+	k = (hi.x >= hi.y) ? ((hi.x >= hi.z) ? 0 : 2) : ((hi.y >= hi.z) ? 1 : 2);
+	for(i = 0; i < n; i++)
+	{
+		pl[i].x = (k == 0) ? c[i].x : ((k == 1) ? c[i].y : c[i].z);
+		pl[i].order = i;
+	}
+	qsort(pl, n, sizeof(sv_opt_place), optimise_place_cmp);
+	for(i = 0; i < n; i++) t[i] = s[pl[i].order];
+	for(i = 0; i < n; i++) s[i] = t[i];
+	delete [] t;
+	delete [] c;
+	delete [] pl;
+}
 
-	case SV_NOTHING:
-		*winner = *this;
-		return(1.0);
+// Balanced tree from operands s[0..n-1], whose costs are c[0..n-1]
 
-	case 1:
-		*winner = *this;
-		return(primitive().value(p));
-	
-	default:
+static sv_set optimise_build(sv_set* s, const sv_integer* c, sv_integer n, set_op op)
+{
+	if(n == 1) return(s[0]);
 
-		result = child_1().value(p, winner);
-		result_2 = child_2().value(p, &w_2);
+	if((n > 2) && (c[0] == c[n - 1])) optimise_space(s, n);
 
-		if (op() == SV_UNION)	// == minimum
-		{
-			if (result > result_2)
-			{
-				*winner = w_2;
-				result = result_2;
-			}
-		} else
-		{	// INTERSECTION == maximum
-			if (result < result_2)
-			{
-				*winner = w_2;
-				result = result_2;
-			}
-		}
-		if ( has_attribute() && ( !(winner->has_attribute()) ) )
-			*winner = winner->attribute(attribute());
-		return(result);
-	}
+	sv_integer m = n/2;
+	sv_set a = optimise_build(s, c, m, op);
+	sv_set b = optimise_build(&s[m], &c[m], n - m, op);
+
+	if(op == SV_UNION) return(a | b);
+	return(a & b);
 }
 
-// Range for a box (and winning leaves)
+// Optimise s, returning its cost in c.  A primitive's cost is its
+// degree (so planes come before quadrics and quadrics before tori),
+// and a compound set costs what its primitives cost added up.
 
-sv_interval sv_set::range(const sv_box& b, sv_set* w_lo, sv_set* w_hi) const
+static sv_set optimise_r(const sv_set& s, sv_integer* c)
 {
-	sv_interval result_2;
-	sv_interval result;
-	sv_set w_2_lo, w_2_hi;
+	sv_opt_list l;
+	sv_integer i;
+	sv_integer* oc;
+	sv_set* o;
+	sv_set r;
 
-	switch (contents())
+	switch(s.contents())
 	{
 	case SV_EVERYTHING:
-		*w_lo = *this;
-		*w_hi = *this;
-		return(sv_interval(-2.0,-1.0)); // By convention (what does this do to the min/max?)
-
 	case SV_NOTHING:
-		*w_lo = *this;
-		*w_hi = *this;
-		return(sv_interval(1.0,2.0));
+		*c = 0;
+		return(s);
 
 	case 1:
-		*w_lo = *this;
-		*w_hi = *this;
-		return(primitive().range(b));
-	
-	default:
+		*c = max((sv_integer)1, s.primitive().degree());
+		return(s);
 
-		result = child_1().range(b, w_lo, w_hi);
-		result_2 = child_2().range(b ,&w_2_lo, &w_2_hi);
+	default:
+		break;
+	}
 
-		if (op() == SV_UNION)	// U == minimum
-		{
-			if (result_2.lo() < result.lo())
-			{
-				*w_lo = w_2_lo;
-				result = sv_interval(result_2.lo(), result.hi());
-			}
-			if (result_2.hi() < result.hi())
-			{
-				*w_hi = w_2_hi;
-				result = sv_interval(result.lo(), result_2.hi());
-			}
-		} else
-		{	// INTERSECTION == maximum
-			if (result_2.lo() > result.lo())
-			{
-				*w_lo = w_2_lo;
-				result = sv_interval(result_2.lo(), result.hi());
-			}
-			if (result_2.hi() > result.hi())
-			{
-				*w_hi = w_2_hi;
-				result = sv_interval(result.lo(), result_2.hi());
-			}
-		}
-		if (has_attribute() && ( !w_lo->has_attribute() ))
-			*w_lo = w_lo->attribute(attribute());
-		if (has_attribute() && ( !w_hi->has_attribute() ))
-			*w_hi = w_hi->attribute(attribute());
-		return(result);
+	optimise_gather(s.child_1(), s.op(), &l);
+	optimise_gather(s.child_2(), s.op(), &l);
+	qsort(l.k, l.n, sizeof(sv_opt_key), optimise_cmp);
+	o = new sv_set[l.n];
+	oc = new sv_integer[l.n];
+	*c = 0;
+	for(i = 0; i < l.n; i++)
+	{
+		o[i] = l.s[l.k[i].order];
+		oc[i] = l.k[i].cost;
+		*c = *c + oc[i];
 	}
+	r = optimise_build(o, oc, l.n, s.op());
+	delete [] oc;
+	delete [] o;
+	if(s.has_attribute()) r = r.attribute(s.attribute());
+	return(r);
 }
 
-// Flag for whether the results of pruning are
-// regularized
-
-static sv_integer reg_prune = 0;
+// The balanced tree visits its primitives in a different order from the
+// one they were made in, so they would be all over memory for anything
+// that walks the whole tree (like value()).  So the leaves and the top
+// nodes of their primitives are made again in the order they are walked.
+// A primitive that comes more than once is only copied once; the copies
+// are found by the originals' unique().
 
-void regular_prune(sv_integer p) { reg_prune = p; }
+struct sv_opt_copies
+{
+	long* key;
+	sv_primitive* p;
+	sv_integer size, n;
 
-// This prunes a set to a box
+	sv_opt_copies()
+	{
+		size = 64;
+		n = 0;
+		key = new long[size];
+		p = new sv_primitive[size];
+		for(sv_integer i = 0; i < size; i++) key[i] = 0;
+	}
+	~sv_opt_copies() { delete [] key; delete [] p; }
 
-sv_set sv_set::prune(const sv_box& b) const
-{
-	sv_set pruned, temp;
-	mem_test m = SV_AIR;
-	int c_1_same;
+// Where key k is, or the empty slot it would go in
 
-	switch (contents())
+	sv_integer slot(long k) const
 	{
-        case SV_EVERYTHING:
+		sv_integer i = (sv_integer)((unsigned long)k*2654435761UL) & (size - 1);
+
+		while(key[i] && (key[i] != k)) i = (i + 1) & (size - 1);
+		return(i);
+	}
+
+// The copy of primitive a, made if it's not there yet; the table doubles
+// when it's half full
+
+	sv_primitive copy(const sv_primitive& a)
+	{
+		long* k2;
+		sv_primitive* p2;
+		sv_integer i, j, s2;
+
+		i = slot(a.unique());
+		if(key[i]) return(p[i]);
+
+		if(2*(n + 1) > size)
+		{
+			k2 = key;
+			p2 = p;
+			s2 = size;
+			size = 2*size;
+			key = new long[size];
+			p = new sv_primitive[size];
+			for(j = 0; j < size; j++) key[j] = 0;
+			for(j = 0; j < s2; j++)
+			{
+				if(!k2[j]) continue;
+				i = slot(k2[j]);
+				key[i] = k2[j];
+				p[i] = p2[j];
+			}
+			delete [] k2;
+			delete [] p2;
+			i = slot(a.unique());
+		}
+		key[i] = a.unique();
+		p[i] = a.copy_top();
+		n++;
+		return(p[i]);
+	}
+};
+
+static sv_set optimise_lay(const sv_set& s, sv_opt_copies* t)
+{
+	sv_set r;
+
+	switch(s.contents())
+	{
+	case SV_EVERYTHING:
+	case SV_NOTHING:
+		return(s);
+
+	case 1:
+		r = sv_set(t->copy(s.primitive()));
+		break;
+
+	default:
+		if(s.op() == SV_UNION)
+			r = optimise_lay(s.child_1(), t) | optimise_lay(s.child_2(), t);
+		else
+			r = optimise_lay(s.child_1(), t) & optimise_lay(s.child_2(), t);
+		break;
+	}
+	if(s.has_attribute()) r = r.attribute(s.attribute());
+	return(r);
+}
+
+sv_set sv_set::optimise() const
+{
+	sv_opt_copies t;
+	sv_integer c;
+
+	if(!exists()) return(*this);
+	return(optimise_lay(optimise_r(*this, &c), &t));
+}
+
+// Optimise all the sets in a list
+
+sv_set_list sv_set_list::optimise() const
+{
+	sv_set_list result;
+	sv_set_list sl = *this;
+
+	while(sl.exists())
+	{
+		result = merge(result, sl.set().optimise());
+		sl = sl.next();
+	}
+
+	return(result);
+}
+
+// Bounding boxes.  These are kept as low x, y, z and high x, y, z; if
+// a low is above its high the box is empty.  Everything is done inside
+// the cube that reaches SV_BOUND_BIG each way, which stands in for all
+// space.
+
+#define SV_BOUND_BOXES 32	// Most boxes kept looking for a primitive's bound
+#define SV_BOUND_SPLITS 96	// Most times they get split
+#define SV_BOUND_PLANES 12	// Most planes in a convex set given an exact bound
+
+static void bound_empty(sv_real* b)
+{
+	for(int i = 0; i < 3; i++)
+	{
+		b[i] = 1;
+		b[i + 3] = -1;
+	}
+}
+
+static void bound_all(sv_real* b)
+{
+	for(int i = 0; i < 3; i++)
+	{
+		b[i] = -SV_BOUND_BIG;
+		b[i + 3] = SV_BOUND_BIG;
+	}
+}
+
+static int bound_is_empty(const sv_real* b)
+{
+	return((b[0] > b[3]) || (b[1] > b[4]) || (b[2] > b[5]));
+}
+
+// a = a | b
+
+static void bound_hull(sv_real* a, const sv_real* b)
+{
+	int i;
+
+	if(bound_is_empty(b)) return;
+	if(bound_is_empty(a))
+	{
+		for(i = 0; i < 6; i++) a[i] = b[i];
+		return;
+	}
+	for(i = 0; i < 3; i++)
+	{
+		if(b[i] < a[i]) a[i] = b[i];
+		if(b[i + 3] > a[i + 3]) a[i + 3] = b[i + 3];
+	}
+}
+
+// a = a & b
+
+static void bound_meet(sv_real* a, const sv_real* b)
+{
+	for(int i = 0; i < 3; i++)
+	{
+		if(b[i] > a[i]) a[i] = b[i];
+		if(b[i + 3] < a[i + 3]) a[i + 3] = b[i + 3];
+	}
+	if(bound_is_empty(a)) bound_empty(a);
+}
+
+// A half-space is only bounded if its plane is square to an axis
+
+static void bound_plane(const sv_plane& f, sv_real* b)
+{
+	sv_real n[3];
+	sv_real t;
+	int i, k = -1, nz = 0;
+
+	bound_all(b);
+	n[0] = f.normal.x;
+	n[1] = f.normal.y;
+	n[2] = f.normal.z;
+	for(i = 0; i < 3; i++)
+	{
+		if(n[i] != 0.0)
+		{
+			k = i;
+			nz++;
+		}
+	}
+	if(nz != 1) return;
+	t = -f.d/n[k];
+	if(n[k] > 0)
+	{
+		if(t < b[k + 3]) b[k + 3] = t;
+	} else
+	{
+		if(t > b[k]) b[k] = t;
+	}
+	if(bound_is_empty(b)) bound_empty(b);
+}
+
+// Where three planes meet, worked out in double precision; 0 if they
+// don't
+
+static int bound_corner(const sv_plane& f, const sv_plane& g, const sv_plane& h,
+	sv_point* p)
+{
+	double a[3][4], det, x, y, z;
+	const sv_plane* q[3];
+	int i;
+
+	q[0] = &f;
+	q[1] = &g;
+	q[2] = &h;
+	for(i = 0; i < 3; i++)
+	{
+		a[i][0] = q[i]->normal.x;
+		a[i][1] = q[i]->normal.y;
+		a[i][2] = q[i]->normal.z;
+		a[i][3] = -q[i]->d;
+	}
+	det = a[0][0]*(a[1][1]*a[2][2] - a[1][2]*a[2][1]) -
+		a[0][1]*(a[1][0]*a[2][2] - a[1][2]*a[2][0]) +
+		a[0][2]*(a[1][0]*a[2][1] - a[1][1]*a[2][0]);
+	if(fabs(det) < 1.0e-9) return(0);
+	x = a[0][3]*(a[1][1]*a[2][2] - a[1][2]*a[2][1]) -
+		a[0][1]*(a[1][3]*a[2][2] - a[1][2]*a[2][3]) +
+		a[0][2]*(a[1][3]*a[2][1] - a[1][1]*a[2][3]);
+	y = a[0][0]*(a[1][3]*a[2][2] - a[1][2]*a[2][3]) -
+		a[0][3]*(a[1][0]*a[2][2] - a[1][2]*a[2][0]) +
+		a[0][2]*(a[1][0]*a[2][3] - a[1][3]*a[2][0]);
+	z = a[0][0]*(a[1][1]*a[2][3] - a[1][3]*a[2][1]) -
+		a[0][1]*(a[1][0]*a[2][3] - a[1][3]*a[2][0]) +
+		a[0][3]*(a[1][0]*a[2][1] - a[1][1]*a[2][0]);
+	*p = sv_point((sv_real)(x/det), (sv_real)(y/det), (sv_real)(z/det));
+	return(1);
+}
+
+// The exact bound of the intersection of the half-spaces f[0..n-1] and
+// the big cube from the corners of the polyhedron they make.  The box
+// is opened out a little for rounding error.
+
+static void bound_convex(const sv_plane* f, sv_integer n, sv_real* b)
+{
+	sv_plane g[SV_BOUND_PLANES + 6];
+	sv_integer i, j, k, m, ng;
+	sv_real v[6], tol, pad;
+	sv_point p;
+
+	for(i = 0; i < n; i++) g[i] = f[i];
+	g[n] = sv_plane(sv_point(1, 0, 0), -SV_BOUND_BIG);
+	g[n + 1] = sv_plane(sv_point(-1, 0, 0), -SV_BOUND_BIG);
+	g[n + 2] = sv_plane(sv_point(0, 1, 0), -SV_BOUND_BIG);
+	g[n + 3] = sv_plane(sv_point(0, -1, 0), -SV_BOUND_BIG);
+	g[n + 4] = sv_plane(sv_point(0, 0, 1), -SV_BOUND_BIG);
+	g[n + 5] = sv_plane(sv_point(0, 0, -1), -SV_BOUND_BIG);
+	ng = n + 6;
+
+	bound_empty(b);
+	for(i = 0; i < ng; i++)
+	  for(j = i + 1; j < ng; j++)
+	    for(k = j + 1; k < ng; k++)
+	    {
+		if(!bound_corner(g[i], g[j], g[k], &p)) continue;
+		tol = 1.0e-4*(1 + fabs(p.x) + fabs(p.y) + fabs(p.z));
+		for(m = 0; m < ng; m++)
+			if(g[m].value(p) > tol) break;
+		if(m < ng) continue;
+		pad = 2*tol;
+		v[0] = p.x - pad;
+		v[1] = p.y - pad;
+		v[2] = p.z - pad;
+		v[3] = p.x + pad;
+		v[4] = p.y + pad;
+		v[5] = p.z + pad;
+		bound_hull(b, v);
+	    }
+	if(bound_is_empty(b)) return;
+	for(i = 0; i < 3; i++)
+	{
+		if(b[i] < -SV_BOUND_BIG) b[i] = -SV_BOUND_BIG;
+		if(b[i + 3] > SV_BOUND_BIG) b[i + 3] = SV_BOUND_BIG;
+	}
+}
+
+// Gather the planes of a set that is the intersection of half-spaces
+// (and note if any isn't square to an axis); 0 if it isn't one, or
+// has too many
+
+static int bound_planes(const sv_set& s, sv_plane* f, sv_integer* n, int* oblique)
+{
+	sv_primitive p;
+	sv_plane g;
+
+	if(s.contents() > SV_BOUND_PLANES) return(0);
+	switch(s.contents())
+	{
+	case SV_EVERYTHING:
+	case SV_NOTHING:
+		return(0);
+
+	case 1:
+		p = s.primitive();
+		if((p.kind() != SV_PLANE) || ((p.op() != SV_ZERO) && (p.op() != SV_COMP)))
+			return(0);
+		if(*n >= SV_BOUND_PLANES) return(0);
+		g = p.plane();
+		if(((g.normal.x != 0.0) + (g.normal.y != 0.0) + (g.normal.z != 0.0)) > 1)
+			*oblique = 1;
+		f[(*n)++] = g;
+		return(1);
+
+	default:
+		if(s.op() != SV_INTERSECTION) return(0);
+		return(bound_planes(s.child_1(), f, n, oblique) &&
+			bound_planes(s.child_2(), f, n, oblique));
+	}
+}
+
+// Is each of n boxes small next to all of them together?
+
+static int bound_fine(sv_real (*bx)[6], sv_integer n)
+{
+	sv_real h[6], side, big = 0;
+	sv_integer i, k;
+
+	bound_empty(h);
+	for(i = 0; i < n; i++) bound_hull(h, bx[i]);
+	for(k = 0; k < 3; k++)
+		if(h[k + 3] - h[k] > big) big = h[k + 3] - h[k];
+	for(i = 0; i < n; i++)
+		for(k = 0; k < 3; k++)
+		{
+			side = bx[i][k + 3] - bx[i][k];
+			if(side*16 > big) return(0);
+		}
+	return(1);
+}
+
+// Split box a in half across its longest side into c and d, and return
+// how many of them aren't all air for primitive p (those are put first)
+
+static sv_integer bound_split(const sv_primitive& p, const sv_real* a, sv_real* c, sv_real* d)
+{
+	sv_real mid, e[6];
+	sv_integer j, k = 0, l, m = 0;
+	sv_real* r[2];
+
+	r[0] = c;
+	r[1] = d;
+	for(j = 1; j < 3; j++)
+		if(a[j + 3] - a[j] > a[k + 3] - a[k]) k = j;
+	mid = 0.5*(a[k] + a[k + 3]);
+	for(j = 0; j < 2; j++)
+	{
+		for(l = 0; l < 6; l++) e[l] = a[l];
+		if(j)
+			e[k] = mid;
+		else
+			e[k + 3] = mid;
+		if(p.range(sv_box(sv_point(e[0], e[1], e[2]),
+			sv_point(e[3], e[4], e[5]))).member() != SV_AIR)
+		{
+			for(l = 0; l < 6; l++) r[m][l] = e[l];
+			m++;
+		}
+	}
+	return(m);
+}
+
+// Push face f (0 - 5 as for the bounds) of the boxes bx[0..n-1], which
+// hold all of primitive p, as far in as it will go.  The box at the face
+// is split over and over until it's smaller than tol.
+
+#define SV_BOUND_FACE 128	// Most boxes kept doing it
+
+static sv_real bound_face(const sv_primitive& p, sv_real (*bx)[6], sv_integer n,
+	sv_integer f, sv_real tol)
+{
+	sv_real q[SV_BOUND_FACE][6], a[6], x = 0, y, side;
+	sv_integer i, e, j, l, m;
+	int low = f < 3;
+
+	for(i = 0; i < n; i++)
+		for(l = 0; l < 6; l++) q[i][l] = bx[i][l];
+
+	for(;;)
+	{
+		e = 0;
+		for(i = 0; i < n; i++)
+		{
+			y = q[i][f];
+			if((i == 0) || (low && (y < x)) || (!low && (y > x)))
+			{
+				x = y;
+				e = i;
+			}
+		}
+		side = 0;
+		for(j = 0; j < 3; j++)
+			if(q[e][j + 3] - q[e][j] > side) side = q[e][j + 3] - q[e][j];
+		if((side <= tol) || (n + 1 >= SV_BOUND_FACE)) return(x);
+
+		for(l = 0; l < 6; l++) a[l] = q[e][l];
+		n--;
+		for(l = 0; l < 6; l++) q[e][l] = q[n][l];
+		m = bound_split(p, a, q[n], q[n + 1]);
+		n = n + m;
+		if(!n) return(x);
+	}
+}
+
+// The bound of a general primitive.  Starting with the big cube, boxes
+// are split in half across their longest sides, and halves that the
+// primitive's range says are all air are thrown away, until the boxes
+// left are small or there would be too many of them.  Then each face
+// of the box round them is pushed in as far as it will go.
+
+static void bound_search(const sv_primitive& p, sv_real* b)
+{
+	sv_real bx[SV_BOUND_BOXES][6], nx[2*SV_BOUND_BOXES][6], tol;
+	sv_integer i, k, l, r, n, m;
+
+	bound_all(bx[0]);
+	n = 1;
+	for(r = 0; r < SV_BOUND_SPLITS; r++)
+	{
+		if(bound_fine(bx, n)) break;
+		m = 0;
+		for(i = 0; i < n; i++) m = m + bound_split(p, bx[i], nx[m], nx[m + 1]);
+		if(!m)
+		{
+			bound_empty(b);
+			return;
+		}
+		if(m > SV_BOUND_BOXES) break;
+		for(i = 0; i < m; i++)
+			for(l = 0; l < 6; l++) bx[i][l] = nx[i][l];
+		n = m;
+	}
+	bound_empty(b);
+	for(i = 0; i < n; i++) bound_hull(b, bx[i]);
+
+	tol = 0;
+	for(k = 0; k < 3; k++)
+		if(b[k + 3] - b[k] > tol) tol = b[k + 3] - b[k];
+	tol = tol/256;
+	for(k = 0; k < 6; k++)
+		if(fabs(b[k]) < SV_BOUND_BIG) b[k] = bound_face(p, bx, n, k, tol);
+}
+
+// The search is only done if it's asked for (set_bound_search), as it 
+// takes thousands of range evaluations for each primitive
+
+static sv_integer bound_searching = 0;
+
+void set_bound_search(sv_integer s) { bound_searching = s; }
+
+sv_integer get_bound_search() { return(bound_searching); }
+
+// The box round centre c reaching h[0], h[1] and h[2] each way, opened
+// out a little for rounding error; an h at or above SV_BOUND_BIG leaves
+// that direction unbounded
+
+static void bound_centre(const sv_point& c, const sv_real* h, sv_real* b)
+{
+	sv_real x[3], pad;
+	sv_integer i;
+
+	x[0] = c.x;
+	x[1] = c.y;
+	x[2] = c.z;
+	bound_all(b);
+	for(i = 0; i < 3; i++)
+	{
+		if(h[i] >= SV_BOUND_BIG) continue;
+		pad = 1.0e-4*(1 + fabs(x[i]) + h[i]);
+		b[i] = max(x[i] - h[i] - pad, -(sv_real)SV_BOUND_BIG);
+		b[i + 3] = min(x[i] + h[i] + pad, (sv_real)SV_BOUND_BIG);
+	}
+	if(bound_is_empty(b)) bound_empty(b);
+}
+
+// Spheres, cylinders and tori have their bounds worked out from their
+// sizes, and cones go on for ever; 0 for any other primitive.  Signed
+// square roots and signs don't change where a primitive is solid, so
+// they are looked through.
+
+static int bound_shape(const sv_primitive& p, sv_real* b)
+{
+	sv_integer k;
+	sv_real r0, r1, r2, d[3], h[3];
+	sv_plane f;
+	sv_point cen;
+	sv_line axis;
+	sv_integer i;
+
+	switch(p.parameters(&k, &r0, &r1, &r2, &f, &cen, &axis))
+	{
+	case SV_PLUS:
+	case SV_SSQRT:
+	case SV_SIGN:
+		break;
+	default:
+		return(0);
+	}
+
+	switch(k)
+	{
+	case SV_SPHERE:
+		h[0] = h[1] = h[2] = r0;
+		bound_centre(cen, h, b);
+		return(1);
+
+	case SV_CYLINDER:
+	case SV_TORUS:
+		d[0] = axis.direction.x;
+		d[1] = axis.direction.y;
+		d[2] = axis.direction.z;
+		for(i = 0; i < 3; i++)
+		{
+			if(k == SV_TORUS)
+				h[i] = r0*sqrt(max((sv_real)0, 1 - d[i]*d[i])) + r1;
+			else
+				h[i] = (d[i] == 0.0) ? r0 : SV_BOUND_BIG;
+		}
+		bound_centre(axis.origin, h, b);
+		return(1);
+
+	case SV_CONE:
+		bound_all(b);
+		return(1);
+
+	default:
+		return(0);
+	}
+}
+
+// Other primitives get one range over all space, which says if they
+// are empty
+
+static void bound_prim(const sv_primitive& p, sv_real* b)
+{
+	if((p.kind() == SV_PLANE) && ((p.op() == SV_ZERO) || (p.op() == SV_COMP)))
+		bound_plane(p.plane(), b);
+	else if(bound_shape(p, b))
+		return;
+	else if(bound_searching)
+		bound_search(p, b);
+	else
+	{
+		bound_all(b);
+		if(p.range(sv_box(sv_point(b[0], b[1], b[2]), sv_point(b[3], b[4], b[5]))).member() 
+			== SV_AIR)
+			bound_empty(b);
+	}
+}
+
+// The bound of an intersection of half-spaces, if that's what s is and
+// it isn't a box already; 0 if not
+
+static int bound_polyhedron(const sv_set& s, sv_real* b)
+{
+	sv_plane f[SV_BOUND_PLANES];
+	sv_integer n = 0;
+	int oblique = 0;
+
+	if(!bound_planes(s, f, &n, &oblique) || !oblique) return(0);
+	bound_convex(f, n, b);
+	return(1);
+}
+
+// Work out the bound of a set whose children's bounds are known
+
+void sv_set::make_bound() const
+{
+	sv_integer i;
+	sv_real* b = new sv_real[6];
+
+	switch(contents())
+	{
+	case SV_EVERYTHING:
+		bound_all(b);
+		break;
+
+	case SV_NOTHING:
+		bound_empty(b);
+		break;
+
+	case 1:
+		bound_prim(primitive(), b);
+		break;
+
+	default:
+		if(op() == SV_UNION)
+		{
+			for(i = 0; i < 6; i++) b[i] = child_1().bound_got()[i];
+			bound_hull(b, child_2().bound_got());
+		} else
+		{
+			if(!bound_polyhedron(*this, b))
+			{
+				for(i = 0; i < 6; i++) b[i] = child_1().bound_got()[i];
+				bound_meet(b, child_2().bound_got());
+			}
+		}
+		break;
+	}
+
+// Another thread may have got here first, in which case its answer
+// (which is the same) stays
+
+	if(!sv_atomic_set_ptr((void**)&(set_info->bound), 0, (void*)b)) delete [] b;
+}
+
+// Work out the bounds of a set and any of its subsets that haven't
+// been done.  Sets can be very deep, so this keeps its own stack.
+
+#define SV_BOUND_STACK 64
+
+void sv_set::make_bounds() const
+{
+	sv_set stk_s[SV_BOUND_STACK];
+	sv_set* stk = stk_s;
+	sv_set* s2;
+	sv_integer n, size = SV_BOUND_STACK, i;
+	sv_set c;
+
+	stk[0] = *this;
+	n = 1;
+	while(n)
+	{
+		if(n + 2 > size)
+		{
+			s2 = new sv_set[2*size];
+			for(i = 0; i < n; i++) s2[i] = stk[i];
+			if(stk != stk_s) delete [] stk;
+			stk = s2;
+			size = 2*size;
+		}
+		const sv_set& t = stk[n - 1];
+		if(t.bound_got())
+		{
+			n--;
+			continue;
+		}
+		if(t.contents() > 1)
+		{
+			c = t.child_1();
+			if(!c.bound_got())
+			{
+				stk[n++] = c;
+				continue;
+			}
+			c = t.child_2();
+			if(!c.bound_got())
+			{
+				stk[n++] = c;
+				continue;
+			}
+		}
+		t.make_bound();
+		n--;
+	}
+	if(stk != stk_s) delete [] stk;
+}
+
+// The bound of a set, worked out if need be
+
+const sv_real* sv_set::bound_p() const
+{
+	if(!bound_got()) make_bounds();
+	return(bound_got());
+}
+
+sv_box sv_set::bound() const
+{
+	if(!exists()) return(sv_box());
+
+	const sv_real* b = bound_p();
+
+	if(bound_is_empty(b)) return(sv_box());
+	return(sv_box(sv_point(b[0], b[1], b[2]), sv_point(b[3], b[4], b[5])));
+}
+
+// Is a point inside the big cube?
+
+static int bound_in_big(const sv_point& p)
+{
+	return((fabs(p.x) <= SV_BOUND_BIG) && (fabs(p.y) <= SV_BOUND_BIG) &&
+		(fabs(p.z) <= SV_BOUND_BIG));
+}
+
+int sv_set::misses(const sv_box& bx) const
+{
+	if(!bound_in_big(sv_point(bx.xi.lo(), bx.yi.lo(), bx.zi.lo())) ||
+	   !bound_in_big(sv_point(bx.xi.hi(), bx.yi.hi(), bx.zi.hi()))) return(0);
+
+	const sv_real* b = bound_p();
+
+	if(bound_is_empty(b)) return(1);
+	return((bx.xi.hi() < b[0]) || (bx.xi.lo() > b[3]) ||
+		(bx.yi.hi() < b[1]) || (bx.yi.lo() > b[4]) ||
+		(bx.zi.hi() < b[2]) || (bx.zi.lo() > b[5]));
+}
+
+int sv_set::misses(const sv_point& p) const
+{
+	if(!bound_in_big(p)) return(0);
+
+	const sv_real* b = bound_p();
+
+	if(bound_is_empty(b)) return(1);
+	return((p.x < b[0]) || (p.x > b[3]) || (p.y < b[1]) || (p.y > b[4]) ||
+		(p.z < b[2]) || (p.z > b[5]));
+}
+
+// For lines the box is opened out a little so rounding can't lose a
+// line that just touches it
+
+int sv_set::misses(const sv_line& l, sv_real t0, sv_real t1) const
+{
+	sv_real o[3], d[3], lo, hi, ta, tb, t, pad;
+	sv_integer k;
+
+	if(!bound_in_big(line_point(l, t0)) || !bound_in_big(line_point(l, t1)))
+		return(0);
+
+	const sv_real* b = bound_p();
+
+	if(bound_is_empty(b)) return(1);
+	o[0] = l.origin.x;
+	o[1] = l.origin.y;
+	o[2] = l.origin.z;
+	d[0] = l.direction.x;
+	d[1] = l.direction.y;
+	d[2] = l.direction.z;
+	ta = min(t0, t1);
+	tb = max(t0, t1);
+	for(k = 0; k < 3; k++)
+	{
+		pad = 1.0e-5*(1 + fabs(b[k]) + fabs(b[k + 3]));
+		lo = b[k] - pad;
+		hi = b[k + 3] + pad;
+		if(d[k] == 0.0)
+		{
+			if((o[k] < lo) || (o[k] > hi)) return(1);
+			continue;
+		}
+		lo = (lo - o[k])/d[k];
+		hi = (hi - o[k])/d[k];
+		if(lo > hi)
+		{
+			t = lo;
+			lo = hi;
+			hi = t;
+		}
+		if(lo > ta) ta = lo;
+		if(hi < tb) tb = hi;
+		if(ta > tb) return(1);
+	}
+	return(0);
+}
+
+// This membership-tests a point against a set
+// When points are on surfaces, the result is regularized.
+// If the point is known to lie on the surfaces of some primitives,
+// they should be listed in known_surface[]; the list is terminated
+// with an undefined primitive.  If no such primitives exist, just
+// send a pointer to an undefined primitive for the third argument.
+
+mem_test sv_set::member(const sv_point& p, sv_primitive known_surface[]) const
+{
+	mem_test result_1 = SV_AIR;
+	mem_test result_2 = SV_AIR;
+	sv_integer i = 0;
+	sv_real work;
+
+	switch (contents())
+	{
+	case SV_EVERYTHING:
+		return(SV_SOLID);
+
+	case SV_NOTHING:
+		return(SV_AIR);
+
+	case 1:
+		while(known_surface[i].exists())
+			if (primitive() == known_surface[i++]) return(SV_SURFACE);
+//		result_1 = member(primitive().value(p));
+// That won't go with Microsoft Visual C++, so time for a workround...
+		work = primitive().value(p);
+		if (work > 0)
+			result_1 = SV_AIR;
+		else
+		{
+			if (work < 0) 
+				result_1 = SV_SOLID;
+			else
+				result_1 = SV_SURFACE;
+		}
+		return(result_1);
+	
+	default:
+
+		if (misses(p)) return(SV_AIR);
+
+// child_1 should have a lower complexity than child_2
+
+		result_1 = child_1().member(p,known_surface);
+
+		if (op() == SV_UNION)
+		{
+			if (result_1 == SV_SOLID) return(SV_SOLID);
+			result_2 = child_2().member(p,known_surface);
+			if (result_2 == SV_SOLID) return(SV_SOLID);
+			if ((result_1 == SV_SURFACE)||(result_2 == SV_SURFACE))
+				return(SV_SURFACE);
+			else
+				return(SV_AIR);
+		} else
+		{
+			if (result_1 == SV_AIR) return(SV_AIR);
+			result_2 = child_2().member(p,known_surface);
+			if (result_2 == SV_AIR) return(SV_AIR);
+			if ((result_1 == SV_SURFACE)||(result_2 == SV_SURFACE))
+				return(SV_SURFACE);
+			else
+				return(SV_SOLID);
+		}
+		break;
+	}
+
+// Should never get to here.
+
+	svlis_error("sv_set::member(sv_point...)","returning AIR",SV_CORRUPT);
+
+	return(result_1);   
+}
+
+// Working space for batch membership tests; there is one level for
+// each depth of the set tree that the test has got down to.
+
+struct sv_mem_level
+{
+	sv_real x[SV_TAPE_BLOCK], y[SV_TAPE_BLOCK], z[SV_TAPE_BLOCK];
+	sv_real v[SV_TAPE_BLOCK];
+	mem_test r[SV_TAPE_BLOCK];
+	sv_integer idx[SV_TAPE_BLOCK];
+};
+
+struct sv_mem_work
+{
+	sv_mem_level** level;
+	sv_integer levels;
+
+	sv_mem_work() { level = 0; levels = 0; }
+	~sv_mem_work()
+	{
+		for(sv_integer i = 0; i < levels; i++) delete level[i];
+		if(level) delete [] level;
+	}
+
+	sv_mem_level* at(sv_integer d)
+	{
+		if(d >= levels)
+		{
+			sv_integer n = 2*d + 8;
+			sv_mem_level** l = new sv_mem_level*[n];
+			sv_integer i;
+			for(i = 0; i < levels; i++) l[i] = level[i];
+			for(; i < n; i++) l[i] = new sv_mem_level;
+			if(level) delete [] level;
+			level = l;
+			levels = n;
+		}
+		return(level[d]);
+	}
+};
+
+// Membership test for up to SV_TAPE_BLOCK points.  Child 2 only gets
+// the points that child 1 didn't settle, gathered together so the
+// primitives still see a dense batch.
+
+static void member_block(const sv_set& s, const sv_real* x, const sv_real* y, 
+	const sv_real* z, mem_test* r, sv_integer m, sv_mem_work& w, sv_integer d,
+	int tested = 0)
+{
+	sv_mem_level* l;
+	sv_integer i, j;
+	mem_test settled, r2;
+
+	switch (s.contents())
+	{
+	case SV_EVERYTHING:
+		for(i = 0; i < m; i++) r[i] = SV_SOLID;
+		return;
+
+	case SV_NOTHING:
+		for(i = 0; i < m; i++) r[i] = SV_AIR;
+		return;
+
+	case 1:
+		l = w.at(d);
+		s.primitive().value(x, y, z, l->v, m);
+		for(i = 0; i < m; i++)
+		{
+			if (l->v[i] > 0)
+				r[i] = SV_AIR;
+			else
+			{
+				if (l->v[i] < 0)
+					r[i] = SV_SOLID;
+				else
+					r[i] = SV_SURFACE;
+			}
+		}
+		return;
+
+	default:
+
+// Points outside the set's bounding box are in air; if there are any,
+// the rest are done on their own
+
+		if(!tested)
+		{
+			l = w.at(d);
+			j = 0;
+			for(i = 0; i < m; i++)
+			{
+				if(s.misses(sv_point(x[i], y[i], z[i])))
+					r[i] = SV_AIR;
+				else
+				{
+					l->x[j] = x[i];
+					l->y[j] = y[i];
+					l->z[j] = z[i];
+					l->idx[j++] = i;
+				}
+			}
+			if(j < m)
+			{
+				if(!j) return;
+				member_block(s, l->x, l->y, l->z, l->r, j, w, d + 1, 1);
+				for(i = 0; i < j; i++) r[l->idx[i]] = l->r[i];
+				return;
+			}
+		}
+
+		member_block(s.child_1(), x, y, z, r, m, w, d + 1);
+
+		settled = (s.op() == SV_UNION) ? SV_SOLID : SV_AIR;
+		l = w.at(d);
+		j = 0;
+		for(i = 0; i < m; i++)
+		{
+			if(r[i] != settled)
+			{
+				l->x[j] = x[i];
+				l->y[j] = y[i];
+				l->z[j] = z[i];
+				l->idx[j++] = i;
+			}
+		}
+		if(!j) return;
+
+		member_block(s.child_2(), l->x, l->y, l->z, l->r, j, w, d + 1);
+
+		for(i = 0; i < j; i++)
+		{
+			r2 = l->r[i];
+			if (r2 == settled)
+				r[l->idx[i]] = settled;
+			else if (r2 == SV_SURFACE)
+				r[l->idx[i]] = SV_SURFACE;
+		}
+	}
+}
+
+// Membership test a batch of points.  This gives the same answers as
+// member(point) for each point in turn.
+
+void sv_set::member(const sv_real* x, const sv_real* y, const sv_real* z, 
+	mem_test* r, sv_integer n) const
+{
+	sv_mem_work w;
+	sv_integer j;
+
+	for(j = 0; j < n; j += SV_TAPE_BLOCK)
+		member_block(*this, x + j, y + j, z + j, r + j, 
+			min(n - j, (sv_integer)SV_TAPE_BLOCK), w, 0);
+}
+
+// Value for a point (and winning leaf).  The tree is walked through the
+// raw child pointers, and the winning leaf (and the lowest set above it
+// with an attribute) are only noted, so that no reference counts are
+// written; the time all goes on reading the primitives.
+
+sv_real sv_set::value_r(const sv_point& p, const sv_set** w, const sv_set** wa) const
+{
+	sv_real result;
+	sv_real result_2;
+	const sv_set* w_2;
+	const sv_set* wa_2;
+
+	switch (contents())
+	{
+	case SV_EVERYTHING:
+		*w = this;
+		*wa = 0;
+		return(-1.0);
+
+	case SV_NOTHING:
+		*w = this;
+		*wa = 0;
+		return(1.0);
+
+	case 1:
+		*w = this;
+		*wa = 0;
+		return(set_info->prim.value(p));
+	
+	default:
+
+		result = set_info->child_1->value_r(p, w, wa);
+		result_2 = set_info->child_2->value_r(p, &w_2, &wa_2);
+
+		if (op() == SV_UNION)	// == minimum
+		{
+			if (result > result_2)
+			{
+				*w = w_2;
+				*wa = wa_2;
+				result = result_2;
+			}
+		} else
+		{	// INTERSECTION == maximum
+			if (result < result_2)
+			{
+				*w = w_2;
+				*wa = wa_2;
+				result = result_2;
+			}
+		}
+		if ( has_attribute() && !((*w)->has_attribute()) && !(*wa) )
+			*wa = this;
+		return(result);
+	}
+}
+
+sv_real sv_set::value(const sv_point& p, sv_set* winner) const
+{
+	const sv_set* w;
+	const sv_set* wa;
+	sv_real result = value_r(p, &w, &wa);
+
+	*winner = *w;
+	if (wa) *winner = winner->attribute(wa->attribute());
+	return(result);
+}
+
+// Range for a box (and winning leaves)
+
+sv_interval sv_set::range(const sv_box& b, sv_set* w_lo, sv_set* w_hi) const
+{
+	sv_range_memo m(b);
+	return(range(m, w_lo, w_hi));
+}
+
+sv_interval sv_set::range(sv_range_memo& memo, sv_set* w_lo, sv_set* w_hi) const
+{
+	sv_interval result_2;
+	sv_interval result;
+	sv_set w_2_lo, w_2_hi;
+
+	switch (contents())
+	{
+	case SV_EVERYTHING:
+		*w_lo = *this;
+		*w_hi = *this;
+		return(sv_interval(-2.0,-1.0)); // By convention (what does this do to the min/max?)
+
+	case SV_NOTHING:
+		*w_lo = *this;
+		*w_hi = *this;
+		return(sv_interval(1.0,2.0));
+
+	case 1:
+		*w_lo = *this;
+		*w_hi = *this;
+		return(memo.range(primitive()));
+	
+	default:
+
+		result = child_1().range(memo, w_lo, w_hi);
+		result_2 = child_2().range(memo ,&w_2_lo, &w_2_hi);
+
+		if (op() == SV_UNION)	// U == minimum
+		{
+			if (result_2.lo() < result.lo())
+			{
+				*w_lo = w_2_lo;
+				result = sv_interval(result_2.lo(), result.hi());
+			}
+			if (result_2.hi() < result.hi())
+			{
+				*w_hi = w_2_hi;
+				result = sv_interval(result.lo(), result_2.hi());
+			}
+		} else
+		{	// INTERSECTION == maximum
+			if (result_2.lo() > result.lo())
+			{
+				*w_lo = w_2_lo;
+				result = sv_interval(result_2.lo(), result.hi());
+			}
+			if (result_2.hi() > result.hi())
+			{
+				*w_hi = w_2_hi;
+				result = sv_interval(result.lo(), result_2.hi());
+			}
+		}
+		if (has_attribute() && ( !w_lo->has_attribute() ))
+			*w_lo = w_lo->attribute(attribute());
+		if (has_attribute() && ( !w_hi->has_attribute() ))
+			*w_hi = w_hi->attribute(attribute());
+		return(result);
+	}
+}
+
+// Flag for whether the results of pruning are
+// regularized
+
+static sv_integer reg_prune = 0;
+
+void regular_prune(sv_integer p) { reg_prune = p; }
+
+// This prunes a set to a box.  Each primitive's range is only
+// worked out once, however often it turns up.
+
+sv_set sv_set::prune(const sv_box& b) const
+{
+	sv_range_memo m(b);
+	return(prune(m));
+}
+
+sv_set sv_set::prune(sv_range_memo& memo) const
+{
+	sv_set pruned, temp;
+	mem_test m = SV_AIR;
+	int c_1_same;
+
+	switch (contents())
+	{
+        case SV_EVERYTHING:
 	case SV_NOTHING:
 		pruned = *this;
 		break;
 
         case 1:
-		m = primitive().range(b).member();
+		m = memo.range(primitive()).member();
 		switch (m)
 		{
 		case SV_AIR:
@@ -1213,7 +2551,15 @@ sv_set sv_set::prune(const sv_box& b) const
 		break;
 					
 	default:
-		pruned = child_1().prune(b);
+
+// If the box misses the set's bounding box, there's nothing in it
+
+		if (misses(memo.box()))
+		{
+			pruned = sv_set(SV_NOTHING);
+			break;
+		}
+		pruned = child_1().prune(memo);
 		c_1_same = ( pruned == child_1() );
 		if (op() == SV_UNION)
 		{
@@ -1222,11 +2568,11 @@ sv_set sv_set::prune(const sv_box& b) const
 			case SV_EVERYTHING:
 				break;
 			case SV_NOTHING:
-				pruned = child_2().prune(b);
+				pruned = child_2().prune(memo);
 				break;
 			case 1:
 			default:
-				temp = child_2().prune(b);
+				temp = child_2().prune(memo);
 				if (c_1_same && (temp == child_2()))
 					pruned = *this;
 				else
@@ -1238,13 +2584,13 @@ sv_set sv_set::prune(const sv_box& b) const
 			switch (pruned.contents())
 			{
 			case SV_EVERYTHING:
-				pruned = child_2().prune(b);
+				pruned = child_2().prune(memo);
 				break;
 			case SV_NOTHING:
 				break;
 			case 1:
 			default:
-				temp = child_2().prune(b);
+				temp = child_2().prune(memo);
 				if (c_1_same && (temp == child_2()))
 					pruned = *this;
 				else
@@ -1256,7 +2602,159 @@ sv_set sv_set::prune(const sv_box& b) const
 	}
 
 	if(reg_prune) pruned = pruned.regularize();
-	return(att_prune(pruned, *this, b));
+	return(att_prune(pruned, *this, memo.box()));
+}
+
+// Batches this small are pruned using workspace on the stack
+
+#define SV_PRUNE_SMALL 8
+
+// Prune a set to many boxes at once.  The answers are the same as 
+// prune(box) for each box, but each leaf primitive has its range 
+// worked out for all the boxes together, and child 2 only sees the 
+// boxes for which child 1 didn't settle things.
+
+void sv_set::prune(const sv_box* b, sv_set* r, sv_integer n) const
+{
+	sv_integer i, j;
+	sv_interval* v;
+	sv_set* p2;
+	sv_box* b2;
+	sv_integer* idx;
+	sv_integer settled, identity;
+	int c_1_same;
+	sv_interval v_s[SV_PRUNE_SMALL];
+	sv_set p2_s[SV_PRUNE_SMALL];
+	sv_box b2_s[SV_PRUNE_SMALL];
+	sv_integer idx_s[SV_PRUNE_SMALL];
+	int small = n <= SV_PRUNE_SMALL;
+
+	if(n <= 0) return;
+
+	switch (contents())
+	{
+        case SV_EVERYTHING:
+	case SV_NOTHING:
+		for(i = 0; i < n; i++) r[i] = *this;
+		break;
+
+        case 1:
+		v = small ? v_s : new sv_interval[n];
+		primitive().range(b, v, n);
+		for(i = 0; i < n; i++)
+		{
+			switch (v[i].member())
+			{
+			case SV_AIR:
+				r[i] = sv_set(SV_NOTHING);
+				break;
+			case SV_SURFACE:
+				r[i] = *this;
+				break;
+			case SV_SOLID:
+				r[i] = sv_set(SV_EVERYTHING);
+				break;
+			default:
+				svlis_error("sv_set::prune(sv_box*)", "dud mem test", SV_CORRUPT);
+			}
+		}
+		if(!small) delete [] v;
+		break;
+					
+	default:
+
+// Boxes that miss the set's bounding box have nothing in them; the rest
+// are pruned on their own
+
+		j = 0;
+		for(i = 0; i < n; i++)
+			if(!misses(b[i])) j++;
+		if(j < n)
+		{
+			b2 = small ? b2_s : new sv_box[j];
+			p2 = small ? p2_s : new sv_set[j];
+			idx = small ? idx_s : new sv_integer[j];
+			j = 0;
+			for(i = 0; i < n; i++)
+			{
+				if(misses(b[i]))
+				{
+					r[i] = sv_set(SV_NOTHING);
+					if(reg_prune) r[i] = r[i].regularize();
+					r[i] = att_prune(r[i], *this, b[i]);
+				} else
+				{
+					b2[j] = b[i];
+					idx[j++] = i;
+				}
+			}
+			prune(b2, p2, j);
+			for(i = 0; i < j; i++) r[idx[i]] = p2[i];
+			if(!small)
+			{
+				delete [] p2;
+				delete [] b2;
+				delete [] idx;
+			}
+			return;
+		}
+
+		child_1().prune(b, r, n);
+
+// For a union, an EVERYTHING from child 1 is the answer and a NOTHING
+// means the answer is child 2's; the other way round for an
+// intersection.  Gather up the unsettled boxes for child 2.
+
+		if (op() == SV_UNION)
+		{
+			settled = SV_EVERYTHING;
+			identity = SV_NOTHING;
+		} else
+		{
+			settled = SV_NOTHING;
+			identity = SV_EVERYTHING;
+		}
+		idx = small ? idx_s : new sv_integer[n];
+		j = 0;
+		for(i = 0; i < n; i++)
+			if(r[i].contents() != settled) idx[j++] = i;
+		if(!j)
+		{
+			if(!small) delete [] idx;
+			break;
+		}
+		b2 = small ? b2_s : new sv_box[j];
+		p2 = small ? p2_s : new sv_set[j];
+		for(i = 0; i < j; i++) b2[i] = b[idx[i]];
+		child_2().prune(b2, p2, j);
+
+		for(i = 0; i < j; i++)
+		{
+			sv_set& pruned = r[idx[i]];
+			c_1_same = ( pruned == child_1() );
+			if (pruned.contents() == identity)
+				pruned = p2[i];
+			else if (c_1_same && (p2[i] == child_2()))
+				pruned = *this;
+			else if (op() == SV_UNION)
+				pruned = pruned | p2[i];
+			else
+				pruned = pruned & p2[i];
+		}
+		if(!small)
+		{
+			delete [] p2;
+			delete [] b2;
+			delete [] idx;
+		}
+		break;
+	}
+
+	for(i = 0; i < n; i++)
+	{
+		if(reg_prune) r[i] = r[i].regularize();
+		r[i] = att_prune(r[i], *this, b[i]);
+	}
 }
 
 // Polygons as attributes
@@ -1677,15 +3175,21 @@ prim_op same(const sv_set_list& a, const sv_set_list& b)
 
 
 // Create a new set list that is a copy of an old one, with the sets
-// each pruned to a box
+// each pruned to a box.  The sets share one memo of primitive ranges.
 
 sv_set_list sv_set_list::prune(const sv_box& b) const
+{
+	sv_range_memo m(b);
+	return(prune(m));
+}
+
+sv_set_list sv_set_list::prune(sv_range_memo& memo) const
 {
 	sv_set_list result, n;
 	
 	if (!exists())
 	{
-		svlis_error("sv_set_list::prune(sv_box)","attempt to prune undefined set list",
+		svlis_error("sv_set_list::prune(sv_range_memo)","attempt to prune undefined set list",
 				SV_WARNING);
 		return(result);
 	}
@@ -1693,13 +3197,370 @@ sv_set_list sv_set_list::prune(const sv_box& b) const
 	n = next();
 
 	if(n.exists())
-		result = merge(n.prune(b), set().prune(b));
+		result = merge(n.prune(memo), set().prune(memo));
 	else
-		result = sv_set_list(set().prune(b));
+		result = sv_set_list(set().prune(memo));
 
 	return(result);
 }
 
+// Prune a set list to many boxes at once
+
+void sv_set_list::prune(const sv_box* b, sv_set_list* r, sv_integer n) const
+{
+	sv_set_list nx;
+	sv_set* p;
+	sv_integer i;
+	
+	if (!exists())
+	{
+		svlis_error("sv_set_list::prune(sv_box*)","attempt to prune undefined set list",
+				SV_WARNING);
+		return;
+	}
+
+	p = new sv_set[n];
+	set().prune(b, p, n);
+
+	nx = next();
+
+	if(nx.exists())
+	{
+		nx.prune(b, r, n);
+		for(i = 0; i < n; i++) r[i] = merge(r[i], p[i]);
+	} else
+		for(i = 0; i < n; i++) r[i] = sv_set_list(p[i]);
+
+	delete [] p;
+}
+
+// Set lists compiled for pruning (see sv_set.h).  What happens to each
+// node when it's pruned: it stays as it is, it becomes nothing or
+// everything, it becomes what one of its children becomes, or it becomes
+// both its children's results combined again.
+
+#define SV_PT_KEEP 0
+#define SV_PT_NOTHING 1
+#define SV_PT_EVERYTHING 2
+#define SV_PT_CHILD_1 3
+#define SV_PT_CHILD_2 4
+#define SV_PT_BOTH 5
+
+// A table of the nodes already seen while the tree is built, keyed by
+// the sets' unique()s, as sv_range_memo keeps primitives
+
+struct sv_set_tree::index
+{
+	long* key;
+	sv_integer* val;
+	sv_integer size, used;
+
+	index()
+	{
+		size = 64;
+		used = 0;
+		key = new long[size];
+		val = new sv_integer[size];
+		for(sv_integer i = 0; i < size; i++) key[i] = 0;
+	}
+
+	~index() { delete [] key; delete [] val; }
+
+	sv_integer slot(long u) const
+	{
+		unsigned long h = (unsigned long)u;
+		sv_integer i = (sv_integer)((h >> 4) ^ (h >> 11)) & (size - 1);
+
+		while(key[i] && (key[i] != u)) i = (i + 1) & (size - 1);
+		return(i);
+	}
+
+// The node for u, or -1 if it hasn't been seen
+
+	sv_integer find(long u) const
+	{
+		sv_integer i = slot(u);
+		return(key[i] ? val[i] : -1);
+	}
+
+	void put(long u, sv_integer v)
+	{
+		sv_integer i, j, s;
+		long* k;
+		sv_integer* w;
+
+		i = slot(u);
+		if(!key[i]) used++;
+		key[i] = u;
+		val[i] = v;
+		if(4*used <= 3*size) return;
+		s = 2*size;
+		k = new long[s];
+		w = new sv_integer[s];
+		for(i = 0; i < s; i++) k[i] = 0;
+		for(i = 0; i < size; i++)
+		{
+			if(!key[i]) continue;
+			j = (sv_integer)(((unsigned long)key[i] >> 4) ^ ((unsigned long)key[i] >> 11)) & (s - 1);
+			while(k[j]) j = (j + 1) & (s - 1);
+			k[j] = key[i];
+			w[j] = val[i];
+		}
+		delete [] key;
+		delete [] val;
+		key = k;
+		val = w;
+		size = s;
+	}
+};
+
+// The number of nodes in s not seen before
+
+sv_integer sv_set_tree::count(const sv_set& s, index* x) const
+{
+	if(x->find(s.unique()) >= 0) return(0);
+	x->put(s.unique(), 0);
+	if(s.contents() <= 1) return(1);
+	return(1 + count(s.child_1(), x) + count(s.child_2(), x));
+}
+
+// Put s and its children in the nodes from *j on, unless they're there
+// already, and move *j on past them; return s's node
+
+sv_integer sv_set_tree::add(const sv_set& s, sv_integer* j, index* x)
+{
+	sv_integer i = x->find(s.unique());
+	node* n;
+
+	if(i >= 0) return(i);
+	i = (*j)++;
+	x->put(s.unique(), i);
+	n = &nd[i];
+	n->s = s;
+	n->contents = s.contents();
+	n->c_1 = -1;
+	n->c_2 = -1;
+	switch(n->contents)
+	{
+	case SV_EVERYTHING:
+	case SV_NOTHING:
+		break;
+
+	case 1:
+		n->p = s.primitive();
+		break;
+
+	default:
+		n->op = s.op();
+		n->c_1 = add(s.child_1(), j, x);
+		n->c_2 = add(s.child_2(), j, x);
+	}
+	return(i);
+}
+
+sv_set_tree::sv_set_tree(const sv_set_list& s)
+{
+	sv_set_list l = s;
+	sv_integer i;
+	index* x = new index;
+
+	sl = s;
+	sets = 0;
+	nodes = 0;
+	while(l.exists())
+	{
+		nodes = nodes + count(l.set(), x);
+		sets++;
+		l = l.next();
+	}
+	delete x;
+	nd = new node[max(nodes, (sv_integer)1)];
+	root = new sv_integer[max(sets, (sv_integer)1)];
+
+	x = new index;
+	l = s;
+	nodes = 0;
+	for(i = 0; i < sets; i++)
+	{
+		root[i] = add(l.set(), &nodes, x);
+		l = l.next();
+	}
+	delete x;
+}
+
+sv_set_tree::~sv_set_tree()
+{
+	delete [] nd;
+	delete [] root;
+}
+
+// Prune node i, recording what happens in st; return the contents of
+// the result.  This follows sv_set::prune(const sv_box&) exactly.
+
+sv_integer sv_set_tree::prune_r(sv_integer i, sv_range_memo& memo, unsigned char* st) const
+{
+	const node* n = &nd[i];
+	sv_integer r1, r2, settled, identity;
+
+	switch(n->contents)
+	{
+	case SV_EVERYTHING:
+	case SV_NOTHING:
+		st[i] = SV_PT_KEEP;
+		return(n->contents);
+
+	case 1:
+		switch(memo.range(n->p).member())
+		{
+		case SV_AIR:
+			st[i] = SV_PT_NOTHING;
+			return(SV_NOTHING);
+		case SV_SURFACE:
+			st[i] = SV_PT_KEEP;
+			return(1);
+		case SV_SOLID:
+			st[i] = SV_PT_EVERYTHING;
+			return(SV_EVERYTHING);
+		default:
+			svlis_error("sv_set_tree::prune_r", "dud mem test", SV_CORRUPT);
+		}
+		st[i] = SV_PT_KEEP;
+		return(1);
+
+	default:
+		break;
+	}
+
+	if(n->s.misses(memo.box()))
+	{
+		st[i] = SV_PT_NOTHING;
+		return(SV_NOTHING);
+	}
+
+// For a union, an EVERYTHING from child 1 is the answer and a NOTHING
+// means the answer is child 2's; the other way round for an
+// intersection.
+
+	if (n->op == SV_UNION)
+	{
+		settled = SV_EVERYTHING;
+		identity = SV_NOTHING;
+	} else
+	{
+		settled = SV_NOTHING;
+		identity = SV_EVERYTHING;
+	}
+
+	r1 = prune_r(n->c_1, memo, st);
+	if(r1 == settled)
+	{
+		st[i] = SV_PT_CHILD_1;
+		return(r1);
+	}
+	r2 = prune_r(n->c_2, memo, st);
+	if(r1 == identity)
+	{
+		st[i] = SV_PT_CHILD_2;
+		return(r2);
+	}
+	if((st[n->c_1] == SV_PT_KEEP) && (st[n->c_2] == SV_PT_KEEP))
+	{
+		st[i] = SV_PT_KEEP;
+		return(n->contents);
+	}
+	st[i] = SV_PT_BOTH;
+	if(r2 == settled) return(settled);
+	if(r2 == identity) return(r1);
+	return(r1 + r2);
+}
+
+void sv_set_tree::prune(const sv_box& b, sv_prune_mask* m) const
+{
+	sv_integer i, c;
+	sv_range_memo r(b);
+
+	if(m->n < nodes)
+	{
+		delete [] m->state;
+		m->state = new unsigned char[nodes];
+		m->n = nodes;
+	}
+	m->b = b;
+	m->cts = 0;
+	for(i = 0; i < sets; i++)
+	{
+		c = prune_r(root[i], r, m->state);
+		if(c > 0) m->cts = m->cts + c;
+	}
+
+// Regularizing can change the contents in ways the mask can't see, so
+// then the list is built from the mask (regularizing only what's left)
+// and counted
+
+	if(reg_prune) m->cts = set_list(*m).contents();
+}
+
+// Build the result of pruning node i
+
+sv_set sv_set_tree::build(sv_integer i, const sv_prune_mask& m) const
+{
+	const node* n = &nd[i];
+	sv_set r;
+
+	switch(m.state[i])
+	{
+	case SV_PT_KEEP:
+		if(!reg_prune) return(n->s);
+		r = n->s;
+		break;
+
+	case SV_PT_NOTHING:
+		r = sv_set(SV_NOTHING);
+		break;
+
+	case SV_PT_EVERYTHING:
+		r = sv_set(SV_EVERYTHING);
+		break;
+
+	case SV_PT_CHILD_1:
+		r = build(n->c_1, m);
+		break;
+
+	case SV_PT_CHILD_2:
+		r = build(n->c_2, m);
+		break;
+
+	default:
+		if(n->op == SV_UNION)
+			r = build(n->c_1, m) | build(n->c_2, m);
+		else
+			r = build(n->c_1, m) & build(n->c_2, m);
+	}
+	if(reg_prune) r = r.regularize();
+	return(att_prune(r, n->s, m.b));
+}
+
+// The list is built in the same order as sv_set_list::prune(...) does
+
+sv_set_list sv_set_tree::build_list(sv_integer i, const sv_prune_mask& m) const
+{
+	if(i >= sets - 1) return(sv_set_list(build(root[i], m)));
+	return(merge(build_list(i + 1, m), build(root[i], m)));
+}
+
+sv_set_list sv_set_tree::set_list(const sv_prune_mask& m) const
+{
+	sv_set_list result;
+
+	if(!sets)
+	{
+		svlis_error("sv_set_tree::set_list","attempt to prune undefined set list",
+				SV_WARNING);
+		return(result);
+	}
+	return(build_list(0, m));
+}
+
 // Return all the elements of a set list as a union or intersection
 
 sv_set sv_set_list::unite() const
@@ -61,6 +61,9 @@
 #include "enum_def.h"
 #include "sums.h"
 #include "flag.h"
+#ifdef SV_UNIX
+ #include <sys/time.h>
+#endif
 #if macintosh
  #pragma export on
 #endif
@@ -96,6 +99,20 @@ sv_real ran_real()
         return((sv_real)ran_int()/(sv_real)BIG_INT);
 }
 
+// Wall-clock time; clock() is the best that can be done portably, and
+// on some systems that's processor time
+
+double sv_wall_time()
+{
+#ifdef SV_UNIX
+	struct timeval t;
+	gettimeofday(&t, 0);
+	return((double)t.tv_sec + 1.0e-6*(double)t.tv_usec);
+#else
+	return((double)clock()/(double)CLOCKS_PER_SEC);
+#endif
+}
+
 
 
 // a^b
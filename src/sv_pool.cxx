@@ -0,0 +1,398 @@
+/* 
+ *  The SvLis Geometric Modelling Kernel
+ *  ------------------------------------
+ *
+ *  Copyright (C) 1993, 1997, 1998, 2000 
+ *  University of Bath & Information Geometers Ltd
+ *
+ *  http://www.bath.ac.uk/
+ *  http://www.inge.com/
+ *
+ *  Principal author:
+ *
+ *     Adrian Bowyer
+ *     Department of Mechanical Engineering
+ *     Faculty of Engineering and Design
+ *     University of Bath
+ *     Bath BA2 7AY
+ *     U.K.
+ *
+ *     e-mail: A.Bowyer@bath.ac.uk
+ *        web: http://www.bath.ac.uk/~ensab/
+ *
+ *   SvLis is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   Licence as published by the Free Software Foundation; either
+ *   version 2 of the Licence, or (at your option) any later version.
+ *
+ *   SvLis is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public Licence for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   Licence along with svLis; if not, write to the Free
+ *   Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA,
+ *   or see
+ *
+ *      http://www.gnu.org/
+ * 
+ * =====================================================================
+ *
+ * SvLis - a persistent work-stealing pool of threads
+ *
+ * See the svLis web site for the manual and other details:
+ *
+ *    http://www.bath.ac.uk/~ensab/G_mod/Svlis/
+ *
+ * or see the file
+ *
+ *    docs/svlis.html
+ *
+ * First version: 18 October 2026
+ * This version: 18 October 2026
+ *
+ */
+
+#include "sv_std.h"
+#include "enum_def.h"
+#include "flag.h"
+#include "sums.h"
+#include "geometry.h"
+#include "interval.h"
+#include "sv_b_cls.h"
+#include "sv_pool.h"
+#if macintosh
+ #pragma export on
+#endif
+
+// Compilers without atomic builtins share one lock for reference counts
+
+#ifndef __GNUC__
+sv_lock sv_atomic_lock;
+#endif
+
+// A task is just a function, its argument, and the group it belongs to
+
+struct sv_task
+{
+	sv_task_fn fn;
+	void* arg;
+	sv_task_group* g;
+};
+
+#ifdef SV_UNIX
+
+// Length of each thread's deque; if a deque fills up, tasks
+// are run at once by the thread that spawns them
+
+#define SV_DEQUE 1024
+
+struct sv_deque
+{
+	sv_lock l;
+	sv_task t[SV_DEQUE];
+	sv_integer top;		// Thieves take from here
+	sv_integer bottom;	// The owner pushes and pops here
+};
+
+static sv_integer threads = 0;		// Threads doing work; 0 means not decided yet
+static sv_integer running = 0;		// Pool threads actually started (see pool_running())
+static sv_deque* deques = 0;		// One per pool thread, plus deque 0 for all other threads
+static pthread_t* pool_thread = 0;
+static pthread_key_t self_key;
+static sv_integer key_made = 0;
+
+// The pool lock protects the counts below and all the task groups' 
+// pending counts; the start lock serializes starting and stopping
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static sv_integer queued = 0;		// Tasks sitting in deques
+static sv_integer sleepers = 0;		// Threads waiting on pool_wake
+static sv_integer quit = 0;
+
+// How many pool threads there are.  This is only set under the start
+// lock, once all the threads have been made (or before they're stopped),
+// but it's read without any lock, so it's set and read atomically.
+
+static sv_integer pool_running() { return(sv_atomic_get(&running)); }
+
+static sv_integer processors()
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if(n < 1) n = 1;
+	return((sv_integer)n);
+}
+
+// Which deque belongs to the calling thread
+
+static sv_integer self()
+{
+	return((sv_integer)(long)pthread_getspecific(self_key));
+}
+
+// Put a task on the bottom of the caller's deque; 0 if it's full
+
+static int push(const sv_task& t)
+{
+	sv_deque* d = &deques[self()];
+	int ok = 0;
+
+	d->l.shut();
+	if(d->bottom - d->top < SV_DEQUE)
+	{
+		d->t[d->bottom % SV_DEQUE] = t;
+		d->bottom++;
+		ok = 1;
+	}
+	d->l.open();
+	return(ok);
+}
+
+// Get a task from the bottom of our own deque or, failing that,
+// steal one from the top of someone else's
+
+static int take(sv_task* t)
+{
+	sv_integer me = self();
+	sv_integer n = pool_running();
+	sv_deque* d = &deques[me];
+	sv_integer i;
+	int got = 0;
+
+	d->l.shut();
+	if(d->bottom > d->top)
+	{
+		d->bottom--;
+		*t = d->t[d->bottom % SV_DEQUE];
+		got = 1;
+	}
+	d->l.open();
+
+	for(i = 1; !got && (i <= n); i++)
+	{
+		d = &deques[(me + i) % (n + 1)];
+		d->l.shut();
+		if(d->bottom > d->top)
+		{
+			*t = d->t[d->top % SV_DEQUE];
+			d->top++;
+			got = 1;
+		}
+		d->l.open();
+	}
+
+	if(got)
+	{
+		pthread_mutex_lock(&pool_lock);
+		queued--;
+		pthread_mutex_unlock(&pool_lock);
+	}
+	return(got);
+}
+
+// Run a task and tell its group
+
+void sv_run_task(const sv_task& t)
+{
+	(*t.fn)(t.arg);
+	pthread_mutex_lock(&pool_lock);
+	t.g->pending--;
+	if(!t.g->pending && sleepers) pthread_cond_broadcast(&pool_wake);
+	pthread_mutex_unlock(&pool_lock);
+}
+
+// What the pool threads do all day
+
+static void* sv_worker(void* vi)
+{
+	sv_task t;
+
+	pthread_setspecific(self_key, vi);
+	for(;;)
+	{
+		if(take(&t))
+		{
+			sv_run_task(t);
+			continue;
+		}
+		pthread_mutex_lock(&pool_lock);
+		if(quit)
+		{
+			pthread_mutex_unlock(&pool_lock);
+			return(0);
+		}
+		if(queued <= 0)
+		{
+			sleepers++;
+			pthread_cond_wait(&pool_wake, &pool_lock);
+			sleepers--;
+		}
+		pthread_mutex_unlock(&pool_lock);
+	}
+}
+
+// Start the pool threads
+
+static void sv_pool_start()
+{
+	sv_integer i;
+
+	pthread_mutex_lock(&start_lock);
+	if(!pool_running() && (threads > 1))
+	{
+		if(!key_made)
+		{
+			if(pthread_key_create(&self_key, 0))
+			{
+				svlis_error("sv_pool_start","can't create thread key",SV_WARNING);
+				pthread_mutex_unlock(&start_lock);
+				return;
+			}
+			key_made = 1;
+		}
+		deques = new sv_deque[threads];
+		for(i = 0; i < threads; i++)
+		{
+			deques[i].top = 0;
+			deques[i].bottom = 0;
+		}
+		pool_thread = new pthread_t[threads - 1];
+		quit = 0;
+		for(i = 0; i < threads - 1; i++)
+		{
+			if(pthread_create(&pool_thread[i], 0, sv_worker, (void*)(long)(i + 1)))
+			{
+				svlis_error("sv_pool_start","can't create thread",SV_WARNING);
+				break;
+			}
+		}
+		sv_atomic_set(&running, i);
+	}
+	pthread_mutex_unlock(&start_lock);
+}
+
+// Stop the pool threads
+
+void sv_pool_end()
+{
+	sv_integer i, n;
+
+	pthread_mutex_lock(&start_lock);
+	if((n = pool_running()))
+	{
+		pthread_mutex_lock(&pool_lock);
+		quit = 1;
+		pthread_cond_broadcast(&pool_wake);
+		pthread_mutex_unlock(&pool_lock);
+		sv_atomic_set(&running, 0);
+		for(i = 0; i < n; i++)
+			if(pthread_join(pool_thread[i], 0))
+				svlis_error("sv_pool_end","can't join thread",SV_WARNING);
+		delete [] pool_thread;
+		delete [] deques;
+		pool_thread = 0;
+		deques = 0;
+		quit = 0;
+	}
+	pthread_mutex_unlock(&start_lock);
+}
+
+void set_worker_threads(sv_integer n)
+{
+	sv_pool_end();
+	if(n < 1) n = 1;
+	threads = n;
+}
+
+sv_integer get_worker_threads()
+{
+	if(!threads) threads = processors();
+	return(threads);
+}
+
+void sv_task_group::run(sv_task_fn fn, void* arg)
+{
+	sv_task t;
+
+	if(!pool_running() && (get_worker_threads() > 1)) sv_pool_start();
+	if(!pool_running())
+	{
+		(*fn)(arg);
+		return;
+	}
+
+	t.fn = fn;
+	t.arg = arg;
+	t.g = this;
+
+	pthread_mutex_lock(&pool_lock);
+	pending++;
+	pthread_mutex_unlock(&pool_lock);
+
+	if(!push(t))
+	{
+		pthread_mutex_lock(&pool_lock);
+		pending--;
+		pthread_mutex_unlock(&pool_lock);
+		(*fn)(arg);
+		return;
+	}
+
+	pthread_mutex_lock(&pool_lock);
+	queued++;
+	if(sleepers) pthread_cond_signal(&pool_wake);
+	pthread_mutex_unlock(&pool_lock);
+}
+
+void sv_task_group::wait()
+{
+	sv_task t;
+
+	if(!pool_running()) return;
+
+	for(;;)
+	{
+		pthread_mutex_lock(&pool_lock);
+		if(!pending)
+		{
+			pthread_mutex_unlock(&pool_lock);
+			return;
+		}
+		pthread_mutex_unlock(&pool_lock);
+
+		if(take(&t))
+		{
+			sv_run_task(t);
+			continue;
+		}
+
+		pthread_mutex_lock(&pool_lock);
+		if(pending && (queued <= 0))
+		{
+			sleepers++;
+			pthread_cond_wait(&pool_wake, &pool_lock);
+			sleepers--;
+		}
+		pthread_mutex_unlock(&pool_lock);
+	}
+}
+
+#else
+
+// No threads - everything runs serially in the caller
+
+void sv_run_task(const sv_task& t) { (*t.fn)(t.arg); }
+void sv_task_group::run(sv_task_fn fn, void* arg) { (*fn)(arg); }
+void sv_task_group::wait() { }
+void set_worker_threads(sv_integer n) { }
+sv_integer get_worker_threads() { return(1); }
+void sv_pool_end() { }
+
+#endif
+
+#if macintosh
+ #pragma export off
+#endif
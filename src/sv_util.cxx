@@ -733,8 +733,7 @@ sv_point newton(const sv_primitive& a, sv_point p, sv_real accy)
 
 	while( (fabs(v) > accy) && (count <= MAXIT) )
 	{
-		g = a.grad(p);
-		v = a.value(p);
+		g = a.grad(p, v);
 		gv = g*g;
 		if (gv >= nasty) p = p - g*(v/gv);
 		count++;
@@ -876,9 +875,8 @@ sv_point newton_line(const sv_primitive& a, sv_point p0, const sv_point& p1, sv_
 
 	while( (fabs(v) > accy) && (count <= MAXIT) )
 	{
-		g = a.grad(p0);
+		g = a.grad(p0, v);
 		g = dir*(g*dir);
-		v = a.value(p0);
 		gv = g*g;
 		if (gv >= nasty) p0 = p0 - g*(v/gv);
 		count++;
@@ -58,6 +58,7 @@
 #include "enum_def.h" 
 #include "sums.h" 
 #include "flag.h" 
+#include "sv_pool.h" 
 #if macintosh 
  #pragma export on 
 #endif 
@@ -90,6 +91,10 @@ int svlis_end(int i)
     cout << "SvLis: type any character to finish: "; 
     cin >> dummy;
 
+// Let the worker threads go
+
+    sv_pool_end();
+
 // SvLis has left the building...
 
     return(i);
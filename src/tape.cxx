@@ -0,0 +1,2158 @@
+/* 
+ *  The SvLis Geometric Modelling Kernel
+ *  ------------------------------------
+ *
+ *  Copyright (C) 1993, 1997, 1998, 2000 
+ *  University of Bath & Information Geometers Ltd
+ *
+ *  http://www.bath.ac.uk/
+ *  http://www.inge.com/
+ *
+ *  Principal author:
+ *
+ *     Adrian Bowyer
+ *     Department of Mechanical Engineering
+ *     Faculty of Engineering and Design
+ *     University of Bath
+ *     Bath BA2 7AY
+ *     U.K.
+ *
+ *     e-mail: A.Bowyer@bath.ac.uk
+ *        web: http://www.bath.ac.uk/~ensab/
+ *
+ *   SvLis is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   Licence as published by the Free Software Foundation; either
+ *   version 2 of the Licence, or (at your option) any later version.
+ *
+ *   SvLis is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public Licence for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   Licence along with svLis; if not, write to the Free
+ *   Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA,
+ *   or see
+ *
+ *      http://www.gnu.org/
+ * 
+ * =====================================================================
+ *
+ * SvLis - primitives compiled into flat evaluation tapes
+ *
+ * See the svLis web site for the manual and other details:
+ *
+ *    http://www.bath.ac.uk/~ensab/G_mod/Svlis/
+ *
+ * or see the file
+ *
+ *    docs/svlis.html
+ *
+ * First version: 18 October 2026
+ * This version: 18 October 2026
+ *
+ */
+
+#include "sv_std.h"
+#include "enum_def.h"
+#include "flag.h"
+#include "sums.h"
+#include "geometry.h"
+#include "interval.h"
+#include "sv_b_cls.h"
+#include "prim.h"
+#include "tape.h"
+#if macintosh
+ #pragma export on
+#endif
+
+// Working storage while a tape is compiled.  The number of registers
+// each node needs is remembered (keyed by the node's unique value) so
+// that compiling long chains isn't quadratic.
+
+struct sv_tape_build
+{
+	sv_tape_step* step;
+	sv_integer steps, step_len;
+	sv_plane* plane;
+	sv_integer planes, plane_len;
+	long* key;
+	sv_integer* val;
+	sv_integer memo_len, memo_used;
+
+	sv_tape_build()
+	{
+		steps = 0; step_len = 64; step = new sv_tape_step[step_len];
+		planes = 0; plane_len = 16; plane = new sv_plane[plane_len];
+		memo_used = 0; memo_len = 0; key = 0; val = 0;
+		grow_memo();
+	}
+
+	~sv_tape_build()
+	{
+		delete [] step;
+		delete [] plane;
+		delete [] key;
+		delete [] val;
+	}
+
+	void grow_memo();
+	sv_integer* memo(long);
+	void add(sv_integer, sv_integer, sv_integer, sv_integer, sv_real, sv_integer);
+	sv_integer add_plane(const sv_plane&);
+	sv_integer need(const sv_primitive&);
+	void emit(const sv_primitive&, sv_integer);
+};
+
+// The memo is an open hash table; 0 keys are empty slots
+
+void sv_tape_build::grow_memo()
+{
+	long* ok = key;
+	sv_integer* ov = val;
+	sv_integer ol = memo_len;
+	sv_integer i;
+
+	memo_len = ol ? 2*ol : 256;
+	key = new long[memo_len];
+	val = new sv_integer[memo_len];
+	for(i = 0; i < memo_len; i++) key[i] = 0;
+	memo_used = 0;
+	for(i = 0; i < ol; i++)
+		if(ok[i]) *memo(ok[i]) = ov[i];
+	delete [] ok;
+	delete [] ov;
+}
+
+// Return the slot for a node, making it (set to 0) if it's new
+
+sv_integer* sv_tape_build::memo(long k)
+{
+	sv_integer i;
+
+	if(2*(memo_used + 1) > memo_len) grow_memo();
+	i = (sv_integer)(((unsigned long)k >> 4) % (unsigned long)memo_len);
+	while(key[i] && (key[i] != k)) i = (i + 1) % memo_len;
+	if(!key[i])
+	{
+		key[i] = k;
+		val[i] = 0;
+		memo_used++;
+	}
+	return(&val[i]);
+}
+
+void sv_tape_build::add(sv_integer c, sv_integer d, sv_integer a, sv_integer b, 
+	sv_real k, sv_integer i)
+{
+	sv_tape_step* ns;
+	sv_integer j;
+
+	if(steps >= step_len)
+	{
+		ns = new sv_tape_step[2*step_len];
+		for(j = 0; j < steps; j++) ns[j] = step[j];
+		delete [] step;
+		step = ns;
+		step_len = 2*step_len;
+	}
+	step[steps].code = c;
+	step[steps].d = d;
+	step[steps].a = a;
+	step[steps].b = b;
+	step[steps].k = k;
+	step[steps].i = i;
+	steps++;
+}
+
+sv_integer sv_tape_build::add_plane(const sv_plane& f)
+{
+	sv_plane* np;
+	sv_integer j;
+
+	if(planes >= plane_len)
+	{
+		np = new sv_plane[2*plane_len];
+		for(j = 0; j < planes; j++) np[j] = plane[j];
+		delete [] plane;
+		plane = np;
+		plane_len = 2*plane_len;
+	}
+	plane[planes] = f;
+	return(planes++);
+}
+
+// Kinds that are evaluated by applying their operator to their children
+
+static int compound(const sv_primitive& p)
+{
+	switch(p.kind())
+	{
+	case SV_PLANE:
+		return(p.op() != SV_ZERO);
+
+	case SV_CYLINDER:
+	case SV_SPHERE:
+	case SV_CONE:
+	case SV_TORUS:
+	case SV_CYCLIDE:
+	case SV_GENERAL:
+		return(1);
+
+	default:
+		return(0);
+	}
+}
+
+// The number of registers needed to evaluate p, or -1 if p can't
+// go on a tape.  The cases left out are the odd ones (real+real etc)
+// for which sv_primitive::range(...) issues warnings; they are left
+// to it.
+
+sv_integer sv_tape_build::need(const sv_primitive& p)
+{
+	sv_integer* m;
+	sv_integer n, n1, n2;
+	int c_1, c_2;
+	prim_op o;
+
+	if(p.kind() == SV_REAL) return(-1);	// Only allowed as a real argument
+	if(!compound(p)) return(1);		// Plane or user primitive
+
+	m = memo(p.unique());
+	if(*m) return(*m);
+
+	o = p.op();
+	if(diadic(o))
+	{
+		c_1 = (p.child_1().kind() == SV_REAL);
+		c_2 = (p.child_2().kind() == SV_REAL);
+		switch(o)
+		{
+		case SV_PLUS:
+		case SV_MINUS:
+		case SV_TIMES:
+			if(c_1 && c_2)
+				n = -1;
+			else if(c_1)
+				n = need(p.child_2());
+			else if(c_2)
+				n = need(p.child_1());
+			else
+			{
+				n1 = need(p.child_1());
+				n2 = need(p.child_2());
+				if((n1 < 0) || (n2 < 0))
+					n = -1;
+				else if(n1 == n2)
+					n = n1 + 1;
+				else
+					n = max(n1, n2);
+			}
+			break;
+
+		case SV_DIVIDE:
+		case SV_POW:
+			if(c_1 || !c_2)
+				n = -1;
+			else
+				n = need(p.child_1());
+			break;
+
+		default:
+			n = -1;
+		}
+	} else
+	{
+		switch(o)
+		{
+		case SV_COMP:
+		case SV_ABS:
+		case SV_SIN:
+		case SV_COS:
+		case SV_EXP:
+		case SV_SSQRT:
+		case SV_SIGN:
+			n = need(p.child_1());
+			break;
+
+		default:
+			n = -1;
+		}
+	}
+
+// need() may have grown the memo, so look the slot up again
+
+	*memo(p.unique()) = n;
+	return(n);
+}
+
+// Put the steps to evaluate p into register r on the tape.  Registers
+// above r are free for working.  The child needing more registers
+// is done first, which keeps the total to a minimum.
+
+void sv_tape_build::emit(const sv_primitive& p, sv_integer r)
+{
+	sv_primitive c1, c2;
+	sv_integer k = p.kind();
+	prim_op o;
+
+	if(!compound(p))
+	{
+		if(k == SV_PLANE)
+			add(SVTP_PLANE, r, 0, 0, 0, add_plane(p.plane()));
+		else
+			add(SVTP_USER, r, 0, 0, 0, k);
+		return;
+	}
+
+	o = p.op();
+	c1 = p.child_1();
+	if(!diadic(o))
+	{
+		emit(c1, r);
+		switch(o)
+		{
+		case SV_COMP: add(SVTP_COMP, r, r, 0, 0, 0); break;
+		case SV_ABS: add(SVTP_ABS, r, r, 0, 0, 0); break;
+		case SV_SIN: add(SVTP_SIN, r, r, 0, 0, 0); break;
+		case SV_COS: add(SVTP_COS, r, r, 0, 0, 0); break;
+		case SV_EXP: add(SVTP_EXP, r, r, 0, 0, 0); break;
+		case SV_SSQRT: add(SVTP_SSQRT, r, r, 0, 0, 0); break;
+		case SV_SIGN: add(SVTP_SIGN, r, r, 0, 0, 0); break;
+		default:
+			svlis_error("sv_tape_build::emit", "dud operator", SV_CORRUPT);
+		}
+		return;
+	}
+
+	c2 = p.child_2();
+	if(c1.kind() == SV_REAL)
+	{
+		emit(c2, r);
+		switch(o)
+		{
+		case SV_PLUS: add(SVTP_K_PLUS, r, r, 0, c1.real(), 0); break;
+		case SV_MINUS: add(SVTP_K_MINUS, r, r, 0, c1.real(), 0); break;
+		case SV_TIMES: add(SVTP_K_TIMES, r, r, 0, c1.real(), 0); break;
+		default:
+			svlis_error("sv_tape_build::emit", "dud operator", SV_CORRUPT);
+		}
+		return;
+	}
+
+	if(c2.kind() == SV_REAL)
+	{
+		emit(c1, r);
+		switch(o)
+		{
+		case SV_PLUS: add(SVTP_PLUS_K, r, r, 0, c2.real(), 0); break;
+		case SV_MINUS: add(SVTP_MINUS_K, r, r, 0, c2.real(), 0); break;
+		case SV_TIMES: add(SVTP_TIMES_K, r, r, 0, c2.real(), 0); break;
+		case SV_DIVIDE: add(SVTP_DIVIDE_K, r, r, 0, c2.real(), 0); break;
+		case SV_POW: add(SVTP_POW, r, r, 0, 0, round(c2.real())); break;
+		default:
+			svlis_error("sv_tape_build::emit", "dud operator", SV_CORRUPT);
+		}
+		return;
+	}
+
+// The square of one node (as p*p makes) is only worked out once, and
+// it's flagged by using the same register twice so that the affine
+// form can use its tighter square
+
+	if((o == SV_TIMES) && (c1.unique() == c2.unique()))
+	{
+		emit(c1, r);
+		add(SVTP_TIMES, r, r, r, 0, 0);
+		return;
+	}
+
+	sv_integer a, b;
+	if(need(c1) >= need(c2))
+	{
+		emit(c1, r);
+		emit(c2, r + 1);
+		a = r;
+		b = r + 1;
+	} else
+	{
+		emit(c2, r);
+		emit(c1, r + 1);
+		a = r + 1;
+		b = r;
+	}
+	switch(o)
+	{
+	case SV_PLUS: add(SVTP_PLUS, r, a, b, 0, 0); break;
+	case SV_MINUS: add(SVTP_MINUS, r, a, b, 0, 0); break;
+	case SV_TIMES: add(SVTP_TIMES, r, a, b, 0, 0); break;
+	default:
+		svlis_error("sv_tape_build::emit", "dud operator", SV_CORRUPT);
+	}
+}
+
+sv_prim_tape::sv_prim_tape()
+{
+	step = 0;
+	steps = 0;
+	plane = 0;
+	planes = 0;
+	regs = 0;
+	user_steps = 0;
+	rough_steps = 0;
+	poly = 0;
+}
+
+sv_prim_tape::~sv_prim_tape()
+{
+	delete [] step;
+	delete [] plane;
+	delete poly;
+}
+
+// Compile a primitive.  Only compound primitives are worth it.
+
+int sv_prim_tape::compile(const sv_primitive& p)
+{
+	sv_tape_build tb;
+	sv_integer i;
+
+	if(!compound(p)) return(0);
+	regs = tb.need(p);
+	if((regs < 1) || (regs > SV_TAPE_REGS)) return(0);
+	tb.emit(p, 0);
+
+	delete [] step;
+	delete [] plane;
+	steps = tb.steps;
+	step = new sv_tape_step[steps];
+	user_steps = 0;
+	rough_steps = 0;
+	for(i = 0; i < steps; i++) 
+	{
+		step[i] = tb.step[i];
+		switch(step[i].code)
+		{
+		case SVTP_USER: 
+			user_steps++;	// NO break here
+		case SVTP_ABS:
+		case SVTP_SSQRT:
+		case SVTP_SIGN:
+			rough_steps++;
+		}
+	}
+	planes = tb.planes;
+	plane = new sv_plane[planes ? planes : 1];
+	for(i = 0; i < planes; i++) plane[i] = tb.plane[i];
+	return(1);
+}
+
+// Value of the tape for a point.  The arithmetic is written exactly
+// as it is in sv_primitive::value(...) so the answers are identical.
+
+sv_real sv_prim_tape::value(const sv_point& q) const
+{
+	sv_real r[SV_TAPE_REGS];
+	const sv_tape_step* s = step;
+	const sv_tape_step* e = step + steps;
+
+	for(; s < e; s++)
+	{
+		switch(s->code)
+		{
+		case SVTP_PLANE: r[s->d] = plane[s->i].value(q); break;
+		case SVTP_USER: 
+			if (s->i < S_U_PRIM)
+				r[s->d] = value_s(s->i, q);
+			else
+				r[s->d] = value_user(s->i, q);
+			break;
+		case SVTP_PLUS: r[s->d] = r[s->a] + r[s->b]; break;
+		case SVTP_PLUS_K: r[s->d] = r[s->a] + s->k; break;
+		case SVTP_K_PLUS: r[s->d] = s->k + r[s->a]; break;
+		case SVTP_MINUS: r[s->d] = r[s->a] - r[s->b]; break;
+		case SVTP_MINUS_K: r[s->d] = r[s->a] - s->k; break;
+		case SVTP_K_MINUS: r[s->d] = s->k - r[s->a]; break;
+		case SVTP_TIMES: r[s->d] = r[s->a]*r[s->b]; break;
+		case SVTP_TIMES_K: r[s->d] = r[s->a]*s->k; break;
+		case SVTP_K_TIMES: r[s->d] = s->k*r[s->a]; break;
+		case SVTP_DIVIDE_K: r[s->d] = r[s->a]/s->k; break;
+		case SVTP_POW: r[s->d] = pow(r[s->a], s->i); break;
+		case SVTP_COMP: r[s->d] = -(r[s->a]); break;
+		case SVTP_ABS: r[s->d] = fabs(r[s->a]); break;
+		case SVTP_SIN: r[s->d] = (sv_real)sin(r[s->a]); break;
+		case SVTP_COS: r[s->d] = (sv_real)cos(r[s->a]); break;
+		case SVTP_EXP: r[s->d] = (sv_real)exp(r[s->a]); break;
+		case SVTP_SSQRT: r[s->d] = s_sqrt(r[s->a]); break;
+		case SVTP_SIGN: r[s->d] = sign(r[s->a]); break;
+		default:
+			svlis_error("sv_prim_tape::value", "dud step", SV_CORRUPT);
+		}
+	}
+	return(r[0]);
+}
+
+// Range of the tape over a box, again exactly as sv_primitive::range(...)
+
+sv_interval sv_prim_tape::range(const sv_box& b) const
+{
+	sv_interval r[SV_TAPE_REGS];
+	const sv_tape_step* s = step;
+	const sv_tape_step* e = step + steps;
+
+	for(; s < e; s++)
+	{
+		switch(s->code)
+		{
+		case SVTP_PLANE: r[s->d] = plane[s->i].range(b); break;
+		case SVTP_USER: 
+			if (s->i < S_U_PRIM)
+				r[s->d] = range_s(s->i, b);
+			else
+				r[s->d] = range_user(s->i, b);
+			break;
+		case SVTP_PLUS: r[s->d] = r[s->a] + r[s->b]; break;
+		case SVTP_PLUS_K: r[s->d] = r[s->a] + s->k; break;
+		case SVTP_K_PLUS: r[s->d] = s->k + r[s->a]; break;
+		case SVTP_MINUS: r[s->d] = r[s->a] - r[s->b]; break;
+		case SVTP_MINUS_K: r[s->d] = r[s->a] - s->k; break;
+		case SVTP_K_MINUS: r[s->d] = s->k - r[s->a]; break;
+		case SVTP_TIMES: r[s->d] = r[s->a]*r[s->b]; break;
+		case SVTP_TIMES_K: r[s->d] = r[s->a]*s->k; break;
+		case SVTP_K_TIMES: r[s->d] = s->k*r[s->a]; break;
+		case SVTP_DIVIDE_K: r[s->d] = r[s->a]/s->k; break;
+		case SVTP_POW: r[s->d] = pow(r[s->a], s->i); break;
+		case SVTP_COMP: r[s->d] = -(r[s->a]); break;
+		case SVTP_ABS: r[s->d] = abs(r[s->a]); break;
+		case SVTP_SIN: r[s->d] = sin(r[s->a]); break;
+		case SVTP_COS: r[s->d] = cos(r[s->a]); break;
+		case SVTP_EXP: r[s->d] = exp(r[s->a]); break;
+		case SVTP_SSQRT: r[s->d] = s_sqrt(r[s->a]); break;
+		case SVTP_SIGN: r[s->d] = sign(r[s->a]); break;
+		default:
+			svlis_error("sv_prim_tape::range", "dud step", SV_CORRUPT);
+		}
+	}
+	return(r[0]);
+}
+
+// Value and grad together by forward-mode differentiation: each 
+// register carries a value and its three partial derivatives, so no grad
+// primitives need be built.  The rules are the ones lazy_grad(...) uses
+// to build the grad trees, quirks included: the grad of |a| is the grad
+// of a times sign(|a|), s_sqrt passes its argument's grad straight 
+// through, and sign has no grad.  User primitives have no grads, so a
+// tape with any of them can't do this and 0 is returned.
+
+struct sv_tape_dual
+{
+	sv_real v;
+	sv_point g;
+};
+
+int sv_prim_tape::grad(const sv_point& q, sv_real* v, sv_point* g) const
+{
+	sv_tape_dual r[SV_TAPE_REGS];
+	const sv_tape_step* s = step;
+	const sv_tape_step* e = step + steps;
+	sv_tape_dual* d;
+	sv_tape_dual* a;
+	sv_tape_dual* b;
+	sv_real c;
+
+	if(user_steps) return(0);
+
+	for(; s < e; s++)
+	{
+		d = &r[s->d];
+		a = &r[s->a];
+		b = &r[s->b];
+		switch(s->code)
+		{
+		case SVTP_PLANE: 
+			d->v = plane[s->i].value(q); 
+			d->g = plane[s->i].normal;
+			break;
+		case SVTP_PLUS: 
+			d->v = a->v + b->v; 
+			d->g = a->g + b->g; 
+			break;
+		case SVTP_PLUS_K: d->v = a->v + s->k; d->g = a->g; break;
+		case SVTP_K_PLUS: d->v = s->k + a->v; d->g = a->g; break;
+		case SVTP_MINUS: 
+			d->v = a->v - b->v; 
+			d->g = a->g - b->g; 
+			break;
+		case SVTP_MINUS_K: d->v = a->v - s->k; d->g = a->g; break;
+		case SVTP_K_MINUS: d->v = s->k - a->v; d->g = -a->g; break;
+		case SVTP_TIMES: 
+			d->g = b->g*a->v + a->g*b->v;
+			d->v = a->v*b->v;
+			break;
+		case SVTP_TIMES_K: d->v = a->v*s->k; d->g = a->g*s->k; break;
+		case SVTP_K_TIMES: d->v = s->k*a->v; d->g = a->g*s->k; break;
+		case SVTP_DIVIDE_K: d->v = a->v/s->k; d->g = a->g/s->k; break;
+		case SVTP_POW:
+			switch(s->i)
+			{
+			case 0: c = 0; break;
+			case 1: c = 1; break;
+			case 2: c = a->v*2.0; break;
+			default: c = pow(a->v, s->i - 1)*s->i;
+			}
+			d->v = pow(a->v, s->i);
+			d->g = a->g*c;
+			break;
+		case SVTP_COMP: d->v = -(a->v); d->g = -a->g; break;
+		case SVTP_ABS: 
+			d->v = fabs(a->v); 
+			d->g = a->g*sign(d->v); 
+			break;
+		case SVTP_SIN: 
+			d->g = a->g*(sv_real)cos(a->v);
+			d->v = (sv_real)sin(a->v); 
+			break;
+		case SVTP_COS: 
+			d->g = a->g*(sv_real)sin(-a->v);
+			d->v = (sv_real)cos(a->v); 
+			break;
+		case SVTP_EXP: 
+			d->v = (sv_real)exp(a->v); 
+			d->g = a->g*d->v;
+			break;
+		case SVTP_SSQRT: d->v = s_sqrt(a->v); d->g = a->g; break;
+		case SVTP_SIGN: d->v = sign(a->v); d->g = sv_point(0, 0, 0); break;
+		default:
+			svlis_error("sv_prim_tape::grad(point)", "dud step", SV_CORRUPT);
+		}
+	}
+	*v = r[0].v;
+	*g = r[0].g;
+	return(1);
+}
+
+// The same in interval arithmetic, for the range of the value and grad
+// over a box
+
+struct sv_tape_idual
+{
+	sv_interval v;
+	sv_interval x, y, z;
+};
+
+int sv_prim_tape::grad(const sv_box& q, sv_interval* v, sv_box* g) const
+{
+	sv_tape_idual r[SV_TAPE_REGS];
+	const sv_tape_step* s = step;
+	const sv_tape_step* e = step + steps;
+	sv_tape_idual* d;
+	sv_tape_idual* a;
+	sv_tape_idual* b;
+	sv_interval c;
+	sv_point n;
+
+	if(user_steps) return(0);
+
+	for(; s < e; s++)
+	{
+		d = &r[s->d];
+		a = &r[s->a];
+		b = &r[s->b];
+		switch(s->code)
+		{
+		case SVTP_PLANE: 
+			d->v = plane[s->i].range(q); 
+			n = plane[s->i].normal;
+			d->x = sv_interval(n.x, n.x);
+			d->y = sv_interval(n.y, n.y);
+			d->z = sv_interval(n.z, n.z);
+			break;
+		case SVTP_PLUS: 
+			d->v = a->v + b->v; 
+			d->x = a->x + b->x;
+			d->y = a->y + b->y;
+			d->z = a->z + b->z;
+			break;
+		case SVTP_PLUS_K: *d = *a; d->v = a->v + s->k; break;
+		case SVTP_K_PLUS: *d = *a; d->v = s->k + a->v; break;
+		case SVTP_MINUS: 
+			d->v = a->v - b->v; 
+			d->x = a->x - b->x;
+			d->y = a->y - b->y;
+			d->z = a->z - b->z;
+			break;
+		case SVTP_MINUS_K: *d = *a; d->v = a->v - s->k; break;
+		case SVTP_K_MINUS: 
+			d->v = s->k - a->v; 
+			d->x = -a->x;
+			d->y = -a->y;
+			d->z = -a->z;
+			break;
+		case SVTP_TIMES: 
+			d->x = a->v*b->x + b->v*a->x;
+			d->y = a->v*b->y + b->v*a->y;
+			d->z = a->v*b->z + b->v*a->z;
+			d->v = a->v*b->v;
+			break;
+		case SVTP_TIMES_K: 
+		case SVTP_K_TIMES: 
+			d->v = a->v*s->k; 
+			d->x = a->x*s->k;
+			d->y = a->y*s->k;
+			d->z = a->z*s->k;
+			break;
+		case SVTP_DIVIDE_K: 
+			d->v = a->v/s->k; 
+			d->x = a->x/s->k;
+			d->y = a->y/s->k;
+			d->z = a->z/s->k;
+			break;
+		case SVTP_POW:
+			switch(s->i)
+			{
+			case 0: c = sv_interval(0, 0); break;
+			case 1: c = sv_interval(1, 1); break;
+			case 2: c = a->v*2.0; break;
+			default: c = pow(a->v, s->i - 1)*(sv_real)s->i;
+			}
+			d->x = a->x*c;
+			d->y = a->y*c;
+			d->z = a->z*c;
+			d->v = pow(a->v, s->i);
+			break;
+		case SVTP_COMP: 
+			d->v = -(a->v); 
+			d->x = -a->x;
+			d->y = -a->y;
+			d->z = -a->z;
+			break;
+		case SVTP_ABS: 
+			d->v = abs(a->v); 
+			c = sign(d->v);
+			d->x = a->x*c;
+			d->y = a->y*c;
+			d->z = a->z*c;
+			break;
+		case SVTP_SIN: 
+		case SVTP_COS: 
+		case SVTP_EXP: 
+			switch(s->code)
+			{
+			case SVTP_SIN: 
+				c = cos(a->v); 
+				d->v = sin(a->v); 
+				break;
+			case SVTP_COS: 
+				c = sin(-a->v); 
+				d->v = cos(a->v); 
+				break;
+			default: 
+				c = exp(a->v); 
+				d->v = c;
+			}
+			d->x = a->x*c;
+			d->y = a->y*c;
+			d->z = a->z*c;
+			break;
+		case SVTP_SSQRT: *d = *a; d->v = s_sqrt(a->v); break;
+		case SVTP_SIGN: 
+			d->v = sign(a->v); 
+			d->x = d->y = d->z = sv_interval(0, 0);
+			break;
+		default:
+			svlis_error("sv_prim_tape::grad(box)", "dud step", SV_CORRUPT);
+		}
+	}
+	*v = r[0].v;
+	*g = sv_box(r[0].x, r[0].y, r[0].z);
+	return(1);
+}
+
+// Affine arithmetic.  A value over a box is held as
+//
+//    c + x*ex + y*ey + z*ez + e*e4
+//
+// where ex, ey and ez go from -1 to 1 across the box's three axes and
+// e4 (also from -1 to 1) mops up everything that isn't linear in them.
+// Sums and real multiples of planes are exact, and a product only adds
+// the product of its arguments' radii to e4, so the correlation 
+// between the planes in a quadric (which interval arithmetic throws 
+// away) is kept.  The functions with no affine form are done in 
+// interval arithmetic on the affine range; that's never worse than
+// plain intervals.
+
+struct sv_tape_aff
+{
+	sv_real c;		// Centre
+	sv_real x, y, z;	// Linear parts
+	sv_real e;		// Non-linear part (never negative)
+};
+
+// Half of the widest spread of an affine value
+
+static inline sv_real aff_rad(const sv_tape_aff& a)
+{
+	return(fabs(a.x) + fabs(a.y) + fabs(a.z) + a.e);
+}
+
+static inline sv_interval aff_range(const sv_tape_aff& a)
+{
+	sv_real r = aff_rad(a);
+	return(sv_interval(a.c - r, a.c + r));
+}
+
+static inline void aff_interval(sv_tape_aff* d, const sv_interval& v)
+{
+	d->c = (v.lo() + v.hi())*0.5;
+	d->x = d->y = d->z = 0.0;
+	d->e = max(v.hi() - d->c, d->c - v.lo());
+}
+
+static inline void aff_scale(sv_tape_aff* d, const sv_tape_aff* a, sv_real k)
+{
+	d->c = a->c*k;
+	d->x = a->x*k;
+	d->y = a->y*k;
+	d->z = a->z*k;
+	d->e = a->e*(sv_real)fabs(k);
+}
+
+// a*b: the non-linear part is bounded by the product of the radii.
+// a*a is done separately as the square of the linear part can't be
+// negative.
+
+static inline void aff_times(sv_tape_aff* d, const sv_tape_aff* a, const sv_tape_aff* b)
+{
+	sv_real ra = aff_rad(*a);
+	sv_real rb = aff_rad(*b);
+	sv_tape_aff r;
+
+	r.c = a->c*b->c;
+	r.x = a->c*b->x + b->c*a->x;
+	r.y = a->c*b->y + b->c*a->y;
+	r.z = a->c*b->z + b->c*a->z;
+	r.e = (sv_real)fabs(a->c)*b->e + (sv_real)fabs(b->c)*a->e + ra*rb;
+	*d = r;
+}
+
+static inline void aff_square(sv_tape_aff* d, const sv_tape_aff* a)
+{
+	sv_real h = aff_rad(*a);
+	sv_tape_aff r;
+
+	h = h*h*0.5;
+	r.c = a->c*a->c + h;
+	r.x = 2*a->c*a->x;
+	r.y = 2*a->c*a->y;
+	r.z = 2*a->c*a->z;
+	r.e = 2*(sv_real)fabs(a->c)*a->e + h;
+	*d = r;
+}
+
+sv_interval sv_prim_tape::affine(const sv_box& b) const
+{
+	sv_tape_aff r[SV_TAPE_REGS];
+	const sv_tape_step* s = step;
+	const sv_tape_step* e = step + steps;
+	sv_tape_aff* d;
+	sv_tape_aff* a;
+	sv_tape_aff p;
+	sv_point cen = b.centroid();
+	sv_point h, n;
+	sv_interval v;
+	sv_integer j;
+
+	h.x = max(b.xi.hi() - cen.x, cen.x - b.xi.lo());
+	h.y = max(b.yi.hi() - cen.y, cen.y - b.yi.lo());
+	h.z = max(b.zi.hi() - cen.z, cen.z - b.zi.lo());
+
+	for(; s < e; s++)
+	{
+		d = &r[s->d];
+		a = &r[s->a];
+		switch(s->code)
+		{
+		case SVTP_PLANE: 
+			n = plane[s->i].normal;
+			d->c = plane[s->i].value(cen);
+			d->x = n.x*h.x;
+			d->y = n.y*h.y;
+			d->z = n.z*h.z;
+			d->e = 0.0;
+			break;
+		case SVTP_USER: 
+			if (s->i < S_U_PRIM)
+				aff_interval(d, range_s(s->i, b));
+			else
+				aff_interval(d, range_user(s->i, b));
+			break;
+		case SVTP_PLUS: 
+		case SVTP_MINUS:
+			p = r[s->b];
+			if(s->code == SVTP_MINUS) aff_scale(&p, &p, -1.0);
+			d->c = a->c + p.c;
+			d->x = a->x + p.x;
+			d->y = a->y + p.y;
+			d->z = a->z + p.z;
+			d->e = a->e + p.e;
+			break;
+		case SVTP_PLUS_K: 
+		case SVTP_K_PLUS: *d = *a; d->c = d->c + s->k; break;
+		case SVTP_MINUS_K: *d = *a; d->c = d->c - s->k; break;
+		case SVTP_K_MINUS: aff_scale(d, a, -1.0); d->c = s->k + d->c; break;
+		case SVTP_TIMES: 
+			if(s->a == s->b)
+				aff_square(d, a);
+			else
+				aff_times(d, a, &r[s->b]); 
+			break;
+		case SVTP_TIMES_K: 
+		case SVTP_K_TIMES: aff_scale(d, a, s->k); break;
+		case SVTP_DIVIDE_K: aff_scale(d, a, 1/s->k); break;
+		case SVTP_POW: 
+
+// Square and multiply, most significant bit first
+
+			if(s->i <= 0)
+			{
+				aff_interval(d, pow(aff_range(*a), s->i));
+				break;
+			}
+			p = *a;
+			for(j = 1; (j << 1) <= s->i; j = j << 1);
+			for(j = j >> 1; j; j = j >> 1)
+			{
+				aff_square(&p, &p);
+				if(s->i & j) aff_times(&p, &p, a);
+			}
+			*d = p;
+			break;
+		case SVTP_COMP: aff_scale(d, a, -1.0); break;
+		case SVTP_ABS: 
+			v = aff_range(*a);
+			if(v.lo() >= 0.0) 
+				*d = *a;
+			else if(v.hi() <= 0.0) 
+				aff_scale(d, a, -1.0);
+			else
+				aff_interval(d, abs(v));
+			break;
+		case SVTP_SIN: aff_interval(d, sin(aff_range(*a))); break;
+		case SVTP_COS: aff_interval(d, cos(aff_range(*a))); break;
+		case SVTP_EXP: aff_interval(d, exp(aff_range(*a))); break;
+		case SVTP_SSQRT: aff_interval(d, s_sqrt(aff_range(*a))); break;
+		case SVTP_SIGN: aff_interval(d, sign(aff_range(*a))); break;
+		default:
+			svlis_error("sv_prim_tape::affine", "dud step", SV_CORRUPT);
+		}
+	}
+	return(aff_range(r[0]));
+}
+
+// The mean-value (centred) form: the value at the middle of the box
+// plus the range of the grad over the box times the box's half size.
+// This is only right for smooth primitives, so tapes with |a|, s_sqrt, 
+// sign or user primitives return 0.
+
+int sv_prim_tape::centred(const sv_box& b, sv_interval* v) const
+{
+	sv_point cen = b.centroid();
+	sv_interval r;
+	sv_box g;
+	sv_point h;
+
+	if(rough_steps) return(0);
+	if(!grad(b, &r, &g)) return(0);
+
+	h.x = max(b.xi.hi() - cen.x, cen.x - b.xi.lo());
+	h.y = max(b.yi.hi() - cen.y, cen.y - b.yi.lo());
+	h.z = max(b.zi.hi() - cen.z, cen.z - b.zi.lo());
+
+	*v = value(cen) + g.xi*sv_interval(-h.x, h.x) + g.yi*sv_interval(-h.y, h.y) + 
+		g.zi*sv_interval(-h.z, h.z);
+	return(1);
+}
+
+// Bernstein-form bounds.  A polynomial over a box is rewritten in
+// the variables u, v and w that go from 0 to 1 across the box, and then
+// in the Bernstein basis for [0, 1] in each of them.  The polynomial
+// lies between the smallest and largest Bernstein coefficients, and 
+// the corner coefficients are its values at the corners, so the bounds
+// are much closer than interval arithmetic gives near tangencies.  Where
+// they straddle 0 the box is split in half (by de Casteljau's 
+// algorithm, which needs no more conversion) and the halves bounded.
+// All this is done in double precision.
+
+// Polynomial arithmetic on (n+1)^3 arrays
+
+static void poly_clear(double* d, sv_integer m3)
+{
+	for(sv_integer i = 0; i < m3; i++) d[i] = 0.0;
+}
+
+static void poly_times(double* d, const double* a, const double* b, sv_integer n, double* t)
+{
+	sv_integer m = n + 1;
+	sv_integer m3 = m*m*m;
+	sv_integer i, j, k, p, q, r;
+	double c;
+
+	poly_clear(t, m3);
+	for(i = 0; i <= n; i++)
+	  for(j = 0; i + j <= n; j++)
+	    for(k = 0; i + j + k <= n; k++)
+	    {
+		if((c = a[(i*m + j)*m + k]) == 0.0) continue;
+		for(p = 0; i + j + k + p <= n; p++)
+		  for(q = 0; i + j + k + p + q <= n; q++)
+		    for(r = 0; i + j + k + p + q + r <= n; r++)
+			t[((i + p)*m + j + q)*m + k + r] += c*b[(p*m + q)*m + r];
+	    }
+	for(i = 0; i < m3; i++) d[i] = t[i];
+}
+
+// Work out the degree of each register.  Degrees can only go up from
+// one step to the next, so the biggest is enough for all of them.
+
+sv_tape_poly* sv_prim_tape::make_poly() const
+{
+	sv_tape_poly* p = new sv_tape_poly();
+	sv_integer deg[SV_TAPE_REGS];
+	const sv_tape_step* s;
+	const sv_tape_step* e = step + steps;
+	sv_integer n = 0;
+	sv_integer m, m3, j;
+	double* r;
+	double* t;
+	double* u;
+	double* d;
+	double* a;
+
+	for(s = step; s < e; s++)
+	{
+		switch(s->code)
+		{
+		case SVTP_PLANE: deg[s->d] = 1; break;
+		case SVTP_PLUS: 
+		case SVTP_MINUS: deg[s->d] = max(deg[s->a], deg[s->b]); break;
+		case SVTP_TIMES: deg[s->d] = deg[s->a] + deg[s->b]; break;
+		case SVTP_PLUS_K:
+		case SVTP_K_PLUS:
+		case SVTP_MINUS_K:
+		case SVTP_K_MINUS:
+		case SVTP_TIMES_K:
+		case SVTP_K_TIMES:
+		case SVTP_DIVIDE_K:
+		case SVTP_COMP: deg[s->d] = deg[s->a]; break;
+		case SVTP_POW: 
+			if(s->i < 0) return(p);
+			deg[s->d] = deg[s->a]*s->i; 
+			break;
+		default:
+			return(p);
+		}
+		if(deg[s->d] > SV_BERN_DEGREE) return(p);
+		n = max(n, deg[s->d]);
+	}
+
+	m = n + 1;
+	m3 = m*m*m;
+	r = new double[(regs + 2)*m3];
+	t = r + regs*m3;	// Working space for products
+	u = t + m3;		// and for powers
+	for(s = step; s < e; s++)
+	{
+		d = r + s->d*m3;
+		a = r + s->a*m3;
+		switch(s->code)
+		{
+		case SVTP_PLANE: 
+			poly_clear(d, m3);
+			d[0] = plane[s->i].d;
+			d[m*m] = plane[s->i].normal.x;
+			d[m] = plane[s->i].normal.y;
+			d[1] = plane[s->i].normal.z;
+			break;
+		case SVTP_PLUS: for(j = 0; j < m3; j++) d[j] = a[j] + r[s->b*m3 + j]; break;
+		case SVTP_MINUS: for(j = 0; j < m3; j++) d[j] = a[j] - r[s->b*m3 + j]; break;
+		case SVTP_TIMES: poly_times(d, a, r + s->b*m3, n, t); break;
+		case SVTP_PLUS_K:
+		case SVTP_K_PLUS: 
+			for(j = 0; j < m3; j++) d[j] = a[j];
+			d[0] += s->k;
+			break;
+		case SVTP_MINUS_K:
+			for(j = 0; j < m3; j++) d[j] = a[j];
+			d[0] -= s->k;
+			break;
+		case SVTP_K_MINUS:
+			for(j = 0; j < m3; j++) d[j] = -a[j];
+			d[0] += s->k;
+			break;
+		case SVTP_TIMES_K:
+		case SVTP_K_TIMES: for(j = 0; j < m3; j++) d[j] = a[j]*s->k; break;
+		case SVTP_DIVIDE_K: for(j = 0; j < m3; j++) d[j] = a[j]/s->k; break;
+		case SVTP_COMP: for(j = 0; j < m3; j++) d[j] = -a[j]; break;
+		case SVTP_POW:
+			poly_clear(u, m3);
+			u[0] = 1.0;
+			for(j = 0; j < s->i; j++) poly_times(u, u, a, n, t);
+			for(j = 0; j < m3; j++) d[j] = u[j];
+			break;
+		default:
+			svlis_error("sv_prim_tape::make_poly", "dud step", SV_CORRUPT);
+		}
+	}
+
+	p->n = n;
+	p->c = new double[m3];
+	for(j = 0; j < m3; j++) p->c[j] = r[j];
+	delete [] r;
+	return(p);
+}
+
+// p(t) -> p(l + w*u), in powers of u; bc is the table of binomial
+// coefficients, bc[i*(n + 1) + j] being i choose j
+
+static void bern_shift(double* a, sv_integer n, double l, double w, const double* bc)
+{
+	double b[SV_BERN_DEGREE + 1];
+	double s, lp, wp = 1.0;
+	sv_integer i, j;
+
+	for(j = 0; j <= n; j++)
+	{
+		s = 0.0;
+		lp = 1.0;
+		for(i = j; i <= n; i++)
+		{
+			s += a[i]*bc[i*(n + 1) + j]*lp;
+			lp *= l;
+		}
+		b[j] = s*wp;
+		wp *= w;
+	}
+	for(j = 0; j <= n; j++) a[j] = b[j];
+}
+
+// Powers of u -> Bernstein coefficients of degree n on [0, 1]; br is
+// the table of (i choose j)/(n choose j)
+
+static void bern_convert(double* a, sv_integer n, const double* br)
+{
+	double b[SV_BERN_DEGREE + 1];
+	sv_integer i, j;
+
+	for(i = 0; i <= n; i++)
+	{
+		b[i] = 0.0;
+		for(j = 0; j <= i; j++) b[i] += a[j]*br[i*(n + 1) + j];
+	}
+	for(i = 0; i <= n; i++) a[i] = b[i];
+}
+
+// Shift and convert every row of an (n+1)^3 array along the axis whose
+// index stride is st, for that axis's interval of the box
+
+static void bern_rows(double* c, sv_integer n, sv_integer st, const sv_interval& v, 
+	const double* bc, const double* br)
+{
+	sv_integer m = n + 1;
+	sv_integer s1, s2, i, j, k, b;
+	double row[SV_BERN_DEGREE + 1];
+	double l = v.lo();
+	double w = (double)v.hi() - l;
+	int nz;
+
+	if(st == 1) { s1 = m*m; s2 = m; }
+	else if(st == m) { s1 = m*m; s2 = 1; }
+	else { s1 = m; s2 = 1; }
+	for(i = 0; i <= n; i++)
+	  for(j = 0; j <= n; j++)
+	  {
+		b = i*s1 + j*s2;
+		nz = 0;
+		for(k = 0; k <= n; k++) 
+			if((row[k] = c[b + k*st]) != 0.0) nz = 1;
+		if(!nz) continue;	// Lots are, as the total degree is n
+		bern_shift(row, n, l, w, bc);
+		bern_convert(row, n, br);
+		for(k = 0; k <= n; k++) c[b + k*st] = row[k];
+	  }
+}
+
+// Bounds of the Bernstein coefficients in c, splitting the box in half
+// (along x, y, z in turn) up to depth times while they straddle 0
+
+static void bern_bound(const double* c, sv_integer n, sv_integer depth, 
+	double* lo, double* hi)
+{
+	sv_integer m = n + 1;
+	sv_integer m3 = m*m*m;
+	sv_integer st, i, j, k, b, s1, s2, q, r;
+	double l, h;
+	double left[(SV_BERN_DEGREE + 1)*(SV_BERN_DEGREE + 1)*(SV_BERN_DEGREE + 1)];
+	double right[(SV_BERN_DEGREE + 1)*(SV_BERN_DEGREE + 1)*(SV_BERN_DEGREE + 1)];
+	double row[SV_BERN_DEGREE + 1];
+
+	l = h = c[0];
+	for(i = 1; i < m3; i++)
+	{
+		if(c[i] < l) l = c[i];
+		if(c[i] > h) h = c[i];
+	}
+	if((l > 0.0) || (h < 0.0) || (depth <= 0))
+	{
+		if(l < *lo) *lo = l;
+		if(h > *hi) *hi = h;
+		return;
+	}
+
+// de Casteljau at 1/2 along one axis
+
+	switch(depth % 3)
+	{
+	case 0: st = m*m; s1 = m; s2 = 1; break;
+	case 1: st = m; s1 = m*m; s2 = 1; break;
+	default: st = 1; s1 = m*m; s2 = m;
+	}
+	for(i = 0; i <= n; i++)
+	  for(j = 0; j <= n; j++)
+	  {
+		b = i*s1 + j*s2;
+		for(k = 0; k <= n; k++) row[k] = c[b + k*st];
+		for(q = 0; q <= n; q++)
+		{
+			left[b + q*st] = row[0];
+			right[b + (n - q)*st] = row[n - q];
+			for(r = 0; r < n - q; r++) row[r] = 0.5*(row[r] + row[r + 1]);
+		}
+	  }
+	bern_bound(left, n, depth - 1, lo, hi);
+	bern_bound(right, n, depth - 1, lo, hi);
+}
+
+int sv_prim_tape::bernstein(const sv_box& bx, sv_interval* v) const
+{
+	const sv_tape_poly* p;
+	sv_tape_poly* np;
+	double c[(SV_BERN_DEGREE + 1)*(SV_BERN_DEGREE + 1)*(SV_BERN_DEGREE + 1)];
+	double bc[(SV_BERN_DEGREE + 1)*(SV_BERN_DEGREE + 1)];
+	double br[(SV_BERN_DEGREE + 1)*(SV_BERN_DEGREE + 1)];
+	double lo, hi;
+	sv_integer n, m, m3, i, j;
+
+	if(!(p = (const sv_tape_poly*)sv_atomic_get_ptr((void**)&poly)))
+	{
+		np = make_poly();
+		if(sv_atomic_set_ptr((void**)&poly, 0, (void*)np))
+			p = np;
+		else
+		{
+			delete np;
+			p = (const sv_tape_poly*)sv_atomic_get_ptr((void**)&poly);
+		}
+	}
+	if((n = p->n) < 0) return(0);
+	if(bx.empty()) return(0);
+
+// Binomial coefficients: bc[i*m + j] is i choose j
+
+	m = n + 1;
+	for(i = 0; i <= n; i++)
+	{
+		bc[i*m] = bc[i*m + i] = 1.0;
+		for(j = 1; j < i; j++) bc[i*m + j] = bc[(i - 1)*m + j - 1] + bc[(i - 1)*m + j];
+	}
+	for(i = 0; i <= n; i++)
+		for(j = 0; j <= i; j++) br[i*m + j] = bc[i*m + j]/bc[n*m + j];
+
+	m3 = m*m*m;
+	for(i = 0; i < m3; i++) c[i] = p->c[i];
+	bern_rows(c, n, m*m, bx.xi, bc, br);
+	bern_rows(c, n, m, bx.yi, bc, br);
+	bern_rows(c, n, 1, bx.zi, bc, br);
+
+	lo = c[0];
+	hi = c[0];
+	bern_bound(c, n, SV_BERN_SPLIT, &lo, &hi);
+	*v = sv_interval((sv_real)lo, (sv_real)hi);
+	return(1);
+}
+
+// Vector arithmetic for batches of points.  sv_real must be float for
+// these.  Each kernel works on the first w lanes of a block, where w is
+// the batch size rounded up to a whole number of vectors; all w lanes 
+// are defined (the unused ones at the end of a short batch are zeros).
+// No fused multiply-adds are used, so every lane gets exactly the
+// same answer as the scalar code.
+
+#if defined(__AVX__)
+
+#include <immintrin.h>
+#define SV_VW 8
+typedef __m256 sv_vec;
+#define sv_vload(p) _mm256_loadu_ps(p)
+#define sv_vstore(p, a) _mm256_storeu_ps(p, a)
+#define sv_vset(a) _mm256_set1_ps(a)
+#define sv_vadd(a, b) _mm256_add_ps(a, b)
+#define sv_vsub(a, b) _mm256_sub_ps(a, b)
+#define sv_vmul(a, b) _mm256_mul_ps(a, b)
+#define sv_vdiv(a, b) _mm256_div_ps(a, b)
+#define sv_vsqrt(a) _mm256_sqrt_ps(a)
+#define sv_vand(a, b) _mm256_and_ps(a, b)
+#define sv_vandnot(a, b) _mm256_andnot_ps(a, b)
+#define sv_vor(a, b) _mm256_or_ps(a, b)
+#define sv_vxor(a, b) _mm256_xor_ps(a, b)
+#define sv_vgt(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define sv_vlt(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define sv_vle(a, b) _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+#define sv_vge(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+#define SV_VW 4
+typedef __m128 sv_vec;
+#define sv_vload(p) _mm_loadu_ps(p)
+#define sv_vstore(p, a) _mm_storeu_ps(p, a)
+#define sv_vset(a) _mm_set1_ps(a)
+#define sv_vadd(a, b) _mm_add_ps(a, b)
+#define sv_vsub(a, b) _mm_sub_ps(a, b)
+#define sv_vmul(a, b) _mm_mul_ps(a, b)
+#define sv_vdiv(a, b) _mm_div_ps(a, b)
+#define sv_vsqrt(a) _mm_sqrt_ps(a)
+#define sv_vand(a, b) _mm_and_ps(a, b)
+#define sv_vandnot(a, b) _mm_andnot_ps(a, b)
+#define sv_vor(a, b) _mm_or_ps(a, b)
+#define sv_vxor(a, b) _mm_xor_ps(a, b)
+#define sv_vgt(a, b) _mm_cmpgt_ps(a, b)
+#define sv_vlt(a, b) _mm_cmplt_ps(a, b)
+#define sv_vle(a, b) _mm_cmple_ps(a, b)
+#define sv_vge(a, b) _mm_cmpge_ps(a, b)
+
+#endif
+
+#ifdef SV_VW
+
+// Just the sign bit
+
+static inline sv_vec sv_vsignbit() { return(sv_vset(-0.0f)); }
+
+// m ? a : b lane by lane, where m comes from a comparison
+
+static inline sv_vec sv_vsel(sv_vec m, sv_vec a, sv_vec b) 
+{ 
+	return(sv_vor(sv_vand(m, a), sv_vandnot(m, b))); 
+}
+
+// d = a op b for the whole block
+
+#define SV_V2(name, op) \
+static void name(sv_real* d, const sv_real* a, const sv_real* b, sv_integer w) \
+{ \
+	for(sv_integer i = 0; i < w; i += SV_VW) \
+		sv_vstore(d + i, op(sv_vload(a + i), sv_vload(b + i))); \
+}
+
+// d = a op k and d = k op a
+
+#define SV_VK(name, kname, op) \
+static void name(sv_real* d, const sv_real* a, sv_real k, sv_integer w) \
+{ \
+	sv_vec vk = sv_vset(k); \
+	for(sv_integer i = 0; i < w; i += SV_VW) \
+		sv_vstore(d + i, op(sv_vload(a + i), vk)); \
+} \
+static void kname(sv_real* d, const sv_real* a, sv_real k, sv_integer w) \
+{ \
+	sv_vec vk = sv_vset(k); \
+	for(sv_integer i = 0; i < w; i += SV_VW) \
+		sv_vstore(d + i, op(vk, sv_vload(a + i))); \
+}
+
+#else
+
+// Plain C++ when there are no vectors; the compiler may still
+// vectorize these loops itself
+
+#define SV_V2(name, op) \
+static void name(sv_real* d, const sv_real* a, const sv_real* b, sv_integer w) \
+{ \
+	for(sv_integer i = 0; i < w; i++) d[i] = a[i] op b[i]; \
+}
+
+#define SV_VK(name, kname, op) \
+static void name(sv_real* d, const sv_real* a, sv_real k, sv_integer w) \
+{ \
+	for(sv_integer i = 0; i < w; i++) d[i] = a[i] op k; \
+} \
+static void kname(sv_real* d, const sv_real* a, sv_real k, sv_integer w) \
+{ \
+	for(sv_integer i = 0; i < w; i++) d[i] = k op a[i]; \
+}
+
+#define sv_vadd +
+#define sv_vsub -
+#define sv_vmul *
+#define sv_vdiv /
+
+#endif
+
+// The lanes to work on for a batch of m
+
+static inline sv_integer b_width(sv_integer m)
+{
+#ifdef SV_VW
+	return((m + SV_VW - 1)/SV_VW*SV_VW);
+#else
+	return(m);
+#endif
+}
+
+SV_V2(b_plus, sv_vadd)
+SV_V2(b_minus, sv_vsub)
+SV_V2(b_times, sv_vmul)
+SV_VK(b_plus_k, b_k_plus, sv_vadd)
+SV_VK(b_minus_k, b_k_minus, sv_vsub)
+SV_VK(b_times_k, b_k_times, sv_vmul)
+SV_VK(b_divide_k, b_k_divide, sv_vdiv)
+
+// Plane: (x*a + y*b + z*c) + d, in the order of sv_plane::value(...)
+
+static void b_plane(sv_real* d, const sv_plane& f, const sv_real* x, 
+	const sv_real* y, const sv_real* z, sv_integer w)
+{
+	sv_integer i;
+#ifdef SV_VW
+	sv_vec a = sv_vset(f.normal.x);
+	sv_vec b = sv_vset(f.normal.y);
+	sv_vec c = sv_vset(f.normal.z);
+	sv_vec e = sv_vset(f.d);
+	for(i = 0; i < w; i += SV_VW)
+		sv_vstore(d + i, sv_vadd(sv_vadd(sv_vadd(sv_vmul(sv_vload(x + i), a), 
+			sv_vmul(sv_vload(y + i), b)), sv_vmul(sv_vload(z + i), c)), e));
+#else
+	for(i = 0; i < w; i++)
+		d[i] = x[i]*f.normal.x + y[i]*f.normal.y + z[i]*f.normal.z + f.d;
+#endif
+}
+
+// Integer powers by repeated multiplication in sv_real, with the factors
+// taken in the same order as svlis's pow(sv_real, sv_integer) in sums.cxx,
+// and a negative power made as 1 over the positive one as it is there.
+// That pow is what sv_primitive::value(...) and the scalar tape call (it's
+// an exact match for their arguments, so neither goes through the C
+// library's pow in double), so the answers are the same bit for bit.  A
+// pow done in double would round differently.
+
+static void b_pow(sv_real* d, const sv_real* a, sv_integer j, sv_integer w)
+{
+	sv_integer i, n;
+	sv_real c[SV_TAPE_BLOCK];
+
+	for(i = 0; i < w; i++) c[i] = 1.0;
+	for(n = abs(j); n; n--) b_times(c, a, c, w);
+	if(j < 0)
+		b_k_divide(d, c, 1.0, w);
+	else
+		for(i = 0; i < w; i++) d[i] = c[i];
+}
+
+static void b_comp(sv_real* d, const sv_real* a, sv_integer w)
+{
+	sv_integer i;
+#ifdef SV_VW
+	for(i = 0; i < w; i += SV_VW)
+		sv_vstore(d + i, sv_vxor(sv_vload(a + i), sv_vsignbit()));
+#else
+	for(i = 0; i < w; i++) d[i] = -a[i];
+#endif
+}
+
+static void b_abs(sv_real* d, const sv_real* a, sv_integer w)
+{
+	sv_integer i;
+#ifdef SV_VW
+	for(i = 0; i < w; i += SV_VW)
+		sv_vstore(d + i, sv_vandnot(sv_vsignbit(), sv_vload(a + i)));
+#else
+	for(i = 0; i < w; i++) d[i] = fabs(a[i]);
+#endif
+}
+
+// Signed square root: sqrt(|a|) with the sign of a
+
+static void b_ssqrt(sv_real* d, const sv_real* a, sv_integer w)
+{
+	sv_integer i;
+#ifdef SV_VW
+	sv_vec v, s;
+	for(i = 0; i < w; i += SV_VW)
+	{
+		v = sv_vload(a + i);
+		s = sv_vand(v, sv_vsignbit());
+		sv_vstore(d + i, sv_vor(sv_vsqrt(sv_vandnot(sv_vsignbit(), v)), s));
+	}
+#else
+	for(i = 0; i < w; i++) d[i] = s_sqrt(a[i]);
+#endif
+}
+
+// Sign: 1 if a > 0, otherwise -1
+
+static void b_sign(sv_real* d, const sv_real* a, sv_integer w)
+{
+	sv_integer i;
+#ifdef SV_VW
+	sv_vec one = sv_vset(1.0);
+	for(i = 0; i < w; i += SV_VW)
+		sv_vstore(d + i, sv_vor(one, sv_vandnot(sv_vgt(sv_vload(a + i), sv_vset(0.0)), 
+			sv_vsignbit())));
+#else
+	for(i = 0; i < w; i++) d[i] = sign(a[i]);
+#endif
+}
+
+// Run the tape on one block of points (already padded to w)
+
+static void b_run(const sv_tape_step* step, sv_integer steps, const sv_plane* plane,
+	const sv_real* x, const sv_real* y, const sv_real* z, sv_real* r, 
+	sv_integer m, sv_integer w)
+{
+	const sv_tape_step* s;
+	const sv_tape_step* e = step + steps;
+	sv_real* d;
+	sv_real* a;
+	sv_integer i;
+
+	for(s = step; s < e; s++)
+	{
+		d = r + s->d*SV_TAPE_BLOCK;
+		a = r + s->a*SV_TAPE_BLOCK;
+		switch(s->code)
+		{
+		case SVTP_PLANE: b_plane(d, plane[s->i], x, y, z, w); break;
+		case SVTP_USER:
+			for(i = 0; i < m; i++)
+			{
+				if (s->i < S_U_PRIM)
+					d[i] = value_s(s->i, sv_point(x[i], y[i], z[i]));
+				else
+					d[i] = value_user(s->i, sv_point(x[i], y[i], z[i]));
+			}
+			for(; i < w; i++) d[i] = 0;
+			break;
+		case SVTP_PLUS: b_plus(d, a, r + s->b*SV_TAPE_BLOCK, w); break;
+		case SVTP_PLUS_K: b_plus_k(d, a, s->k, w); break;
+		case SVTP_K_PLUS: b_k_plus(d, a, s->k, w); break;
+		case SVTP_MINUS: b_minus(d, a, r + s->b*SV_TAPE_BLOCK, w); break;
+		case SVTP_MINUS_K: b_minus_k(d, a, s->k, w); break;
+		case SVTP_K_MINUS: b_k_minus(d, a, s->k, w); break;
+		case SVTP_TIMES: b_times(d, a, r + s->b*SV_TAPE_BLOCK, w); break;
+		case SVTP_TIMES_K: b_times_k(d, a, s->k, w); break;
+		case SVTP_K_TIMES: b_k_times(d, a, s->k, w); break;
+		case SVTP_DIVIDE_K: b_divide_k(d, a, s->k, w); break;
+		case SVTP_POW: b_pow(d, a, s->i, w); break;
+		case SVTP_COMP: b_comp(d, a, w); break;
+		case SVTP_ABS: b_abs(d, a, w); break;
+		case SVTP_SIN: for(i = 0; i < w; i++) d[i] = (sv_real)sin(a[i]); break;
+		case SVTP_COS: for(i = 0; i < w; i++) d[i] = (sv_real)cos(a[i]); break;
+		case SVTP_EXP: for(i = 0; i < w; i++) d[i] = (sv_real)exp(a[i]); break;
+		case SVTP_SSQRT: b_ssqrt(d, a, w); break;
+		case SVTP_SIGN: b_sign(d, a, w); break;
+		default:
+			svlis_error("sv_prim_tape::value(batch)", "dud step", SV_CORRUPT);
+		}
+	}
+}
+
+// Copy a slice of a batch into a padded block
+
+static void b_load(sv_real* d, const sv_real* a, sv_integer m, sv_integer w)
+{
+	sv_integer i;
+	for(i = 0; i < m; i++) d[i] = a[i];
+	for(; i < w; i++) d[i] = 0;
+}
+
+void sv_prim_tape::value(const sv_real* x, const sv_real* y, const sv_real* z, 
+	sv_real* v, sv_integer n) const
+{
+	sv_real r[SV_TAPE_REGS*SV_TAPE_BLOCK];
+	sv_real bx[SV_TAPE_BLOCK], by[SV_TAPE_BLOCK], bz[SV_TAPE_BLOCK];
+	sv_integer j, m, w, i;
+
+	for(j = 0; j < n; j += SV_TAPE_BLOCK)
+	{
+		m = min(n - j, (sv_integer)SV_TAPE_BLOCK);
+		w = b_width(m);
+		b_load(bx, x + j, m, w);
+		b_load(by, y + j, m, w);
+		b_load(bz, z + j, m, w);
+		b_run(step, steps, plane, bx, by, bz, r, m, w);
+		for(i = 0; i < m; i++) v[j + i] = r[i];
+	}
+}
+
+void sv_plane_value(const sv_plane& f, const sv_real* x, const sv_real* y, 
+	const sv_real* z, sv_real* v, sv_integer n)
+{
+	sv_real r[SV_TAPE_BLOCK];
+	sv_real bx[SV_TAPE_BLOCK], by[SV_TAPE_BLOCK], bz[SV_TAPE_BLOCK];
+	sv_integer j, m, w, i;
+
+	for(j = 0; j < n; j += SV_TAPE_BLOCK)
+	{
+		m = min(n - j, (sv_integer)SV_TAPE_BLOCK);
+		w = b_width(m);
+		b_load(bx, x + j, m, w);
+		b_load(by, y + j, m, w);
+		b_load(bz, z + j, m, w);
+		b_plane(r, f, bx, by, bz, w);
+		for(i = 0; i < m; i++) v[j + i] = r[i];
+	}
+}
+
+// Interval arithmetic for batches of boxes.  Each register holds the
+// low and high ends of SV_TAPE_BLOCK intervals in separate arrays.  The
+// kernels follow the sv_interval operators step for step so the answers
+// are the same as range(box); sin, cos, exp and user primitives are
+// done one interval at a time by the sv_interval functions themselves.
+// An input box that is empty, or any empty interval from those
+// functions, marks its lane bad, and bad lanes are redone with 
+// range(box) at the end.  Every kernel reads all its arguments for a
+// lane before writing the answer, so d may be the same register as a or b.
+
+struct sv_tape_ireg
+{
+	sv_real* l;
+	sv_real* h;
+};
+
+// a*k for a constant, as operator*(sv_interval, sv_real)
+
+static void i_times_k(sv_tape_ireg d, sv_tape_ireg a, sv_real k, sv_integer w)
+{
+	sv_integer i;
+	const sv_real* lo = (k > 0.0) ? a.l : a.h;
+	const sv_real* hi = (k > 0.0) ? a.h : a.l;
+#ifdef SV_VW
+	sv_vec vk = sv_vset(k);
+	sv_vec p, q;
+	for(i = 0; i < w; i += SV_VW)
+	{
+		p = sv_vmul(sv_vload(lo + i), vk);
+		q = sv_vmul(sv_vload(hi + i), vk);
+		sv_vstore(d.l + i, p);
+		sv_vstore(d.h + i, q);
+	}
+#else
+	sv_real p, q;
+	for(i = 0; i < w; i++)
+	{
+		p = lo[i]*k;
+		q = hi[i]*k;
+		d.l[i] = p;
+		d.h[i] = q;
+	}
+#endif
+}
+
+// -a swaps the ends over
+
+static void i_comp(sv_tape_ireg d, sv_tape_ireg a, sv_integer w)
+{
+	sv_integer i;
+#ifdef SV_VW
+	sv_vec p, q;
+	for(i = 0; i < w; i += SV_VW)
+	{
+		p = sv_vxor(sv_vload(a.h + i), sv_vsignbit());
+		q = sv_vxor(sv_vload(a.l + i), sv_vsignbit());
+		sv_vstore(d.l + i, p);
+		sv_vstore(d.h + i, q);
+	}
+#else
+	sv_real p, q;
+	for(i = 0; i < w; i++)
+	{
+		p = -a.h[i];
+		q = -a.l[i];
+		d.l[i] = p;
+		d.h[i] = q;
+	}
+#endif
+}
+
+// k - a, which is k + (-a)
+
+static void i_k_minus(sv_tape_ireg d, sv_tape_ireg a, sv_real k, sv_integer w)
+{
+	sv_integer i;
+#ifdef SV_VW
+	sv_vec vk = sv_vset(k);
+	sv_vec p, q;
+	for(i = 0; i < w; i += SV_VW)
+	{
+		p = sv_vsub(vk, sv_vload(a.h + i));
+		q = sv_vsub(vk, sv_vload(a.l + i));
+		sv_vstore(d.l + i, p);
+		sv_vstore(d.h + i, q);
+	}
+#else
+	sv_real p, q;
+	for(i = 0; i < w; i++)
+	{
+		p = k - a.h[i];
+		q = k - a.l[i];
+		d.l[i] = p;
+		d.h[i] = q;
+	}
+#endif
+}
+
+static void i_minus(sv_tape_ireg d, sv_tape_ireg a, sv_tape_ireg b, sv_integer w)
+{
+	sv_integer i;
+#ifdef SV_VW
+	sv_vec p, q;
+	for(i = 0; i < w; i += SV_VW)
+	{
+		p = sv_vsub(sv_vload(a.l + i), sv_vload(b.h + i));
+		q = sv_vsub(sv_vload(a.h + i), sv_vload(b.l + i));
+		sv_vstore(d.l + i, p);
+		sv_vstore(d.h + i, q);
+	}
+#else
+	sv_real p, q;
+	for(i = 0; i < w; i++)
+	{
+		p = a.l[i] - b.h[i];
+		q = a.h[i] - b.l[i];
+		d.l[i] = p;
+		d.h[i] = q;
+	}
+#endif
+}
+
+// Product: the smallest and largest of the four end products, taken
+// in the same order as operator*(sv_interval, sv_interval)
+
+static void i_times(sv_tape_ireg d, sv_tape_ireg a, sv_tape_ireg b, sv_integer w)
+{
+	sv_integer i;
+#ifdef SV_VW
+	sv_vec al, ah, bl, bh, c, e, q, r, t;
+	for(i = 0; i < w; i += SV_VW)
+	{
+		al = sv_vload(a.l + i);
+		ah = sv_vload(a.h + i);
+		bl = sv_vload(b.l + i);
+		bh = sv_vload(b.h + i);
+		c = sv_vmul(al, bl);
+		e = c;
+		q = sv_vmul(al, bh);
+		r = sv_vmul(ah, bl);
+		t = sv_vmul(ah, bh);
+		c = sv_vsel(sv_vlt(q, c), q, c);
+		c = sv_vsel(sv_vlt(r, c), r, c);
+		c = sv_vsel(sv_vlt(t, c), t, c);
+		e = sv_vsel(sv_vgt(q, e), q, e);
+		e = sv_vsel(sv_vgt(r, e), r, e);
+		e = sv_vsel(sv_vgt(t, e), t, e);
+		sv_vstore(d.l + i, c);
+		sv_vstore(d.h + i, e);
+	}
+#else
+	sv_real c, e, q, r, t;
+	for(i = 0; i < w; i++)
+	{
+		c = a.l[i]*b.l[i];
+		e = c;
+		q = a.l[i]*b.h[i];
+		r = a.h[i]*b.l[i];
+		t = a.h[i]*b.h[i];
+		if (q < c) c = q;
+		if (r < c) c = r;
+		if (t < c) c = t;
+		if (q > e) e = q;
+		if (r > e) e = r;
+		if (t > e) e = t;
+		d.l[i] = c;
+		d.h[i] = e;
+	}
+#endif
+}
+
+// Non-negative integer powers, as pow(sv_interval, sv_integer)
+
+static void i_pow(sv_tape_ireg d, sv_tape_ireg a, sv_integer j, sv_integer w)
+{
+	sv_integer i, n;
+#ifdef SV_VW
+	sv_vec al, ah, pl, ph, pm, m, neg, mid, zero = sv_vset(0.0);
+	for(i = 0; i < w; i += SV_VW)
+	{
+		al = sv_vload(a.l + i);
+		ah = sv_vload(a.h + i);
+		pl = ph = sv_vset(1.0);
+		for(n = j; n; n--)
+		{
+			pl = sv_vmul(al, pl);
+			ph = sv_vmul(ah, ph);
+		}
+		if(j%2)
+		{
+			sv_vstore(d.l + i, pl);
+			sv_vstore(d.h + i, ph);
+			continue;
+		}
+		m = sv_vxor(al, sv_vsignbit());
+		m = sv_vsel(sv_vgt(m, ah), m, ah);
+		pm = sv_vset(1.0);
+		for(n = j; n; n--) pm = sv_vmul(m, pm);
+		neg = sv_vand(sv_vlt(al, zero), sv_vlt(ah, zero));
+		mid = sv_vand(sv_vlt(al, zero), sv_vge(ah, zero));
+		sv_vstore(d.l + i, sv_vsel(neg, ph, sv_vsel(mid, zero, pl)));
+		sv_vstore(d.h + i, sv_vsel(neg, pl, sv_vsel(mid, pm, ph)));
+	}
+#else
+	sv_real l, h;
+	for(i = 0; i < w; i++)
+	{
+		l = a.l[i];
+		h = a.h[i];
+		if (!(j%2) && (l < 0.0) && (h < 0.0))
+		{
+			d.l[i] = pow(h, j);
+			d.h[i] = pow(l, j);
+		} else if (!(j%2) && (l < 0.0) && (h >= 0.0))
+		{
+			d.l[i] = 0;
+			d.h[i] = pow(max(-l, h), j);
+		} else
+		{
+			d.l[i] = pow(l, j);
+			d.h[i] = pow(h, j);
+		}
+	}
+#endif
+}
+
+static void i_abs(sv_tape_ireg d, sv_tape_ireg a, sv_integer w)
+{
+	sv_integer i;
+#ifdef SV_VW
+	sv_vec al, ah, p, neg, mid, zero = sv_vset(0.0);
+	for(i = 0; i < w; i += SV_VW)
+	{
+		al = sv_vload(a.l + i);
+		ah = sv_vload(a.h + i);
+		p = sv_vxor(al, sv_vsignbit());
+		neg = sv_vand(sv_vlt(al, zero), sv_vle(ah, zero));
+		mid = sv_vandnot(sv_vle(ah, zero), sv_vlt(al, zero));
+		sv_vstore(d.l + i, sv_vsel(neg, sv_vxor(ah, sv_vsignbit()), 
+			sv_vsel(mid, zero, al)));
+		sv_vstore(d.h + i, sv_vsel(neg, p, 
+			sv_vsel(mid, sv_vsel(sv_vgt(p, ah), p, ah), ah)));
+	}
+#else
+	sv_real l, h;
+	for(i = 0; i < w; i++)
+	{
+		l = a.l[i];
+		h = a.h[i];
+		if (l < 0.0)
+		{
+			if (h <= 0.0)
+			{
+				d.l[i] = -h;
+				d.h[i] = -l;
+			} else
+			{
+				d.l[i] = 0.0;
+				d.h[i] = (-l > h) ? -l : h;
+			}
+		} else
+		{
+			d.l[i] = l;
+			d.h[i] = h;
+		}
+	}
+#endif
+}
+
+// One interval at a time for the functions with no vector kernel
+
+static sv_interval i_get(sv_tape_ireg a, sv_integer i)
+{
+	return(sv_interval(a.l[i], a.h[i]));
+}
+
+static void i_put(sv_tape_ireg d, sv_integer i, const sv_interval& v, sv_integer* bad)
+{
+	if(v.empty())
+	{
+		bad[i] = 1;
+		d.l[i] = d.h[i] = 0;
+	} else
+	{
+		d.l[i] = v.lo();
+		d.h[i] = v.hi();
+	}
+}
+
+// Run the tape on one block of boxes
+
+static void i_run(const sv_tape_step* step, sv_integer steps, const sv_plane* plane,
+	const sv_box* bx, sv_real* const* in, sv_real* rl, sv_real* rh, sv_integer* bad, 
+	sv_integer m, sv_integer w)
+{
+	const sv_tape_step* s;
+	const sv_tape_step* e = step + steps;
+	sv_tape_ireg d, a, b;
+	sv_integer i, j;
+
+	for(s = step; s < e; s++)
+	{
+		d.l = rl + s->d*SV_TAPE_BLOCK;
+		d.h = rh + s->d*SV_TAPE_BLOCK;
+		a.l = rl + s->a*SV_TAPE_BLOCK;
+		a.h = rh + s->a*SV_TAPE_BLOCK;
+		b.l = rl + s->b*SV_TAPE_BLOCK;
+		b.h = rh + s->b*SV_TAPE_BLOCK;
+		switch(s->code)
+		{
+
+// A plane's range is sum of the normal's components times the box's 
+// intervals; for a negative component the ends of the interval swap over.
+
+		case SVTP_PLANE:
+		{
+			const sv_plane& f = plane[s->i];
+			j = f.normal.x > 0.0;
+			sv_real* xl = in[j ? 0 : 1];
+			sv_real* xh = in[j ? 1 : 0];
+			j = f.normal.y > 0.0;
+			sv_real* yl = in[j ? 2 : 3];
+			sv_real* yh = in[j ? 3 : 2];
+			j = f.normal.z > 0.0;
+			sv_real* zl = in[j ? 4 : 5];
+			sv_real* zh = in[j ? 5 : 4];
+			b_plane(d.l, f, xl, yl, zl, w);
+			b_plane(d.h, f, xh, yh, zh, w);
+			break;
+		}
+		case SVTP_USER:
+			for(i = 0; i < m; i++)
+			{
+				if(bad[i]) continue;
+				if (s->i < S_U_PRIM)
+					i_put(d, i, range_s(s->i, bx[i]), bad);
+				else
+					i_put(d, i, range_user(s->i, bx[i]), bad);
+			}
+			break;
+		case SVTP_PLUS: 
+			b_plus(d.l, a.l, b.l, w); 
+			b_plus(d.h, a.h, b.h, w); 
+			break;
+		case SVTP_PLUS_K: 
+		case SVTP_K_PLUS: 
+			b_plus_k(d.l, a.l, s->k, w); 
+			b_plus_k(d.h, a.h, s->k, w); 
+			break;
+		case SVTP_MINUS: i_minus(d, a, b, w); break;
+		case SVTP_MINUS_K: 
+			b_plus_k(d.l, a.l, -s->k, w); 
+			b_plus_k(d.h, a.h, -s->k, w); 
+			break;
+		case SVTP_K_MINUS: i_k_minus(d, a, s->k, w); break;
+		case SVTP_TIMES: i_times(d, a, b, w); break;
+		case SVTP_TIMES_K: 
+		case SVTP_K_TIMES: i_times_k(d, a, s->k, w); break;
+		case SVTP_DIVIDE_K:
+			if(s->k == 0.0)
+			{
+				for(i = 0; i < m; i++) 
+					if(!bad[i]) i_put(d, i, i_get(a, i)/s->k, bad);
+			} else
+				i_times_k(d, a, 1/s->k, w);
+			break;
+		case SVTP_POW:
+			if(s->i < 0)
+			{
+				for(i = 0; i < m; i++) 
+					if(!bad[i]) i_put(d, i, pow(i_get(a, i), s->i), bad);
+			} else
+				i_pow(d, a, s->i, w);
+			break;
+		case SVTP_COMP: i_comp(d, a, w); break;
+		case SVTP_ABS: i_abs(d, a, w); break;
+		case SVTP_SIN: 
+			for(i = 0; i < m; i++) if(!bad[i]) i_put(d, i, sin(i_get(a, i)), bad);
+			break;
+		case SVTP_COS: 
+			for(i = 0; i < m; i++) if(!bad[i]) i_put(d, i, cos(i_get(a, i)), bad);
+			break;
+		case SVTP_EXP: 
+			for(i = 0; i < m; i++) if(!bad[i]) i_put(d, i, exp(i_get(a, i)), bad);
+			break;
+		case SVTP_SSQRT: 
+			b_ssqrt(d.l, a.l, w); 
+			b_ssqrt(d.h, a.h, w); 
+			break;
+		case SVTP_SIGN: 
+			b_sign(d.l, a.l, w); 
+			b_sign(d.h, a.h, w); 
+			break;
+		default:
+			svlis_error("sv_prim_tape::range(batch)", "dud step", SV_CORRUPT);
+		}
+	}
+}
+
+// Split a block of boxes into the six arrays of interval ends
+
+static void i_load(sv_real* const* in, sv_integer* bad, const sv_box* b, 
+	sv_integer m, sv_integer w)
+{
+	sv_integer i, j;
+
+	for(i = 0; i < m; i++)
+	{
+		if((bad[i] = b[i].xi.empty() || b[i].yi.empty() || b[i].zi.empty()))
+		{
+			for(j = 0; j < 6; j++) in[j][i] = 0;
+			continue;
+		}
+		in[0][i] = b[i].xi.lo();
+		in[1][i] = b[i].xi.hi();
+		in[2][i] = b[i].yi.lo();
+		in[3][i] = b[i].yi.hi();
+		in[4][i] = b[i].zi.lo();
+		in[5][i] = b[i].zi.hi();
+	}
+	for(; i < w; i++)
+	{
+		bad[i] = 0;
+		for(j = 0; j < 6; j++) in[j][i] = 0;
+	}
+}
+
+void sv_prim_tape::range(const sv_box* b, sv_interval* v, sv_integer n) const
+{
+	sv_integer j, i;
+
+#ifdef SV_AFFINE
+
+// Affine intervals aren't just a pair of ends; do them one by one
+
+	for(j = 0; j < n; j++) v[j] = range(b[j]);
+	return;
+
+#else
+
+	sv_real rl[SV_TAPE_REGS*SV_TAPE_BLOCK], rh[SV_TAPE_REGS*SV_TAPE_BLOCK];
+	sv_real bi[6*SV_TAPE_BLOCK];
+	sv_real* in[6];
+	sv_integer bad[SV_TAPE_BLOCK];
+	sv_integer m, w;
+
+	for(i = 0; i < 6; i++) in[i] = bi + i*SV_TAPE_BLOCK;
+
+	for(j = 0; j < n; j += SV_TAPE_BLOCK)
+	{
+		m = min(n - j, (sv_integer)SV_TAPE_BLOCK);
+		w = b_width(m);
+		i_load(in, bad, b + j, m, w);
+		i_run(step, steps, plane, b + j, in, rl, rh, bad, m, w);
+		for(i = 0; i < m; i++)
+		{
+			if(bad[i])
+				v[j + i] = range(b[j + i]);
+			else
+				v[j + i] = sv_interval(rl[i], rh[i]);
+		}
+	}
+#endif
+}
+
+void sv_plane_range(const sv_plane& f, const sv_box* b, sv_interval* v, sv_integer n)
+{
+	sv_integer j;
+
+#ifdef SV_AFFINE
+	for(j = 0; j < n; j++) v[j] = f.range(b[j]);
+#else
+	sv_real rl[SV_TAPE_BLOCK], rh[SV_TAPE_BLOCK];
+	sv_real bi[6*SV_TAPE_BLOCK];
+	sv_real* in[6];
+	sv_integer bad[SV_TAPE_BLOCK];
+	sv_integer m, w, i, x, y, z;
+
+	for(i = 0; i < 6; i++) in[i] = bi + i*SV_TAPE_BLOCK;
+	x = f.normal.x > 0.0;
+	y = f.normal.y > 0.0;
+	z = f.normal.z > 0.0;
+
+	for(j = 0; j < n; j += SV_TAPE_BLOCK)
+	{
+		m = min(n - j, (sv_integer)SV_TAPE_BLOCK);
+		w = b_width(m);
+		i_load(in, bad, b + j, m, w);
+		b_plane(rl, f, in[x ? 0 : 1], in[y ? 2 : 3], in[z ? 4 : 5], w);
+		b_plane(rh, f, in[x ? 1 : 0], in[y ? 3 : 2], in[z ? 5 : 4], w);
+		for(i = 0; i < m; i++)
+		{
+			if(bad[i])
+				v[j + i] = f.range(b[j + i]);
+			else
+				v[j + i] = sv_interval(rl[i], rh[i]);
+		}
+	}
+#endif
+}
+
+// Marks a primitive that can't be compiled, so it isn't tried again
+
+static sv_prim_tape no_tape;
+
+// Deletion for prim_data, which only has a pointer to a tape
+
+void sv_tape_delete(sv_prim_tape* t) { if(t != &no_tape) delete t; }
+
+// Get a primitive's tape, compiling it the first time.  Two threads
+// may both compile it; the second one to finish throws its copy away.
+
+const sv_prim_tape* sv_primitive::tape() const
+{
+	sv_prim_tape* t = (sv_prim_tape*)sv_atomic_get_ptr((void**)&(prim_info->tape));
+	sv_prim_tape* n;
+
+	if(!t)
+	{
+		n = new sv_prim_tape();
+		if(!n->compile(*this))
+		{
+			delete n;
+			n = &no_tape;
+		}
+		if(sv_atomic_set_ptr((void**)&(prim_info->tape), 0, (void*)n))
+			t = n;
+		else
+		{
+			if(n != &no_tape) delete n;
+			t = (sv_prim_tape*)sv_atomic_get_ptr((void**)&(prim_info->tape));
+		}
+	}
+	if(t == &no_tape) return(0);
+	return(t);
+}
+
+#if macintosh
+ #pragma export off
+#endif
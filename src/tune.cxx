@@ -0,0 +1,288 @@
+/* 
+ *  The SvLis Geometric Modelling Kernel
+ *  ------------------------------------
+ *
+ *  Copyright (C) 1993, 1997, 1998, 2000 
+ *  University of Bath & Information Geometers Ltd
+ *
+ *  http://www.bath.ac.uk/
+ *  http://www.inge.com/
+ *
+ *  Principal author:
+ *
+ *     Adrian Bowyer
+ *     Department of Mechanical Engineering
+ *     Faculty of Engineering and Design
+ *     University of Bath
+ *     Bath BA2 7AY
+ *     U.K.
+ *
+ *     e-mail: A.Bowyer@bath.ac.uk
+ *        web: http://www.bath.ac.uk/~ensab/
+ *
+ *   SvLis is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   Licence as published by the Free Software Foundation; either
+ *   version 2 of the Licence, or (at your option) any later version.
+ *
+ *   SvLis is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public Licence for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   Licence along with svLis; if not, write to the Free
+ *   Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA,
+ *   or see
+ *
+ *      http://www.gnu.org/
+ * 
+ * =====================================================================
+ *
+ * SvLis - tuning the division parameters to the work a model is for
+ *
+ * See the svLis web site for the manual and other details:
+ *
+ *    http://www.bath.ac.uk/~ensab/G_mod/Svlis/
+ *
+ * or see the file
+ *
+ *    docs/svlis.html
+ *
+ * First version: 18 October 2026
+ * This version: 18 October 2026
+ *
+ */
+
+#include "svlis.h"
+#if macintosh
+ #pragma export on
+#endif
+
+// The values tried for each parameter.  The decision procedures are
+// tried with each of their strategies.
+
+#define SV_TUNE_PASSES 3
+
+static sv_integer tune_low[] = { 1, 2, 3, 5, 8 };
+static sv_real tune_volume[] = { 0.01, 0.1, 1, 10 };
+static sv_real tune_swell[] = { 0.01, 0.03, 0.1 };
+static sv_decision tune_dec[] = { &dumb_decision, &smart_decision, &smart_decision,
+	&cost_decision, &cost_decision };
+static sv_integer tune_strat[] = { SV_MIN_MIN, SV_MIN_MIN, SV_MIN_MAX, 
+	SV_COST_AREA, SV_COST_CONTENTS };
+
+static sv_integer tune_count[4] = { 5, 4, 3, 5 };
+
+// Start with the current settings
+
+sv_div_params::sv_div_params()
+{
+	low_contents = user_low_contents();
+	small_volume = get_small_volume();
+	swell = get_swell_fac();
+	decision = &dumb_decision;
+	strategy = get_smart_strategy();
+	divide_time = 0;
+	work_time = 0;
+	bytes = 0;
+}
+
+void sv_div_params::use() const
+{
+	set_low_contents(low_contents);
+	set_small_volume(small_volume);
+	set_swell_fac(swell);
+	if(decision == &smart_decision) set_smart_strategy(strategy);
+	if(decision == &cost_decision) set_cost_measure(strategy);
+}
+
+void sv_div_params::print(ostream& s) const
+{
+	if(decision == &dumb_decision)
+		s << "dumb_decision";
+	else if(decision == &smart_decision)
+		s << "smart_decision (" << ((strategy == SV_MIN_MAX) ? "SV_MIN_MAX" : "SV_MIN_MIN") << ")";
+	else if(decision == &cost_decision)
+		s << "cost_decision (" << ((strategy == SV_COST_CONTENTS) ? "SV_COST_CONTENTS" : "SV_COST_AREA") << ")";
+	else
+		s << "user decision procedure";
+	s << ", low contents " << low_contents << ", small volume " << small_volume << 
+		", swell " << swell << ": divide " << divide_time << "s, work " << 
+		work_time << "s, " << bytes << " bytes";
+}
+
+// The sample work: the same points and rays are used for every trial
+
+struct sv_tune_work
+{
+	sv_set_list sl;
+	sv_box b;
+	sv_integer work;
+	sv_integer n;
+	sv_point* p;		// Points to test for membership
+	sv_line* r;		// Rays to fire
+};
+
+// Set the value of parameter d in dp to its jth value; return 0 if that's
+// what it was already
+
+static int tune_set(sv_div_params* dp, sv_integer d, sv_integer j)
+{
+	switch(d)
+	{
+	case 0:
+		if(dp->low_contents == tune_low[j]) return(0);
+		dp->low_contents = tune_low[j];
+		break;
+
+	case 1:
+		if(dp->small_volume == tune_volume[j]) return(0);
+		dp->small_volume = tune_volume[j];
+		break;
+
+	case 2:
+		if(dp->swell == tune_swell[j]) return(0);
+		dp->swell = tune_swell[j];
+		break;
+
+	default:
+		if((dp->decision == tune_dec[j]) && 
+		   ((dp->decision == &dumb_decision) || (dp->strategy == tune_strat[j])))
+			return(0);
+		dp->decision = tune_dec[j];
+		dp->strategy = tune_strat[j];
+	}
+	return(1);
+}
+
+// Divide and do the work with the settings in dp; return the total time,
+// or -1 if too much memory was used.
+
+static double tune_try(sv_div_params* dp, const sv_tune_work* tw, sv_integer max_bytes, 
+		       ostream* log)
+{
+	sv_model m;
+	sv_integer i;
+	sv_real t;
+	double t0;
+
+	dp->use();
+	dp->divide_time = 0;
+	dp->work_time = 0;
+	dp->bytes = 0;
+
+	if(tw->work & (SV_TUNE_RAYS | SV_TUNE_MEMBER))
+	{
+		t0 = sv_wall_time();
+		m = sv_model(tw->sl, tw->b, sv_model()).divide(0, dp->decision);
+		dp->divide_time = sv_wall_time() - t0;
+		dp->bytes = model_bytes(m);
+
+		t0 = sv_wall_time();
+		if(tw->work & SV_TUNE_MEMBER)
+			for(i = 0; i < tw->n; i++) m.member(tw->p[i]);
+		if(tw->work & SV_TUNE_RAYS)
+			for(i = 0; i < tw->n; i++) m.fire_ray(tw->r[i], &t);
+		dp->work_time = sv_wall_time() - t0;
+		m = sv_model();
+	}
+
+// The faceter has its own decision procedure, but it uses the small
+// volume and the swell (so only they are varied if all the work is
+// faceting)
+
+	if(tw->work & SV_TUNE_FACET)
+	{
+		t0 = sv_wall_time();
+		m = sv_model(tw->sl, tw->b, sv_model()).facet();
+		dp->work_time = dp->work_time + sv_wall_time() - t0;
+		dp->bytes = max(dp->bytes, model_bytes(m));
+	}
+
+	if(log)
+	{
+		*log << "  ";
+		dp->print(*log);
+		*log << SV_EL;
+	}
+
+	if(max_bytes && (dp->bytes > max_bytes)) return(-1);
+	return(dp->divide_time + dp->work_time);
+}
+
+sv_div_params tune_division(const sv_set_list& sl, const sv_box& b, sv_integer work, 
+	sv_integer samples, sv_integer max_bytes, ostream* log)
+{
+	sv_integer old_strategy = get_smart_strategy();
+	sv_integer old_measure = get_cost_measure();
+	sv_div_params old, best, trial;
+	sv_tune_work tw;
+	sv_point c = b.centroid();
+	sv_point o;
+	sv_real r = sqrt(b.diag_sq());
+	double score, best_score;
+	sv_integer d, j, pass;
+	int improved;
+
+	if(!(work & (SV_TUNE_RAYS | SV_TUNE_MEMBER | SV_TUNE_FACET)))
+	{
+		svlis_error("tune_division", "no work to tune for", SV_WARNING);
+		return(best);
+	}
+
+	tw.sl = sl;
+	tw.b = b;
+	tw.work = work;
+	tw.n = max(1, samples);
+	tw.p = new sv_point[tw.n];
+	tw.r = new sv_line[tw.n];
+
+// Rays come in from a sphere round the box to random points in it
+
+	for(j = 0; j < tw.n; j++)
+	{
+		tw.p[j] = ran_point(b);
+		o = c + (ran_point(b) - c).norm()*r;
+		tw.r[j] = sv_line(ran_point(b) - o, o);
+	}
+
+	best_score = tune_try(&best, &tw, max_bytes, log);
+	improved = 1;
+	for(pass = 0; improved && (pass < SV_TUNE_PASSES); pass++)
+	{
+		improved = 0;
+		for(d = 0; d < 4; d++)
+		{
+			if(!(work & (SV_TUNE_RAYS | SV_TUNE_MEMBER)) && ((d == 0) || (d == 3)))
+				continue;
+			for(j = 0; j < tune_count[d]; j++)
+			{
+				trial = best;
+				if(!tune_set(&trial, d, j)) continue;
+				score = tune_try(&trial, &tw, max_bytes, log);
+				if((score >= 0) && ((best_score < 0) || (score < best_score)))
+				{
+					best = trial;
+					best_score = score;
+					improved = 1;
+				}
+			}
+		}
+	}
+
+	if(best_score < 0)
+		svlis_error("tune_division", "no settings tried fitted in the memory allowed", 
+			SV_WARNING);
+
+	old.use();
+	set_smart_strategy(old_strategy);
+	set_cost_measure(old_measure);
+	delete [] tw.p;
+	delete [] tw.r;
+	return(best);
+}
+
+#if macintosh
+ #pragma export off
+#endif